@@ -20,12 +20,38 @@
 #define CASTSESSION_CHANNEL_H
 
 #include <memory>
+#include <sys/uio.h>
+#include <vector>
 #include "channel_request.h"
 #include "channel_listener.h"
 
 namespace OHOS {
 namespace CastEngine {
 namespace CastEngineService {
+// Outbound queue of a channel whose sends don't wait for the network
+struct SendQueueStats {
+    size_t queuedPackets{ 0 };
+    size_t queuedBytes{ 0 };
+    // Deepest the queue has been
+    size_t peakQueuedBytes{ 0 };
+    // Packets that could not be written at once and went through the queue
+    uint64_t queuedTotal{ 0 };
+    // Packets refused because the queue was full
+    uint64_t rejected{ 0 };
+    // Times the queue went over its high watermark
+    uint64_t congestions{ 0 };
+};
+
+enum class SendFileResult {
+    SENT,
+    // Nothing was written, the channel can't send files at all
+    UNSUPPORTED,
+    // Nothing was written, this packet may still be sent another way
+    NOT_SENT,
+    // Part of the packet may be out, the channel is broken and anything sent after it would be misframed
+    FAILED,
+};
+
 class Channel {
 public:
     virtual ~Channel() = default;
@@ -55,6 +81,48 @@ public:
         return false;
     }
 
+    /*
+     * Send the iovcnt pieces of iov as one packet, for callers that hold its header and body apart. The channels
+     * that can't gather them get them copied into one buffer here.
+     */
+    virtual bool SendV(const struct iovec *iov, int iovcnt)
+    {
+        if (iov == nullptr || iovcnt <= 0) {
+            return false;
+        }
+        std::vector<uint8_t> buffer;
+        for (int i = 0; i < iovcnt; i++) {
+            const uint8_t *base = static_cast<const uint8_t *>(iov[i].iov_base);
+            buffer.insert(buffer.end(), base, base + iov[i].iov_len);
+        }
+        return !buffer.empty() && Send(buffer.data(), static_cast<int>(buffer.size()));
+    }
+
+    /*
+     * Send header followed by length bytes of the file fd from offset as one packet, without copying the file data
+     * into user space. The channel may write the file data after returning, from its own dup of fd. Only a result
+     * telling nothing was written lets the caller send the packet another way.
+     */
+    virtual SendFileResult SendFile(const uint8_t *header, int headerLength, int fd, int64_t offset, int length)
+    {
+        return SendFileResult::UNSUPPORTED;
+    }
+
+    /*
+     * True while the data waiting to be sent is above the high watermark of the channel. Producers should hold
+     * back until IChannelListener::OnSendCongestionChanged tells them the queue drained.
+     */
+    virtual bool IsSendCongested()
+    {
+        return false;
+    }
+
+    // Returns false when the channel has no send queue
+    virtual bool GetSendQueueStats(SendQueueStats &stats)
+    {
+        return false;
+    }
+
 private:
     ChannelRequest channelRequest_;
     std::shared_ptr<IChannelListener> channelListener_;
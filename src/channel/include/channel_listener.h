@@ -32,6 +32,11 @@ struct ChannelFileSchema {
     CloseFdFunc closeFd;
 };
 
+/*
+ * The callbacks run on the I/O threads of the channel, which serve other connections as well. They must return
+ * quickly and never block: no waiting on locks held across slow work, no disk I/O or syncs, and no sends that may
+ * wait for the peer. Such work goes to a thread of the listener.
+ */
 class IChannelListener {
 public:
     IChannelListener() = default;
@@ -42,6 +47,8 @@ public:
     virtual void OnFilesSent(std::string firstFile, int percent) {}
     virtual void OnFilesReceived(std::string files, int percent) {}
     virtual void OnFileTransError() {}
+    // The send queue of the channel went over its high watermark, or drained below its low one
+    virtual void OnSendCongestionChanged(bool congested) {}
 };
 } // namespace CastEngineService
 } // namespace CastEngine
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: size classed buffers for the packets received by tcp connections.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "receive_buffer_pool.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+ReceiveBufferPool &ReceiveBufferPool::GetInstance()
+{
+    // Never destroyed, the reactor threads may still release buffers while the statics go away at exit
+    static ReceiveBufferPool *instance = new ReceiveBufferPool();
+    return *instance;
+}
+
+ReceiveBuffer ReceiveBufferPool::Acquire(size_t size)
+{
+    ReceiveBuffer buffer;
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        if (size > CLASS_SIZES[i]) {
+            continue;
+        }
+        buffer.capacity = CLASS_SIZES[i];
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!freeBuffers_[i].empty()) {
+                buffer.data = std::move(freeBuffers_[i].back());
+                freeBuffers_[i].pop_back();
+                return buffer;
+            }
+        }
+        // Not zeroed, the reads fill what the packet uses
+        buffer.data = std::unique_ptr<uint8_t[]>(new (std::nothrow) uint8_t[buffer.capacity]);
+        buffer.capacity = buffer.data ? buffer.capacity : 0;
+        return buffer;
+    }
+    buffer.data = std::unique_ptr<uint8_t[]>(new (std::nothrow) uint8_t[size]);
+    buffer.capacity = buffer.data ? size : 0;
+    return buffer;
+}
+
+void ReceiveBufferPool::Release(ReceiveBuffer &buffer)
+{
+    if (!buffer.data) {
+        return;
+    }
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        if (buffer.capacity != CLASS_SIZES[i]) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (freeBuffers_[i].size() < MAX_FREE_BUFFERS[i]) {
+            freeBuffers_[i].push_back(std::move(buffer.data));
+        }
+        break;
+    }
+    buffer.data = nullptr;
+    buffer.capacity = 0;
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
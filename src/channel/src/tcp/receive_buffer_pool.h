@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: size classed buffers for the packets received by tcp connections.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef RECEIVE_BUFFER_POOL_H
+#define RECEIVE_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+struct ReceiveBuffer {
+    std::unique_ptr<uint8_t[]> data;
+    size_t capacity{ 0 };
+};
+
+/*
+ * Packets are read into a buffer of the smallest size class that holds them, and the buffer goes back to the
+ * free list of its class once the listener has the packet. The free lists are bounded, a small class keeps more
+ * buffers than a large one, and packets larger than the largest class get a buffer of their own size.
+ */
+class ReceiveBufferPool final {
+public:
+    static ReceiveBufferPool &GetInstance();
+
+    ReceiveBuffer Acquire(size_t size);
+    void Release(ReceiveBuffer &buffer);
+
+    static constexpr size_t CLASS_COUNT = 4;
+    // Control and rtsp messages, audio frames, most video frames, key frames
+    static constexpr size_t CLASS_SIZES[CLASS_COUNT] = { 4 * 1024, 64 * 1024, 512 * 1024, 2 * 1024 * 1024 };
+    static constexpr size_t MAX_FREE_BUFFERS[CLASS_COUNT] = { 32, 16, 8, 2 };
+
+private:
+    ReceiveBufferPool() = default;
+    ~ReceiveBufferPool() = default;
+    ReceiveBufferPool(const ReceiveBufferPool &) = delete;
+    ReceiveBufferPool &operator=(const ReceiveBufferPool &) = delete;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<uint8_t[]>> freeBuffers_[CLASS_COUNT];
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // RECEIVE_BUFFER_POOL_H
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: ring buffer the bytes received on a tcp socket are parsed from.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "recv_ring_buffer.h"
+
+#include <algorithm>
+
+#include "securec.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+RecvRingBuffer::~RecvRingBuffer()
+{
+    ReceiveBufferPool::GetInstance().Release(storage_);
+}
+
+int RecvRingBuffer::GetFreeSegments(struct iovec iov[2])
+{
+    if (!storage_.data) {
+        storage_ = ReceiveBufferPool::GetInstance().Acquire(CAPACITY);
+        if (!storage_.data) {
+            return 0;
+        }
+    }
+    if (size_ == CAPACITY) {
+        return 0;
+    }
+    size_t tail = (head_ + size_) % CAPACITY;
+    size_t free = CAPACITY - size_;
+    size_t first = std::min(free, CAPACITY - tail);
+    iov[0].iov_base = storage_.data.get() + tail;
+    iov[0].iov_len = first;
+    if (first == free) {
+        return 1;
+    }
+    iov[1].iov_base = storage_.data.get();
+    iov[1].iov_len = free - first;
+    return 2;
+}
+
+void RecvRingBuffer::Commit(size_t length)
+{
+    size_ = std::min(size_ + length, CAPACITY);
+}
+
+bool RecvRingBuffer::Peek(uint8_t *dest, size_t length) const
+{
+    if (length > size_) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+    size_t first = std::min(length, CAPACITY - head_);
+    if (memcpy_s(dest, length, storage_.data.get() + head_, first) != EOK) {
+        return false;
+    }
+    if (first < length && memcpy_s(dest + first, length - first, storage_.data.get(), length - first) != EOK) {
+        return false;
+    }
+    return true;
+}
+
+const uint8_t *RecvRingBuffer::GetContiguous(size_t length) const
+{
+    if (length > size_ || head_ + length > CAPACITY) {
+        return nullptr;
+    }
+    return storage_.data.get() + head_;
+}
+
+size_t RecvRingBuffer::Read(uint8_t *dest, size_t length)
+{
+    length = std::min(length, size_);
+    if (!Peek(dest, length)) {
+        return 0;
+    }
+    Consume(length);
+    return length;
+}
+
+void RecvRingBuffer::Consume(size_t length)
+{
+    length = std::min(length, size_);
+    size_ -= length;
+    // Starting over at the front once empty keeps the next packets from wrapping
+    head_ = size_ == 0 ? 0 : (head_ + length) % CAPACITY;
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
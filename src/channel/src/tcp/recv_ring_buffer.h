@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: ring buffer the bytes received on a tcp socket are parsed from.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef RECV_RING_BUFFER_H
+#define RECV_RING_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+
+#include "receive_buffer_pool.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+/*
+ * Bytes read from a socket and not parsed yet. The free space is filled by one scatter read even when it wraps
+ * around the end of the storage, and the packets that do not wrap are handed over in place.
+ */
+class RecvRingBuffer final {
+public:
+    RecvRingBuffer() = default;
+    ~RecvRingBuffer();
+    RecvRingBuffer(const RecvRingBuffer &) = delete;
+    RecvRingBuffer &operator=(const RecvRingBuffer &) = delete;
+
+    size_t Size() const
+    {
+        return size_;
+    }
+    size_t Capacity() const
+    {
+        return CAPACITY;
+    }
+    // The free space as at most two segments, 0 if the ring is full or its storage could not be allocated
+    int GetFreeSegments(struct iovec iov[2]);
+    // Marks length bytes of the free space as filled
+    void Commit(size_t length);
+    bool Peek(uint8_t *dest, size_t length) const;
+    // The next length bytes in place, nullptr if they wrap around the end of the storage
+    const uint8_t *GetContiguous(size_t length) const;
+    // Copies out and consumes at most length bytes, returns the number copied
+    size_t Read(uint8_t *dest, size_t length);
+    void Consume(size_t length);
+
+    static constexpr size_t CAPACITY = 64 * 1024;
+
+private:
+    ReceiveBuffer storage_;
+    size_t head_{ 0 };
+    size_t size_{ 0 };
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // RECV_RING_BUFFER_H
@@ -18,6 +18,12 @@
 
 #include "tcp_connection.h"
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+
 #include "cast_engine_log.h"
 #include "securec.h"
 #include "transport.h"
@@ -40,11 +46,15 @@ int TcpConnection::StartConnection(const ChannelRequest &request, std::shared_pt
     StashRequest(request);
     SetRequest(request);
     SetListener(channelListener);
-    
-    std::thread(&TcpConnection::Connect, shared_from_this()).detach();
+
+    Connect();
     return RET_OK;
 }
 
+/*
+ * Connects without blocking the caller. The result is reported from the reactor once the socket turns writable,
+ * also when the connection completes at once, so the listener is never called back inside StartConnection.
+ */
 void TcpConnection::Connect()
 {
     CLOGD("Tcp Connect Enter.");
@@ -59,10 +69,26 @@ void TcpConnection::Connect()
     int port = socket_.Bind(channelRequest_.localDeviceInfo.ipAddress, channelRequest_.localPort);
     CLOGD("Start server socket, localIp:%s, bindPort:%{public}d", channelRequest_.localDeviceInfo.ipAddress.c_str(),
         port);
-    bool ret = socket_.Connect(channelRequest_.remoteDeviceInfo.ipAddress, channelRequest_.remotePort);
-    if (!ret) {
+    auto self = shared_from_this();
+    if (!socket_.ConnectAsync(channelRequest_.remoteDeviceInfo.ipAddress, channelRequest_.remotePort) ||
+        !Watch(socket_.GetSocketFd(), EPOLLOUT, [self](uint32_t events) { self->OnConnected(); })) {
+        CLOGE("Tcp Connect Failed.");
+        listener->OnConnectionConnectFailed(channelRequest_, false);
+    }
+}
+
+void TcpConnection::OnConnected()
+{
+    int sockfd = socket_.GetSocketFd();
+    Unwatch(sockfd);
+    std::shared_ptr<ConnectionListener> listener = listener_;
+    if (!listener) {
+        CLOGE("listener_ is nullptr.");
+        return;
+    }
+    if (!socket_.FinishConnect()) {
         CLOGE("Tcp Connect Failed.");
-        listener->OnConnectionConnectFailed(channelRequest_, ret);
+        listener->OnConnectionConnectFailed(channelRequest_, false);
         return;
     }
     listener->OnConnectionOpened(shared_from_this());
@@ -78,14 +104,20 @@ int TcpConnection::StartListen(const ChannelRequest &request, std::shared_ptr<IC
     StashRequest(request);
     SetRequest(request);
     SetListener(channelListener);
-    
+
     int port = socket_.Bind(request.localDeviceInfo.ipAddress, request.localPort);
     CLOGD("Start server socket, localIp:%s, bindPort:%{public}d", request.localDeviceInfo.ipAddress.c_str(), port);
     socket_.Listen(SOMAXCONN);
-    if (request.moduleType == ModuleType::VIDEO && request.remoteDeviceInfo.deviceType != DeviceType::DEVICE_HICAR) {
-        std::thread(&TcpConnection::AcceptVideoAndAudio, shared_from_this()).detach();
-    } else {
-        std::thread(&TcpConnection::Accept, shared_from_this()).detach();
+    // Only used in media module for tcp server to accept client twice, include both video and audio.
+    bool acceptTwice = request.moduleType == ModuleType::VIDEO &&
+        request.remoteDeviceInfo.deviceType != DeviceType::DEVICE_HICAR;
+    pendingAccepts_ = acceptTwice ? 2 : 1;
+    int listenFd = socket_.GetSocketFd();
+    auto self = shared_from_this();
+    if (!TcpSocket::SetNonBlocking(listenFd, true) ||
+        !Watch(listenFd, EPOLLIN, [self](uint32_t events) { self->Accept(); })) {
+        CLOGE("Watch listening socket failed.");
+        return RET_ERR;
     }
     return port;
 }
@@ -98,31 +130,32 @@ void TcpConnection::ConfigSocket()
     socket_.SetReuseAddr();
 }
 
-/*
- * Only used in media module for tcp server to accept client twice, include both video and audio.
- */
-void TcpConnection::AcceptVideoAndAudio()
-{
-    CLOGD("Tcp AcceptVideoAndAudio Enter.");
-    Accept();
-    Accept();
-}
-
 void TcpConnection::Accept()
 {
     CLOGD("Tcp Accept Enter.");
     std::shared_ptr<ConnectionListener> listener = listener_;
     if (!listener) {
         CLOGE("listener_ is nullptr.");
+        Unwatch(socket_.GetSocketFd());
         return;
     }
     int sockfd = socket_.Accept();
+    if (sockfd == INVALID_SOCKET && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (--pendingAccepts_ <= 0) {
+        Unwatch(socket_.GetSocketFd());
+    }
     if (sockfd == INVALID_SOCKET) {
         CLOGE("Open Session Failed, sessionId = %{public}d, moduleType = %{public}d",
             channelRequest_.remoteDeviceInfo.sessionId, channelRequest_.moduleType);
         listener->OnConnectionConnectFailed(channelRequest_, sockfd);
         return;
     }
+    // Nothing waits on the data socket, a file segment the socket doesn't take at once is queued like any packet
+    if (!TcpSocket::SetNonBlocking(sockfd, true)) {
+        CLOGE("Set accepted socket non-blocking failed, client = %{public}d", sockfd);
+    }
     int remotePort = socket_.GetPeerPort(sockfd);
     if (remotePort == INVALID_PORT) {
         CLOGE("Open Session Failed, sessionId = %{public}d, moduleType = %{public}d",
@@ -130,11 +163,14 @@ void TcpConnection::Accept()
         listener->OnConnectionConnectFailed(channelRequest_, remotePort);
         return;
     }
+    // The connection the socket belongs to, it receives and sends on it
+    std::shared_ptr<TcpConnection> connection = shared_from_this();
     if (channelRequest_.moduleType == ModuleType::VIDEO && remotePort != channelRequest_.remotePort &&
             channelRequest_.remoteDeviceInfo.deviceType != DeviceType::DEVICE_HICAR) {
         // audio
         std::lock_guard<std::mutex> lg(connectionMtx_);
         SetAudioConnection(sockfd);
+        connection = tcpAudioConn_;
         CLOGD("Open Session Succ, sessionId = %{public}d, moduleType = %{public}d, client = %{public}d",
             tcpAudioConn_->channelRequest_.remoteDeviceInfo.sessionId, tcpAudioConn_->channelRequest_.moduleType,
             sockfd);
@@ -151,7 +187,7 @@ void TcpConnection::Accept()
         CLOGE("Only Send Media data for Source end.");
         return;
     }
-    Receive(sockfd);
+    connection->Receive(sockfd);
     CLOGI("Tcp Accept out.");
 }
 
@@ -173,68 +209,208 @@ void TcpConnection::SetAudioConnection(int socket)
 void TcpConnection::Receive(int socket)
 {
     CLOGD("Tcp Receive Client Enter.");
-    std::thread(&TcpConnection::ReadLooper, shared_from_this(), socket).detach();
+    int sockfd = socket == INVALID_SOCKET ? socket_.GetSocketFd() : socket;
+    isReceiving_ = true;
+    {
+        std::lock_guard<std::mutex> lg(ioMtx_);
+        receiveState_ = std::make_shared<ReceiveState>();
+    }
+    if (!UpdateSocketEvents(sockfd, EPOLLIN, 0)) {
+        std::shared_ptr<ConnectionListener> listener = listener_;
+        if (listener) {
+            listener->OnConnectionError(shared_from_this(), RET_ERR);
+        }
+    }
 }
 
-void TcpConnection::ReadLooper(int socket)
+int TcpConnection::GetDataSocket()
 {
-    CLOGD("Tcp Read Client Looper Enter.");
-    isReceiving_ = true;
-    HandleReceivedData(socket);
+    return remoteSocket_ == INVALID_SOCKET ? socket_.GetSocketFd() : remoteSocket_;
+}
+
+// The data socket has one registration for both directions, its events are changed as receiving and sending need
+bool TcpConnection::UpdateSocketEvents(int fd, uint32_t add, uint32_t remove)
+{
+    std::lock_guard<std::mutex> lg(ioMtx_);
+    uint32_t events = (ioEvents_ | add) & ~remove;
+    if (ioFd_ == fd && ioEvents_ == events) {
+        return true;
+    }
+    auto self = shared_from_this();
+    TcpReactor::EventHandler handler = [self, fd](uint32_t ready) { self->OnSocketEvents(fd, ready); };
+    bool ret = ioFd_ == fd ? TcpReactor::GetInstance().Modify(fd, events, std::move(handler)) :
+        Watch(fd, events, std::move(handler));
+    if (ret) {
+        ioFd_ = fd;
+        ioEvents_ = events;
+    }
+    return ret;
+}
+
+void TcpConnection::OnSocketEvents(int fd, uint32_t events)
+{
+    if (events & EPOLLOUT) {
+        FlushSendQueue(fd);
+    }
+    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) == 0) {
+        return;
+    }
+    std::shared_ptr<ReceiveState> state;
+    {
+        std::lock_guard<std::mutex> lg(ioMtx_);
+        state = receiveState_;
+    }
+    if (state) {
+        HandleReceivedData(fd, *state);
+        return;
+    }
+    // A socket only sent on reports its errors here, they would come again and again while it stays registered
+    CLOGE("Send socket error, events = %{public}u.", events);
+    Unwatch(fd);
+    bool wasCongested = false;
+    {
+        std::lock_guard<std::mutex> lg(sendMtx_);
+        wasCongested = FailSendingLocked();
+    }
+    AbortSending(fd, wasCongested);
+}
+
+// Fails until the connection receives
+bool TcpConnection::GetReceiveStats(ReceiveStats &stats)
+{
+    std::shared_ptr<ReceiveState> state;
+    {
+        std::lock_guard<std::mutex> lg(ioMtx_);
+        state = receiveState_;
+    }
+    if (!state) {
+        return false;
+    }
+    stats.recvCalls = state->recvCalls.load();
+    stats.packets = state->packets.load();
+    return true;
 }
 
-void TcpConnection::HandleReceivedData(int socket)
+/*
+ * Called by the reactor when the socket is readable. Each read takes all that has arrived, up to the room left in
+ * the ring, and every complete packet in it is handed over before the next read. A packet split across reads is
+ * kept in state until its rest comes.
+ */
+void TcpConnection::HandleReceivedData(int socket, ReceiveState &state)
 {
     std::shared_ptr<ConnectionListener> listener = listener_;
     if (!listener) {
         CLOGE("listener_ is nullptr.");
+        Unwatch(socket);
         return;
     }
+    bool drained = false;
+    int reads = 0;
     while (isReceiving_) {
-        CLOGD("TCP Recv Data start.");
-        int sockfd = socket == INVALID_SOCKET ? socket_.GetSocketFd() : socket;
-        uint8_t header[PACKET_HEADER_LEN] = {};
-        ssize_t length = socket_.Recv(sockfd, header, sizeof(header));
-        if (length == STOP_RECEIVE) {
-            break;
+        if (ParsePackets(state) != RET_OK) {
+            Unwatch(socket);
+            listener->OnConnectionError(shared_from_this(), RET_ERR);
+            return;
+        }
+        // A read short of the room given emptied the socket, asking again would only return EAGAIN
+        if (drained || reads >= MAX_READS_PER_EVENT) {
+            return;
+        }
+        ssize_t length;
+        size_t room;
+        if (state.buffer.data) {
+            room = state.packetLength - state.received;
+            length = socket_.RecvAvailable(socket, state.buffer.data.get() + state.received, room);
+        } else {
+            room = state.ring.Capacity() - state.ring.Size();
+            length = socket_.RecvAvailable(socket, state.ring);
         }
-        if (length != PACKET_HEADER_LEN) {
-            CLOGE("Receive header data error.");
+        reads++;
+        state.recvCalls++;
+        if (length == 0) {
+            return;
+        }
+        if (length < 0) {
+            CLOGE("Receive data error, %{public}llu packets in %{public}llu reads.",
+                static_cast<unsigned long long>(state.packets.load()),
+                static_cast<unsigned long long>(state.recvCalls.load()));
+            Unwatch(socket);
             listener->OnConnectionError(shared_from_this(), length);
             return;
         }
+        if (state.buffer.data) {
+            state.received += static_cast<size_t>(length);
+        }
+        drained = static_cast<size_t>(length) < room;
+    }
+}
+
+/*
+ * Hands over the complete packets of the ring in place. A packet larger than the ring, or wrapped around its end,
+ * is moved into a pooled buffer of its own and its rest is read straight into that buffer.
+ */
+int TcpConnection::ParsePackets(ReceiveState &state)
+{
+    if (state.buffer.data) {
+        if (state.received < state.packetLength) {
+            return RET_OK;
+        }
+        DeliverPacket(state.buffer.data.get(), state.packetLength);
+        ReceiveBufferPool::GetInstance().Release(state.buffer);
+        state.packets++;
+    }
+    while (isReceiving_ && state.ring.Size() >= PACKET_HEADER_LEN) {
+        uint8_t header[PACKET_HEADER_LEN];
+        state.ring.Peek(header, PACKET_HEADER_LEN);
         uint32_t dataLength = GetReceivedDataLength(header);
         if (dataLength > ILLEGAL_LENGTH) {
             CLOGE("Receive payload data length is illegal.");
-            listener->OnConnectionError(shared_from_this(), length);
-            return;
+            return RET_ERR;
         }
-        uint8_t buf[dataLength];
-        if (memset_s(buf, dataLength, 0, dataLength) != RET_OK) {
-            CLOGE("memset_s failed");
+        size_t packetLength = PACKET_HEADER_LEN + dataLength;
+        const uint8_t *packet = state.ring.GetContiguous(packetLength);
+        if (packet != nullptr) {
+            DeliverPacket(packet, packetLength);
+            state.ring.Consume(packetLength);
+            state.packets++;
             continue;
         }
-        length = socket_.Recv(sockfd, buf, sizeof(buf));
-        if (length == STOP_RECEIVE) {
-            break;
+        if (state.ring.Size() < packetLength && packetLength <= state.ring.Capacity()) {
+            // Its rest still to come, and it fits
+            return RET_OK;
         }
-        if (length != dataLength) {
-            CLOGE("Receive payload data length is illegal.");
-            listener->OnConnectionError(shared_from_this(), length);
-            return;
+        state.buffer = ReceiveBufferPool::GetInstance().Acquire(packetLength);
+        if (!state.buffer.data) {
+            CLOGE("Alloc receive buffer failed, length = %{public}zu.", packetLength);
+            return RET_ERR;
         }
-        if (channelRequest_.moduleType == ModuleType::REMOTE_CONTROL) {
-            HandleRemoteControlReceivedData(dataLength, header, buf);
-            continue;
+        state.packetLength = packetLength;
+        state.received = state.ring.Read(state.buffer.data.get(), packetLength);
+        if (state.received < state.packetLength) {
+            return RET_OK;
         }
-        CLOGD("TCP recvFrameLen done, dataLength = %{public}d", dataLength);
-        if (GetListener()) {
-            GetListener()->OnDataReceived(buf, dataLength, 0);
+        DeliverPacket(state.buffer.data.get(), state.packetLength);
+        ReceiveBufferPool::GetInstance().Release(state.buffer);
+        state.packets++;
+    }
+    return RET_OK;
+}
+
+void TcpConnection::DeliverPacket(const uint8_t *packet, size_t packetLength)
+{
+    uint32_t dataLength = static_cast<uint32_t>(packetLength - PACKET_HEADER_LEN);
+    // The remote control packets are handed over with their header
+    bool withHeader = channelRequest_.moduleType == ModuleType::REMOTE_CONTROL;
+    CLOGD("TCP recvFrameLen done, dataLength = %{public}d", dataLength);
+    if (GetListener()) {
+        if (withHeader) {
+            GetListener()->OnDataReceived(packet, PACKET_HEADER_LEN + dataLength, 0);
+        } else {
+            GetListener()->OnDataReceived(packet + PACKET_HEADER_LEN, dataLength, 0);
         }
     }
-    CLOGI("HandleReceivedData Out.");
 }
- 
+
 uint32_t TcpConnection::GetReceivedDataLength(uint8_t *header)
 {
     uint32_t dataLength = Utils::ByteArrayToInt(header, PACKET_HEADER_LEN);
@@ -245,28 +421,75 @@ uint32_t TcpConnection::GetReceivedDataLength(uint8_t *header)
     return dataLength;
 }
 
-void TcpConnection::HandleRemoteControlReceivedData(uint32_t dataLength, uint8_t *header, uint8_t *buf)
+bool TcpConnection::Watch(int fd, uint32_t events, TcpReactor::EventHandler handler)
 {
-    uint8_t controlBuf[PACKET_HEADER_LEN + dataLength];
-    if (memcpy_s(controlBuf, PACKET_HEADER_LEN, header, PACKET_HEADER_LEN) != RET_OK) {
-        CLOGE("Copy data failed");
-        return;
+    std::lock_guard<std::mutex> lg(watchMtx_);
+    if (!TcpReactor::GetInstance().Add(fd, events, std::move(handler))) {
+        return false;
     }
-    if (memcpy_s(controlBuf + PACKET_HEADER_LEN, dataLength, buf, dataLength) != RET_OK) {
-        CLOGE("Copy data failed");
-        return;
+    watchedFds_.push_back(fd);
+    return true;
+}
+
+void TcpConnection::Unwatch(int fd)
+{
+    {
+        std::lock_guard<std::mutex> lg(ioMtx_);
+        if (ioFd_ == fd) {
+            ioFd_ = INVALID_SOCKET;
+            ioEvents_ = 0;
+        }
     }
-    CLOGD("TCP recv remote control done, dataLength = %{public}d", PACKET_HEADER_LEN + dataLength);
-    if (GetListener()) {
-        GetListener()->OnDataReceived(controlBuf, PACKET_HEADER_LEN + dataLength, 0);
+    {
+        std::lock_guard<std::mutex> lg(watchMtx_);
+        auto iter = std::find(watchedFds_.begin(), watchedFds_.end(), fd);
+        if (iter == watchedFds_.end()) {
+            return;
+        }
+        watchedFds_.erase(iter);
+    }
+    TcpReactor::GetInstance().Remove(fd);
+}
+
+// Returns false when a handler still runs on another I/O thread, the sockets must stay open until it ends
+bool TcpConnection::UnwatchAll()
+{
+    {
+        std::lock_guard<std::mutex> lg(ioMtx_);
+        ioFd_ = INVALID_SOCKET;
+        ioEvents_ = 0;
+    }
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lg(watchMtx_);
+        fds.swap(watchedFds_);
+    }
+    bool idle = true;
+    for (int fd : fds) {
+        idle = TcpReactor::GetInstance().Remove(fd) && idle;
     }
+    return idle;
 }
 
 void TcpConnection::CloseConnection()
 {
     CLOGI("Tcp Close Enter.");
-    std::lock_guard<std::mutex> lg(connectionMtx_);
     isReceiving_.store(false);
+    // Off the reactor before taking connectionMtx_, a running accept handler may be waiting for it
+    bool idle = UnwatchAll();
+    bool wasCongested = false;
+    {
+        std::lock_guard<std::mutex> lg(sendMtx_);
+        // Whatever the socket still takes of the queue goes out, the rest is dropped with the connection
+        if (!sendQueue_.empty() && WriteQueueLocked(GetDataSocket()) >= RET_OK && !sendQueue_.empty()) {
+            CLOGW("Drop %{public}zu queued packets, %{public}zu bytes.", sendQueue_.size(), queuedBytes_);
+        }
+        wasCongested = FailSendingLocked();
+    }
+    if (wasCongested) {
+        NotifyCongestion(false);
+    }
+    std::lock_guard<std::mutex> lg(connectionMtx_);
     if (tcpAudioConn_) {
         CLOGD("Close Tcp Audio Connection.");
         tcpAudioConn_->CloseConnection();
@@ -275,7 +498,12 @@ void TcpConnection::CloseConnection()
         socket_.Shutdown(remoteSocket_);
         remoteSocket_ = INVALID_SOCKET;
     }
-    socket_.Close();
+    if (idle) {
+        socket_.Close();
+    } else {
+        // A handler still running on another I/O thread holds this connection, the fd is closed with it instead
+        socket_.Shutdown(socket_.GetSocketFd());
+    }
     if (listener_) {
         listener_->OnConnectionClosed(shared_from_this());
     }
@@ -289,15 +517,363 @@ bool TcpConnection::Send(const uint8_t *buf, int bufLen)
         CLOGE("Data or length is illegal.");
         return false;
     }
-    uint8_t sendBuf[bufLen + PACKET_HEADER_LEN];
-    Utils::IntToByteArray(bufLen, PACKET_HEADER_LEN, sendBuf);
-    errno_t cpyRet = memcpy_s(sendBuf + PACKET_HEADER_LEN, bufLen, buf, bufLen);
-    if (cpyRet != RET_OK) {
+    struct iovec iov = { const_cast<uint8_t *>(buf), static_cast<size_t>(bufLen) };
+    return SendV(&iov, 1);
+}
+
+/*
+ * The packet header goes in an iovec of its own, so the pieces are written to the socket without being copied.
+ * Never waits for the network: what the socket doesn't take at once is copied into the send queue, and the reactor
+ * writes it once the socket turns writable. A full queue refuses the packet.
+ */
+bool TcpConnection::SendV(const struct iovec *iov, int iovcnt)
+{
+    if (iov == nullptr || iovcnt <= 0 || iovcnt > MAX_SEND_IOV) {
+        CLOGE("Send pieces are illegal, count = %{public}d.", iovcnt);
+        return false;
+    }
+    struct iovec packet[MAX_SEND_IOV + 1];
+    size_t length = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_base == nullptr && iov[i].iov_len > 0) {
+            return false;
+        }
+        packet[i + 1] = iov[i];
+        length += iov[i].iov_len;
+    }
+    if (length == 0 || length > ILLEGAL_LENGTH) {
+        CLOGE("Data length is illegal, length = %{public}zu.", length);
         return false;
     }
+    uint8_t packetHeader[PACKET_HEADER_LEN];
+    Utils::IntToByteArray(static_cast<int>(length), PACKET_HEADER_LEN, packetHeader);
+    packet[0] = { packetHeader, PACKET_HEADER_LEN };
+    size_t total = PACKET_HEADER_LEN + length;
     CLOGD("Tcp Send, socket = %{public}d, moduleType = %{public}d", remoteSocket_, channelRequest_.moduleType);
-    int sockfd = remoteSocket_ == INVALID_SOCKET ? socket_.GetSocketFd() : remoteSocket_;
-    return socket_.Send(sockfd, sendBuf, bufLen + PACKET_HEADER_LEN) > RET_OK ? true : false;
+    int sockfd = GetDataSocket();
+    // A packet that goes behind queued ones is copied before taking sendMtx_, which the reactor waits for to flush
+    OutboundPacket queued;
+    if (hasQueued_.load() && !CopyPacket(packet, iovcnt + 1, 0, total, queued)) {
+        return false;
+    }
+    bool congested = false;
+    {
+        std::lock_guard<std::mutex> lg(sendMtx_);
+        if (sendFailed_) {
+            return false;
+        }
+        size_t sent = 0;
+        if (sendQueue_.empty()) {
+            ssize_t ret = socket_.SendAvailableV(sockfd, packet, iovcnt + 1);
+            if (ret < RET_OK) {
+                return false;
+            }
+            sent = static_cast<size_t>(ret);
+            if (sent == total) {
+                return true;
+            }
+        } else if (queuedBytes_ + total > SEND_QUEUE_LIMIT) {
+            sendStats_.rejected++;
+            CLOGE("Send queue full, %{public}zu bytes queued, packet of %{public}zu refused.", queuedBytes_, total);
+            return false;
+        }
+        if (queued.data) {
+            queued.sent = sent;
+        } else if (!CopyPacket(packet, iovcnt + 1, sent, total, queued)) {
+            // The peer got part of the packet already, anything sent after it would be misframed
+            sendFailed_ = sent > 0;
+            return false;
+        }
+        EnqueueLocked(std::move(queued));
+        congested = OnQueuedLocked(sockfd);
+    }
+    if (congested) {
+        CLOGW("Send queue congested, socket = %{public}d.", sockfd);
+        NotifyCongestion(true);
+    }
+    return true;
+}
+
+// Has the reactor write the queue once the socket turns writable, returns whether the queue just got congested
+bool TcpConnection::OnQueuedLocked(int fd)
+{
+    if (!UpdateSocketEvents(fd, EPOLLOUT, 0)) {
+        CLOGE("Watch writable failed, socket = %{public}d.", fd);
+    }
+    if (congested_ || queuedBytes_ <= SEND_QUEUE_HIGH_WATERMARK) {
+        return false;
+    }
+    congested_ = true;
+    sendStats_.congestions++;
+    return true;
+}
+
+// Copies the packet for the send queue, leaving out its first skip bytes which the socket took already
+bool TcpConnection::CopyPacket(const struct iovec *iov, int iovcnt, size_t skip, size_t length,
+    OutboundPacket &packet)
+{
+    packet.length = length - skip;
+    packet.data = std::unique_ptr<uint8_t[]>(new (std::nothrow) uint8_t[packet.length]);
+    if (!packet.data) {
+        CLOGE("Alloc send queue packet failed, length = %{public}zu.", packet.length);
+        return false;
+    }
+    size_t copied = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        size_t pieceLength = iov[i].iov_len;
+        if (skip >= pieceLength) {
+            skip -= pieceLength;
+            continue;
+        }
+        const uint8_t *piece = static_cast<const uint8_t *>(iov[i].iov_base) + skip;
+        pieceLength -= skip;
+        skip = 0;
+        if (memcpy_s(packet.data.get() + copied, packet.length - copied, piece, pieceLength) != EOK) {
+            return false;
+        }
+        copied += pieceLength;
+    }
+    return true;
+}
+
+void TcpConnection::EnqueueLocked(OutboundPacket packet)
+{
+    queuedBytes_ += packet.length - packet.sent;
+    sendQueue_.push_back(std::move(packet));
+    hasQueued_ = true;
+    sendStats_.queuedTotal++;
+    sendStats_.peakQueuedBytes = std::max(sendStats_.peakQueuedBytes, queuedBytes_);
+}
+
+// Queues length bytes of file from offset, to be written with sendfile after the packets queued before it
+void TcpConnection::EnqueueFileLocked(std::unique_ptr<QueuedFile> file, int64_t offset, size_t length)
+{
+    OutboundPacket segment;
+    segment.file = std::move(file);
+    segment.fileOffset = offset;
+    segment.length = length;
+    EnqueueLocked(std::move(segment));
+}
+
+/*
+ * Writes as much of the queue as the socket takes, several packets per sendmsg and a file segment per sendfile.
+ * Returns RET_ERR on socket error.
+ */
+int TcpConnection::WriteQueueLocked(int fd)
+{
+    while (!sendQueue_.empty()) {
+        OutboundPacket &front = sendQueue_.front();
+        size_t requested = front.length - front.sent;
+        ssize_t ret = RET_OK;
+        if (front.file) {
+            ret = socket_.SendFileAvailable(fd, front.file->fd, front.fileOffset + static_cast<int64_t>(front.sent),
+                requested);
+        } else {
+            struct iovec iov[MAX_FLUSH_IOV];
+            int iovcnt = 0;
+            requested = 0;
+            for (auto iter = sendQueue_.begin(); iter != sendQueue_.end() && !iter->file && iovcnt < MAX_FLUSH_IOV;
+                ++iter) {
+                iov[iovcnt].iov_base = iter->data.get() + iter->sent;
+                iov[iovcnt].iov_len = iter->length - iter->sent;
+                requested += iov[iovcnt].iov_len;
+                iovcnt++;
+            }
+            ret = socket_.SendAvailableV(fd, iov, iovcnt);
+        }
+        if (ret < RET_OK) {
+            return RET_ERR;
+        }
+        ConsumeQueueLocked(static_cast<size_t>(ret));
+        if (static_cast<size_t>(ret) < requested) {
+            break;
+        }
+    }
+    return RET_OK;
+}
+
+// Drops the written bytes from the front of the queue
+void TcpConnection::ConsumeQueueLocked(size_t written)
+{
+    queuedBytes_ -= written;
+    while (written > 0) {
+        OutboundPacket &front = sendQueue_.front();
+        size_t count = std::min(written, front.length - front.sent);
+        front.sent += count;
+        written -= count;
+        if (front.sent == front.length) {
+            sendQueue_.pop_front();
+        }
+    }
+    hasQueued_ = !sendQueue_.empty();
+}
+
+// Called by the reactor when the socket with queued packets turns writable
+void TcpConnection::FlushSendQueue(int fd)
+{
+    bool relieved = false;
+    bool failed = false;
+    {
+        std::lock_guard<std::mutex> lg(sendMtx_);
+        if (WriteQueueLocked(fd) != RET_OK) {
+            failed = true;
+            relieved = FailSendingLocked();
+        }
+        if (sendQueue_.empty()) {
+            UpdateSocketEvents(fd, 0, EPOLLOUT);
+        }
+        if (congested_ && queuedBytes_ <= SEND_QUEUE_LOW_WATERMARK) {
+            congested_ = false;
+            relieved = true;
+        }
+    }
+    if (failed) {
+        AbortSending(fd, relieved);
+        return;
+    }
+    if (relieved) {
+        CLOGI("Send queue drained, socket = %{public}d.", fd);
+        NotifyCongestion(false);
+    }
+}
+
+void TcpConnection::NotifyCongestion(bool congested)
+{
+    std::shared_ptr<IChannelListener> listener = GetListener();
+    if (listener) {
+        listener->OnSendCongestionChanged(congested);
+    }
+}
+
+bool TcpConnection::IsSendCongested()
+{
+    std::lock_guard<std::mutex> lg(sendMtx_);
+    return congested_;
+}
+
+bool TcpConnection::GetSendQueueStats(SendQueueStats &stats)
+{
+    std::lock_guard<std::mutex> lg(sendMtx_);
+    stats = sendStats_;
+    stats.queuedPackets = sendQueue_.size();
+    stats.queuedBytes = queuedBytes_;
+    return true;
+}
+
+/*
+ * Never waits for the network either. The file data the socket doesn't take at once is queued as a segment of a
+ * dup of fd, which the reactor writes with sendfile in its turn, so the caller may close fd as soon as this returns.
+ */
+SendFileResult TcpConnection::SendFile(const uint8_t *header, int headerLength, int fd, int64_t offset, int length)
+{
+    CLOGD("Tcp SendFile Enter, header len = %{public}d, len = %{public}d", headerLength, length);
+    if (header == nullptr || headerLength <= 0 || length <= 0 || fd < 0 ||
+        offset > static_cast<int64_t>(std::numeric_limits<off_t>::max()) ||
+        static_cast<int64_t>(headerLength) + length > ILLEGAL_LENGTH) {
+        return SendFileResult::NOT_SENT;
+    }
+    uint8_t packetHeader[PACKET_HEADER_LEN];
+    Utils::IntToByteArray(headerLength + length, PACKET_HEADER_LEN, packetHeader);
+    struct iovec iov[] = {
+        { packetHeader, PACKET_HEADER_LEN },
+        { const_cast<uint8_t *>(header), static_cast<size_t>(headerLength) },
+    };
+    const int iovcnt = sizeof(iov) / sizeof(iov[0]);
+    const size_t headerTotal = PACKET_HEADER_LEN + static_cast<size_t>(headerLength);
+    // sendfile only works on regular files, let the caller read other fds itself
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) < RET_OK || !S_ISREG(fileStat.st_mode)) {
+        return SendFileResult::NOT_SENT;
+    }
+    int sockfd = GetDataSocket();
+    bool congested = false;
+    {
+        std::unique_lock<std::mutex> lock(sendMtx_);
+        if (sendFailed_) {
+            return SendFileResult::FAILED;
+        }
+        size_t sent = 0;
+        size_t fileSent = 0;
+        if (sendQueue_.empty()) {
+            ssize_t ret = socket_.SendAvailableV(sockfd, iov, iovcnt);
+            if (ret < RET_OK) {
+                return SendFileResult::NOT_SENT;
+            }
+            sent = static_cast<size_t>(ret);
+            ret = sent < headerTotal ? RET_OK :
+                socket_.SendFileAvailable(sockfd, fd, offset, static_cast<size_t>(length));
+            if (ret < RET_OK) {
+                // The header is out, the peer could only misread whatever follows it
+                CLOGE("Tcp SendFile failed within a packet, socket = %{public}d", sockfd);
+                bool wasCongested = FailSendingLocked();
+                lock.unlock();
+                AbortSending(sockfd, wasCongested);
+                return SendFileResult::FAILED;
+            }
+            fileSent = static_cast<size_t>(ret);
+            if (fileSent == static_cast<size_t>(length)) {
+                return SendFileResult::SENT;
+            }
+        } else if (queuedBytes_ + headerTotal + static_cast<size_t>(length) > SEND_QUEUE_LIMIT) {
+            sendStats_.rejected++;
+            CLOGE("Send queue full, %{public}zu bytes queued, file packet of %{public}d refused.", queuedBytes_,
+                length);
+            return SendFileResult::NOT_SENT;
+        }
+        // The dup comes first, so nothing is queued when it fails
+        int queuedFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        std::unique_ptr<QueuedFile> file = queuedFd < RET_OK ? nullptr : std::make_unique<QueuedFile>(queuedFd);
+        OutboundPacket headerPacket;
+        if (!file || (sent < headerTotal && !CopyPacket(iov, iovcnt, sent, headerTotal, headerPacket))) {
+            CLOGE("Queue file packet failed, socket = %{public}d, errno = %{public}d", sockfd, errno);
+            if (sent == 0) {
+                return SendFileResult::NOT_SENT;
+            }
+            bool wasCongested = FailSendingLocked();
+            lock.unlock();
+            AbortSending(sockfd, wasCongested);
+            return SendFileResult::FAILED;
+        }
+        if (headerPacket.data) {
+            EnqueueLocked(std::move(headerPacket));
+        }
+        EnqueueFileLocked(std::move(file), offset + static_cast<int64_t>(fileSent),
+            static_cast<size_t>(length) - fileSent);
+        congested = OnQueuedLocked(sockfd);
+    }
+    if (congested) {
+        CLOGW("Send queue congested, socket = %{public}d.", sockfd);
+        NotifyCongestion(true);
+    }
+    return SendFileResult::SENT;
+}
+
+// Drops the queue and refuses all later packets, returns whether producers were held back by the queue
+bool TcpConnection::FailSendingLocked()
+{
+    sendFailed_ = true;
+    sendQueue_.clear();
+    hasQueued_ = false;
+    queuedBytes_ = 0;
+    bool wasCongested = congested_;
+    congested_ = false;
+    return wasCongested;
+}
+
+/*
+ * Ends a connection whose outgoing stream is broken. The socket is shut down, so a receiving connection reports
+ * the error from its reads and the peer sees the connection go instead of misframed data.
+ */
+void TcpConnection::AbortSending(int fd, bool wasCongested)
+{
+    socket_.Shutdown(fd);
+    if (wasCongested) {
+        NotifyCongestion(false);
+    }
+    std::shared_ptr<ConnectionListener> listener = listener_;
+    if (!isReceiving_ && listener) {
+        listener->OnConnectionError(shared_from_this(), RET_ERR);
+    }
 }
 } // namespace CastEngineService
 } // namespace CastEngine
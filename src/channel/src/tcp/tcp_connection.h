@@ -19,15 +19,19 @@
 #ifndef TCP_CONNECTION_H
 #define TCP_CONNECTION_H
 
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "connection.h"
 #include "channel.h"
+#include "receive_buffer_pool.h"
+#include "recv_ring_buffer.h"
+#include "tcp_reactor.h"
 #include "tcp_socket.h"
 
 namespace OHOS {
@@ -44,18 +48,49 @@ public:
     int StartListen(const ChannelRequest &request, std::shared_ptr<IChannelListener> channelListener) override;
     void CloseConnection() override;
     bool Send(const uint8_t *buf, int bufLen) override;
-    
+    bool SendV(const struct iovec *iov, int iovcnt) override;
+    SendFileResult SendFile(const uint8_t *header, int headerLength, int fd, int64_t offset, int length) override;
+    bool IsSendCongested() override;
+    bool GetSendQueueStats(SendQueueStats &stats) override;
+
+    // Reads and packets of the receive path so far, telling how well the reads are batched
+    struct ReceiveStats {
+        uint64_t recvCalls{ 0 };
+        uint64_t packets{ 0 };
+    };
+    bool GetReceiveStats(ReceiveStats &stats);
+
 private:
+    struct ReceiveState;
+    struct QueuedFile;
+    struct OutboundPacket;
+
     void ConfigSocket();
     void Connect();
+    void OnConnected();
     void Receive(int socket);
-    void ReadLooper(int socket);
-    void AcceptVideoAndAudio();
     void Accept();
     void SetAudioConnection(int socket);
-    void HandleReceivedData(int socket);
+    void HandleReceivedData(int socket, ReceiveState &state);
+    int ParsePackets(ReceiveState &state);
+    void DeliverPacket(const uint8_t *packet, size_t packetLength);
     uint32_t GetReceivedDataLength(uint8_t *header);
-    void HandleRemoteControlReceivedData(uint32_t dataLength, uint8_t *header, uint8_t *buf);
+    int GetDataSocket();
+    bool UpdateSocketEvents(int fd, uint32_t add, uint32_t remove);
+    void OnSocketEvents(int fd, uint32_t events);
+    static bool CopyPacket(const struct iovec *iov, int iovcnt, size_t skip, size_t length, OutboundPacket &packet);
+    void EnqueueLocked(OutboundPacket packet);
+    void EnqueueFileLocked(std::unique_ptr<QueuedFile> file, int64_t offset, size_t length);
+    bool OnQueuedLocked(int fd);
+    int WriteQueueLocked(int fd);
+    void ConsumeQueueLocked(size_t written);
+    void FlushSendQueue(int fd);
+    bool FailSendingLocked();
+    void AbortSending(int fd, bool wasCongested);
+    void NotifyCongestion(bool congested);
+    bool Watch(int fd, uint32_t events, TcpReactor::EventHandler handler);
+    void Unwatch(int fd);
+    bool UnwatchAll();
 
     static constexpr int RET_ERR = -1;
     static constexpr int RET_OK = 0;
@@ -78,14 +113,74 @@ private:
      */
     static constexpr unsigned int SOCKET_RECV_BUFFER_SIZE = 10 * 1024 * 1024;
     static constexpr int CONTROL_LENGTH_MASK = 0xFFFF;
+    // Pieces a caller may pass to SendV, the packet header takes one more iovec
+    static constexpr int MAX_SEND_IOV = 15;
+    // Queued bytes at which producers are told to hold back, and at which they are told to go on again
+    static constexpr size_t SEND_QUEUE_HIGH_WATERMARK = 4 * 1024 * 1024;
+    static constexpr size_t SEND_QUEUE_LOW_WATERMARK = 1024 * 1024;
+    // Packets beyond it are refused, it holds a packet of the largest legal length
+    static constexpr size_t SEND_QUEUE_LIMIT = 16 * 1024 * 1024;
+    // Packets written by one sendmsg when the queue is flushed
+    static constexpr int MAX_FLUSH_IOV = 16;
+    // Reads per readiness event, so one busy socket does not hold up the others of its I/O thread
+    static constexpr int MAX_READS_PER_EVENT = 4;
+
+    struct ReceiveState {
+        RecvRingBuffer ring;
+        // A packet larger than the ring or wrapped around its end, gathered in a buffer of its own
+        ReceiveBuffer buffer;
+        size_t packetLength{ 0 };
+        size_t received{ 0 };
+        std::atomic<uint64_t> packets{ 0 };
+        std::atomic<uint64_t> recvCalls{ 0 };
+    };
+
+    // Dup of the fd a queued file segment is sent from, so the caller may close its own
+    struct QueuedFile {
+        explicit QueuedFile(int fd) : fd(fd) {}
+        ~QueuedFile()
+        {
+            close(fd);
+        }
+        int fd;
+    };
+
+    // A packet or file segment not fully written yet, sent from its sent byte on
+    struct OutboundPacket {
+        std::unique_ptr<uint8_t[]> data;
+        // Set for a file segment, which is written with sendfile from fileOffset instead of from data
+        std::unique_ptr<QueuedFile> file;
+        int64_t fileOffset{ 0 };
+        size_t length{ 0 };
+        size_t sent{ 0 };
+    };
 
     std::atomic<bool> isReceiving_{ false };
+    // Accepts still expected on the listening socket
+    int pendingAccepts_{ 0 };
+    // Sockets registered in the reactor, their handlers keep this connection alive until they are removed
+    std::mutex watchMtx_;
+    std::vector<int> watchedFds_;
     TcpSocket socket_;
     // 连接的客户端套接字
     int remoteSocket_{ INVALID_SOCKET };
     // 音频通道
     std::shared_ptr<TcpConnection> tcpAudioConn_{ nullptr };
     std::mutex connectionMtx_;
+    // Data socket registration: EPOLLIN while receiving, EPOLLOUT while packets wait in the send queue
+    std::mutex ioMtx_;
+    int ioFd_{ INVALID_SOCKET };
+    uint32_t ioEvents_{ 0 };
+    std::shared_ptr<ReceiveState> receiveState_;
+    // keeps the packets sent by different threads from interleaving, and guards the send queue
+    std::mutex sendMtx_;
+    std::deque<OutboundPacket> sendQueue_;
+    size_t queuedBytes_{ 0 };
+    // Whether sendQueue_ holds anything, read without sendMtx_ by senders to copy a packet before taking it
+    std::atomic<bool> hasQueued_{ false };
+    bool congested_{ false };
+    bool sendFailed_{ false };
+    SendQueueStats sendStats_;
 };
 } // namespace CastEngineService
 } // namespace CastEngine
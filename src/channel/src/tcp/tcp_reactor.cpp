@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: epoll event loops driving the sockets of all tcp connections.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "tcp_reactor.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "cast_engine_log.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+DEFINE_CAST_ENGINE_LABEL("CastEngine-TcpReactor");
+
+namespace {
+constexpr int GENERATION_SHIFT = 32;
+constexpr uint64_t FD_MASK = 0xFFFFFFFF;
+}
+
+TcpReactor &TcpReactor::GetInstance()
+{
+    static TcpReactor instance;
+    return instance;
+}
+
+TcpReactor::TcpReactor()
+{
+    running_.store(true);
+    for (size_t i = 0; i < IO_THREAD_COUNT; i++) {
+        auto loop = std::make_unique<Loop>();
+        loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (loop->epollFd < 0 || loop->wakeFd < 0) {
+            CLOGE("Create epoll loop error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+        } else {
+            // Generation 0 is never given to a socket, so the data of the wake fd is the fd alone
+            struct epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = static_cast<uint64_t>(loop->wakeFd);
+            epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->wakeFd, &event);
+            Loop *rawLoop = loop.get();
+            std::lock_guard<std::mutex> lock(loop->mutex);
+            loop->thread = std::thread(&TcpReactor::RunLoop, this, std::ref(*rawLoop));
+            loop->threadId = loop->thread.get_id();
+        }
+        loops_.push_back(std::move(loop));
+    }
+}
+
+TcpReactor::~TcpReactor()
+{
+    running_.store(false);
+    for (auto &loop : loops_) {
+        if (loop->wakeFd >= 0) {
+            uint64_t value = 1;
+            static_cast<void>(write(loop->wakeFd, &value, sizeof(value)));
+        }
+        if (loop->thread.joinable()) {
+            loop->thread.join();
+        }
+        if (loop->wakeFd >= 0) {
+            close(loop->wakeFd);
+        }
+        if (loop->epollFd >= 0) {
+            close(loop->epollFd);
+        }
+    }
+}
+
+TcpReactor::Loop &TcpReactor::GetLoop(int fd)
+{
+    return *loops_[static_cast<size_t>(fd) % loops_.size()];
+}
+
+bool TcpReactor::Add(int fd, uint32_t events, EventHandler handler)
+{
+    return Register(fd, events, std::move(handler), EPOLL_CTL_ADD);
+}
+
+bool TcpReactor::Modify(int fd, uint32_t events, EventHandler handler)
+{
+    return Register(fd, events, std::move(handler), EPOLL_CTL_MOD);
+}
+
+bool TcpReactor::Register(int fd, uint32_t events, EventHandler handler, int op)
+{
+    if (fd < 0 || !handler) {
+        return false;
+    }
+    Loop &loop = GetLoop(fd);
+    if (loop.epollFd < 0) {
+        return false;
+    }
+    uint32_t generation = ++nextGeneration_;
+    if (generation == 0) {
+        generation = ++nextGeneration_;
+    }
+    std::lock_guard<std::mutex> lock(loop.mutex);
+    struct epoll_event event{};
+    event.events = events;
+    event.data.u64 = (static_cast<uint64_t>(generation) << GENERATION_SHIFT) | static_cast<uint32_t>(fd);
+    if (epoll_ctl(loop.epollFd, op, fd, &event) < 0) {
+        CLOGE("epoll_ctl %{public}d error, fd = %{public}d, errno = %{public}d, errmsg = %{public}s.", op, fd, errno,
+            strerror(errno));
+        return false;
+    }
+    Registration &registration = loop.registrations[fd];
+    registration.generation = generation;
+    registration.handler = std::make_shared<EventHandler>(std::move(handler));
+    return true;
+}
+
+bool TcpReactor::IsIoThread(std::thread::id id) const
+{
+    for (const auto &loop : loops_) {
+        if (loop->threadId == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TcpReactor::Remove(int fd)
+{
+    if (fd < 0) {
+        return true;
+    }
+    Loop &loop = GetLoop(fd);
+    std::unique_lock<std::mutex> lock(loop.mutex);
+    if (loop.registrations.erase(fd) > 0) {
+        epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    // On the thread of the loop, a running handler of fd is the caller itself
+    auto self = std::this_thread::get_id();
+    if (loop.threadId == self || loop.runningFd != fd) {
+        return true;
+    }
+    // Waiting on another I/O thread could wait for a handler that waits for this one
+    if (IsIoThread(self)) {
+        return false;
+    }
+    loop.idleCond.wait(lock, [&loop, fd] { return loop.runningFd != fd; });
+    return true;
+}
+
+void TcpReactor::RunLoop(Loop &loop)
+{
+    CLOGI("Tcp reactor loop in.");
+    struct epoll_event events[MAX_EVENTS];
+    while (running_.load()) {
+        int count = epoll_wait(loop.epollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            CLOGE("epoll_wait error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+            break;
+        }
+        for (int i = 0; i < count && running_.load(); i++) {
+            if (events[i].data.u64 == static_cast<uint64_t>(loop.wakeFd)) {
+                uint64_t value = 0;
+                static_cast<void>(read(loop.wakeFd, &value, sizeof(value)));
+                continue;
+            }
+            Dispatch(loop, events[i].data.u64, events[i].events);
+        }
+    }
+    CLOGI("Tcp reactor loop out.");
+}
+
+void TcpReactor::Dispatch(Loop &loop, uint64_t data, uint32_t events)
+{
+    int fd = static_cast<int>(data & FD_MASK);
+    uint32_t generation = static_cast<uint32_t>(data >> GENERATION_SHIFT);
+    std::shared_ptr<EventHandler> handler;
+    {
+        std::lock_guard<std::mutex> lock(loop.mutex);
+        auto iter = loop.registrations.find(fd);
+        // Removed, or removed and added again, after epoll_wait returned
+        if (iter == loop.registrations.end() || iter->second.generation != generation) {
+            return;
+        }
+        handler = iter->second.handler;
+        loop.runningFd = fd;
+    }
+    (*handler)(events);
+    std::lock_guard<std::mutex> lock(loop.mutex);
+    loop.runningFd = -1;
+    loop.idleCond.notify_all();
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
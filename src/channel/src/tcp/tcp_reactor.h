@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: epoll event loops driving the sockets of all tcp connections.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef TCP_REACTOR_H
+#define TCP_REACTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+/*
+ * A fixed pool of I/O threads, each waiting in epoll on its share of the sockets. A socket always belongs to the
+ * same thread, so its handler never runs concurrently with itself. Handlers run on the I/O thread and must not
+ * block on the network, every connection of the service shares these threads.
+ */
+class TcpReactor final {
+public:
+    // Called with the ready epoll events of the socket
+    using EventHandler = std::function<void(uint32_t events)>;
+
+    static TcpReactor &GetInstance();
+
+    bool Add(int fd, uint32_t events, EventHandler handler);
+    // Changes the events waited for and the handler called for them
+    bool Modify(int fd, uint32_t events, EventHandler handler);
+    /*
+     * Once it returns true, the handler of fd does not run anymore, unless it is called from that handler itself.
+     * Called on another I/O thread than the one of fd, it does not wait for a running handler, which might wait for
+     * this thread, and returns false. fd must not be closed before that handler ends then.
+     */
+    bool Remove(int fd);
+
+    static constexpr size_t IO_THREAD_COUNT = 2;
+
+private:
+    struct Registration {
+        uint32_t generation{ 0 };
+        std::shared_ptr<EventHandler> handler;
+    };
+
+    struct Loop {
+        int epollFd{ -1 };
+        int wakeFd{ -1 };
+        std::thread thread;
+        std::thread::id threadId;
+        std::mutex mutex;
+        std::condition_variable idleCond;
+        std::unordered_map<int, Registration> registrations;
+        // Socket whose handler is running, -1 if none
+        int runningFd{ -1 };
+    };
+
+    TcpReactor();
+    ~TcpReactor();
+    TcpReactor(const TcpReactor &) = delete;
+    TcpReactor &operator=(const TcpReactor &) = delete;
+
+    Loop &GetLoop(int fd);
+    bool IsIoThread(std::thread::id id) const;
+    bool Register(int fd, uint32_t events, EventHandler handler, int op);
+    void RunLoop(Loop &loop);
+    void Dispatch(Loop &loop, uint64_t data, uint32_t events);
+
+    static constexpr int MAX_EVENTS = 32;
+
+    std::vector<std::unique_ptr<Loop>> loops_;
+    // Tags the epoll data of a registration, so an event of a closed socket is not given to a new one on the same fd
+    std::atomic<uint32_t> nextGeneration_{ 0 };
+    std::atomic<bool> running_{ false };
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // TCP_REACTOR_H
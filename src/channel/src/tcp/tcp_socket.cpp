@@ -18,7 +18,10 @@
 
 #include "tcp_socket.h"
 
+#include <sys/sendfile.h>
+
 #include "cast_engine_log.h"
+#include "recv_ring_buffer.h"
 #include "securec.h"
 
 namespace OHOS {
@@ -111,17 +114,36 @@ bool TcpSocket::Listen(int backlog)
     return true;
 }
 
-bool TcpSocket::Connect(const std::string & ip, int port)
+bool TcpSocket::ConnectAsync(const std::string &ip, int port)
 {
+    if (!SetNonBlocking(socket_, true)) {
+        return false;
+    }
     struct sockaddr_in sockaddr{};
     sockaddr.sin_family = AF_INET;
     sockaddr.sin_addr.s_addr = inet_addr(ip.c_str());
     sockaddr.sin_port = htons(port);
-    if (::connect(socket_, reinterpret_cast<struct sockaddr *>(&sockaddr), sizeof(sockaddr)) < RET_OK) {
+    if (::connect(socket_, reinterpret_cast<struct sockaddr *>(&sockaddr), sizeof(sockaddr)) < RET_OK &&
+        errno != EINPROGRESS) {
         CLOGE("Socket connect error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
         return false;
     }
+    return true;
+}
+
+bool TcpSocket::FinishConnect()
+{
+    int error = 0;
+    socklen_t errorLen = sizeof(error);
+    if (getsockopt(socket_, SOL_SOCKET, SO_ERROR, &error, &errorLen) < RET_OK) {
+        error = errno;
+    }
+    if (error != 0) {
+        CLOGE("Socket connect error: errno = %{public}d, errmsg = %{public}s.", error, strerror(error));
+        return false;
+    }
     CLOGD("Socket connect success.");
+    // Stays non-blocking, sends queue what the socket doesn't take and reads take only what has arrived
     return true;
 }
 
@@ -129,6 +151,10 @@ int TcpSocket::Accept()
 {
     int connfd = ::accept(socket_, nullptr, nullptr);
     if (connfd < RET_OK) {
+        // A listening socket driven by the reactor is non-blocking, the connection may be gone before the accept
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return INVALID_SOCKET;
+        }
         CLOGE("Socket accept error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
         return INVALID_SOCKET;
     }
@@ -136,39 +162,103 @@ int TcpSocket::Accept()
     return connfd;
 }
 
-int TcpSocket::Send(int fd, const uint8_t *buff, size_t length)
+ssize_t TcpSocket::SendAvailableV(int fd, const struct iovec *iov, int iovcnt)
 {
-    auto ret = ::send(fd, buff, length, SOCKET_FLAG);
-    if (ret < RET_OK) {
-        CLOGE("Socket send error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+    struct msghdr msg{};
+    msg.msg_iov = const_cast<struct iovec *>(iov);
+    msg.msg_iovlen = static_cast<size_t>(iovcnt);
+    while (true) {
+        ssize_t ret = ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret >= RET_OK) {
+            return ret;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        CLOGE("Socket sendmsg error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+        return RET_ERR;
     }
-    return ret;
 }
 
-ssize_t TcpSocket::Recv(int fd, uint8_t *buff, size_t length)
+ssize_t TcpSocket::SendFileAvailable(int fd, int inFd, int64_t offset, size_t length)
 {
-    size_t recvLen = 0;
-    while (recvLen < length) {
-        ssize_t len;
-        int error;
-        do {
-            len = ::recv(fd, buff + recvLen, length - recvLen, SOCKET_FLAG);
-            error = errno;
-            if (stopReceive_) {
-                return STOP_RECEIVE;
-            }
-        } while (len <= 0 && (error == EINTR || error == EAGAIN));
-
-        if (len < RET_OK) {
-            CLOGE("Socket recv error: errno = %{public}d, errmsg = %{public}s.", error, strerror(error));
+    off_t fileOffset = static_cast<off_t>(offset);
+    while (length > 0) {
+        ssize_t ret = ::sendfile(fd, inFd, &fileOffset, length);
+        if (ret > 0) {
+            return ret;
+        }
+        if (ret == 0) {
+            CLOGE("Socket sendfile reach end of file, remain %{public}zu", length);
             return RET_ERR;
         }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        CLOGE("Socket sendfile error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+        return RET_ERR;
+    }
+    return 0;
+}
 
-        recvLen += static_cast<size_t>(len);
+ssize_t TcpSocket::RecvAvailable(int fd, uint8_t *buff, size_t length)
+{
+    while (true) {
+        ssize_t len = ::recv(fd, buff, length, MSG_DONTWAIT);
+        if (len > 0) {
+            return len;
+        }
+        if (len == 0) {
+            CLOGE("Socket recv error: closed by peer.");
+            return RET_ERR;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        CLOGE("Socket recv error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+        return RET_ERR;
     }
+}
 
-    CLOGD("Socket recv DONE!, size:%zu", recvLen);
-    return recvLen;
+ssize_t TcpSocket::RecvAvailable(int fd, RecvRingBuffer &ring)
+{
+    struct iovec iov[2];
+    int iovcnt = ring.GetFreeSegments(iov);
+    if (iovcnt == 0) {
+        CLOGE("Socket recv error: no room in the ring buffer.");
+        return RET_ERR;
+    }
+    struct msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = static_cast<size_t>(iovcnt);
+    while (true) {
+        ssize_t len = ::recvmsg(fd, &msg, MSG_DONTWAIT);
+        if (len > 0) {
+            ring.Commit(static_cast<size_t>(len));
+            return len;
+        }
+        if (len == 0) {
+            CLOGE("Socket recv error: closed by peer.");
+            return RET_ERR;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        CLOGE("Socket recv error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+        return RET_ERR;
+    }
 }
 
 void TcpSocket::Close()
@@ -182,7 +272,6 @@ void TcpSocket::Close()
 void TcpSocket::Shutdown(int fd)
 {
     if (fd > INVALID_SOCKET) {
-        stopReceive_ = true;
         ::shutdown((fd), SHUT_RDWR);
     }
 }
@@ -267,6 +356,21 @@ bool TcpSocket::SetReuseAddr()
     return true;
 }
 
+bool TcpSocket::SetNonBlocking(int fd, bool nonBlocking)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < RET_OK) {
+        CLOGE("Socket SetNonBlocking error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+        return false;
+    }
+    flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if (fcntl(fd, F_SETFL, flags) < RET_OK) {
+        CLOGE("Socket SetNonBlocking error: errno = %{public}d, errmsg = %{public}s.", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 } // namespace CastEngineService
 } // namespace CastEngine
 } // namespace OHOS
\ No newline at end of file
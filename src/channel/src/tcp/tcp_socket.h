@@ -27,11 +27,14 @@
 #include <netinet/tcp.h>
 #include <string>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace OHOS {
 namespace CastEngine {
 namespace CastEngineService {
+class RecvRingBuffer;
+
 class TcpSocket {
 public:
     TcpSocket();
@@ -40,9 +43,17 @@ public:
     int Bind(const std::string &ip, int port);
     bool Listen(int backlog);
     int Accept();
-    bool Connect(const std::string &ip, int port);
-    int Send(int fd, const uint8_t *buff, size_t length);
-    ssize_t Recv(int fd, uint8_t *buff, size_t length);
+    // Starts connecting without waiting, the socket turns writable once connected or failed
+    bool ConnectAsync(const std::string &ip, int port);
+    bool FinishConnect();
+    // Writes what the socket takes without waiting, 0 if it takes nothing, RET_ERR on error
+    ssize_t SendAvailableV(int fd, const struct iovec *iov, int iovcnt);
+    // Same for length bytes of the file inFd from offset, fd has to be non-blocking
+    ssize_t SendFileAvailable(int fd, int inFd, int64_t offset, size_t length);
+    // Reads what is available without waiting, 0 if nothing is, RET_ERR on error or when the peer closed
+    ssize_t RecvAvailable(int fd, uint8_t *buff, size_t length);
+    // Same, filling the free space of the ring with one scatter read
+    ssize_t RecvAvailable(int fd, RecvRingBuffer &ring);
     void Close();
     void Shutdown(int fd);
     int GetPeerPort(int fd);
@@ -58,20 +69,18 @@ public:
     bool SetKeepAlive(unsigned idleTime, unsigned numProbes, unsigned probeInterval);
     // 设置SO_REUSEADDR，对应TCP套接字处于TIME_WAIT状态下的socket可以重复绑定使用
     bool SetReuseAddr();
+    static bool SetNonBlocking(int fd, bool nonBlocking);
 
 private:
     static constexpr int RANDOM_PORT = 0;
     static constexpr int INVALID_PORT = -1;
     static constexpr int INVALID_SOCKET = -1;
     static constexpr int DEFAULT_VALUE = 0;
-    static constexpr int SOCKET_FLAG = 0;
     static constexpr int SOCKET_OFF = 0;
     static constexpr int SOCKET_ON = 1;
     static constexpr int RET_OK = 0;
     static constexpr int RET_ERR = -1;
-    static constexpr int STOP_RECEIVE = -2;
     
-    bool stopReceive_{ false };
     int GetBindPort();
     int socket_;
 };
@@ -161,30 +161,23 @@ bool RtspChannelManager::SendData(const std::string &dataFrame)
         return false;
     }
     size_t pktlen = dataFrame.size();
-    std::unique_ptr<uint8_t[]> encryptContent = std::make_unique<uint8_t[]>(pktlen + EncryptDecrypt::AES_IV_LEN);
-    PacketData outputData = { encryptContent.get(), 0 };
     if (channel->GetRequest().linkType == ChannelLinkType::SOFT_BUS ||
         Utils::IsArrayAllZero(sessionKeys_, SESSION_KEY_LENGTH) || algorithmId_ <= 0) {
-        errno_t ret = memcpy_s(encryptContent.get(), pktlen + EncryptDecrypt::AES_IV_LEN, dataFrame.c_str(), pktlen);
-        if (ret != EOK) {
-            CLOGE("ERROR: memory copy error:%{public}d", ret);
-            return false;
-        }
-
-        outputData.length = static_cast<int>(pktlen);
-        CLOGD("SendData, get data finish.");
-    } else {
-        bool ret = EncryptDecrypt::GetInstance().EncryptData(algorithmId_, sessionKeys_, sessionKeyLength_,
-            { reinterpret_cast<const uint8_t *>(dataFrame.c_str()), pktlen }, outputData);
-        if (!ret || (outputData.length != static_cast<int>(pktlen) + static_cast<int>(EncryptDecrypt::AES_IV_LEN))) {
-            CLOGE("Encrypt data failed, dataLength: %{public}d, pktlen: %{public}zu", outputData.length, pktlen);
-            return false;
-        }
-        CLOGD("SendData, encrypt data finish.");
+        // Sent as it is, straight from the string
+        CLOGD("SendData, pktlen %{public}zu send buffer %{public}s.", pktlen, dataFrame.c_str());
+        return channel->Send(reinterpret_cast<const uint8_t *>(dataFrame.data()), static_cast<int>(pktlen));
     }
 
-    CLOGD("SendData, outputData.length %{public}d pktlen %{public}zu send buffer %{public}s.", outputData.length,
-        pktlen, encryptContent.get());
+    std::unique_ptr<uint8_t[]> encryptContent = std::make_unique<uint8_t[]>(pktlen + EncryptDecrypt::AES_IV_LEN);
+    PacketData outputData = { encryptContent.get(), 0 };
+    bool ret = EncryptDecrypt::GetInstance().EncryptData(algorithmId_, sessionKeys_, sessionKeyLength_,
+        { reinterpret_cast<const uint8_t *>(dataFrame.c_str()), pktlen }, outputData);
+    if (!ret || (outputData.length != static_cast<int>(pktlen) + static_cast<int>(EncryptDecrypt::AES_IV_LEN))) {
+        CLOGE("Encrypt data failed, dataLength: %{public}d, pktlen: %{public}zu", outputData.length, pktlen);
+        return false;
+    }
+    CLOGD("SendData, encrypt data finish, outputData.length %{public}d pktlen %{public}zu.", outputData.length,
+        pktlen);
     return channel->Send(encryptContent.get(), outputData.length);
 }
 
@@ -73,6 +73,7 @@ private:
 
     std::shared_ptr<CastStreamPlayerManager> PlayerGetter();
     bool ParseMediaInfoHolder(const json &data, MediaInfoHolder &mediaInfoHolder);
+    static size_t GetCurrentIndex(const MediaInfoHolder &mediaInfoHolder);
 
     std::shared_ptr<CastStreamPlayerManager> player_;
 };
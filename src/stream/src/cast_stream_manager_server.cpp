@@ -243,6 +243,13 @@ bool CastStreamManagerServer::ParseMediaInfoHolder(const json &data, MediaInfoHo
     return true;
 }
 
+// Senders that only know the current item send it alone with index 0, an index out of the list means the same
+size_t CastStreamManagerServer::GetCurrentIndex(const MediaInfoHolder &mediaInfoHolder)
+{
+    size_t index = static_cast<size_t>(mediaInfoHolder.currentIndex);
+    return index < mediaInfoHolder.mediaInfoList.size() ? index : 0;
+}
+
 bool CastStreamManagerServer::ProcessActionLoad(const json &data)
 {
     CLOGI("in");
@@ -256,7 +263,15 @@ bool CastStreamManagerServer::ProcessActionLoad(const json &data)
         CLOGE("ParseMediaInfoHolder failed");
         return false;
     }
-    return player->Load(mediaInfoHolder.mediaInfoList.front());
+    if (mediaInfoHolder.mediaInfoList.empty()) {
+        CLOGE("mediaInfo list is empty");
+        return false;
+    }
+    size_t index = GetCurrentIndex(mediaInfoHolder);
+    bool ret = player->Load(mediaInfoHolder.mediaInfoList[index]);
+    // After the current item, so decoding ahead does not hold up its transfer
+    player->SetPlaylist(mediaInfoHolder.mediaInfoList, index);
+    return ret;
 }
 
 bool CastStreamManagerServer::ProcessActionPlay(const json &data)
@@ -272,7 +287,15 @@ bool CastStreamManagerServer::ProcessActionPlay(const json &data)
         CLOGE("ParseMediaInfoHolder failed");
         return false;
     }
-    return player->InnerPlay(mediaInfoHolder.mediaInfoList.front());
+    if (mediaInfoHolder.mediaInfoList.empty()) {
+        CLOGE("mediaInfo list is empty");
+        return false;
+    }
+    size_t index = GetCurrentIndex(mediaInfoHolder);
+    bool ret = player->InnerPlay(mediaInfoHolder.mediaInfoList[index]);
+    // After the current item, so decoding ahead does not hold up its transfer
+    player->SetPlaylist(mediaInfoHolder.mediaInfoList, index);
+    return ret;
 }
 
 bool CastStreamManagerServer::ProcessActionPause(const json &data)
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: block granular sparse cache of a remote local file
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+/*
+ * File data is cached in fixed size blocks aligned to BLOCK_SIZE in the file. All blocks are carved out of one
+ * arena allocated up front, so the memory budget is the arena capacity. Blocks are indexed by their position
+ * in the file, a seek only allocates the blocks it needs and keeps the ones that are already fetched.
+ * A reader waiting for the data at the fill position of a block gets it written straight into its buffer when it
+ * arrives. Those bytes are not cached, the block then holds only the data after them, unless it already held data
+ * before them.
+ */
+class BlockCache final {
+public:
+    explicit BlockCache(int64_t fileLength, int64_t capacity = DEFAULT_CAPACITY);
+    ~BlockCache();
+
+    bool IsValid();
+    int64_t GetCapacity() const;
+    bool IsCached(int64_t pos);
+    int64_t Read(uint8_t *data, uint32_t length, int64_t pos, int64_t waitTimeMs);
+    void Abort();
+    bool Write(const uint8_t *data, int64_t offset, int64_t length);
+    bool FindMissingRange(int64_t pos, int64_t aheadLimit, int64_t &start, int64_t &end);
+    bool MarkRequested(int64_t start, int64_t end, int64_t protectStart, int64_t protectEnd);
+    void MarkCredited(int64_t start, int64_t end);
+    void CancelRequested(int64_t start, int64_t end);
+
+    static constexpr int64_t BLOCK_SIZE = 256 * 1024;                     // 256KB
+    static constexpr int64_t DEFAULT_CAPACITY = 20 * 1024 * 1024;         // 20MB
+    // DSoftbus sends at most 2MB at one time and the server reserves 1KB of it for the http header
+    static constexpr int64_t SINGLE_REQUEST_MAX_SIZE = 7 * BLOCK_SIZE;    // 1.75MB
+    static constexpr int64_t FIRST_REQUEST_SIZE = 4 * BLOCK_SIZE;         // 1MB
+
+private:
+    struct Block {
+        int64_t offset{ 0 };
+        // The block holds the data in [begin, filled), begin is past 0 only after a direct read
+        int64_t begin{ 0 };
+        int64_t filled{ 0 };
+        int64_t requestTimeMs{ 0 };
+        // Requested under credit, the data or a failure comes for sure and the request is not retried early
+        bool credited{ false };
+        int64_t lastUsedTimeUs{ 0 };
+        uint8_t *data{ nullptr };
+    };
+
+    Block *FindBlockLocked(int64_t pos);
+    Block *AllocBlockLocked(int64_t index, int64_t protectStart, int64_t protectEnd);
+    int64_t GetBlockLength(int64_t offset) const;
+    bool IsCompleteLocked(const Block &block) const;
+    bool IsInFlightLocked(const Block &block, int64_t now) const;
+    bool IsMissingLocked(const Block *block, int64_t now) const;
+    bool IsMissingAtLocked(const Block *block, int64_t pos, int64_t now) const;
+    void FreeBlockLocked(int64_t index);
+
+    bool IsReadyLocked(int64_t pos);
+    int64_t WriteRangeLocked(const uint8_t *data, int64_t offset, int64_t start, int64_t end);
+    bool WriteDirectLocked(const uint8_t *data, int64_t offset, int64_t end);
+
+    static constexpr int REQUEST_RETRY_TIME_INTERVAL_MS = 3000;
+    static constexpr int CREDITED_REQUEST_RETRY_TIME_INTERVAL_MS = 30000;
+
+    // Buffer of the reader waiting at a fill position, valid while it is registered
+    struct DirectRead {
+        int64_t pos{ 0 };
+        uint8_t *data{ nullptr };
+        int64_t length{ 0 };
+        int64_t delivered{ 0 };
+    };
+
+    std::mutex dataMutex_;
+    std::condition_variable dataCond_;
+    std::unique_ptr<uint8_t[]> arena_;
+    std::vector<uint8_t *> freeBlocks_;
+    std::map<int64_t, Block> blocks_;
+    int64_t fileLength_{ 0 };
+    int64_t capacity_{ 0 };
+    // Bumped by every cancel, so a waiting reader can tell that it should look again at whether its data is missing
+    uint64_t cancelSequence_{ 0 };
+    bool aborted_{ false };
+    DirectRead *directRead_{ nullptr };
+    uint64_t directBytes_{ 0 };
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // BLOCK_CACHE_H
@@ -19,12 +19,14 @@
 #ifndef CAST_LOCAL_FILE_CHANNEL_CLIENT_H
 #define CAST_LOCAL_FILE_CHANNEL_CLIENT_H
 
+#include <atomic>
 #include <string>
 #include <map>
-#include <list>
+#include <vector>
 #include <condition_variable>
 
 #include "cast_engine_common.h"
+#include "cast_local_file_channel_common.h"
 #include "channel_listener.h"
 #include "channel.h"
 #include "i_cast_local_file_channel.h"
@@ -47,24 +49,59 @@ public:
 
     void OnDataReceived(const uint8_t *buffer, unsigned int length, long timeCost) override;
 
-    void RequestByteData(int64_t start, int64_t end, const std::string &fileId);
+    bool RequestByteData(int64_t start, int64_t end, const std::string &fileId, uint16_t priority,
+        uint32_t &requestId);
+    bool RequestBulkData(int64_t start, int64_t end, const std::string &fileId, uint16_t priority,
+        uint32_t &requestId);
+    bool CancelRequest(uint32_t requestId, const std::string &fileId);
     int64_t RequestFileLength(const std::string &fileId);
 
     void NotifyCreateChannel();
     void WaitCreateChannel();
-    void AddDataListener(std::shared_ptr<IDataListener> dataListener);
-    void RemoveDataListener(std::shared_ptr<IDataListener> dataListener);
+    void AddDataListener(const std::string &fileId, std::shared_ptr<IDataListener> dataListener);
+    void RemoveDataListener(const std::string &fileId, std::shared_ptr<IDataListener> dataListener);
 
 private:
     std::weak_ptr<ICastStreamManagerServer> callback_;
     std::shared_ptr<Channel> channel_;
-    std::list<std::shared_ptr<IDataListener>> dataListeners_;
+    using DataListeners = std::vector<std::shared_ptr<IDataListener>>;
+    /*
+     * Listeners by the file id they read, more than one only while an item is replaced by the same file. A file's
+     * listeners are replaced instead of changed, so a response takes them with a single shared_ptr copy.
+     */
+    std::map<std::string, std::shared_ptr<const DataListeners>, std::less<>> dataListeners_;
     std::condition_variable cond_;
     std::mutex chLock_;
     std::mutex listenerLock_;
+    // Set once the server echoed the binary framing offer, cleared with the channel
+    std::atomic<bool> binaryFraming_{ false };
+    std::atomic<uint32_t> requestId_{ 0 };
 
-    bool ProcessServerResponse(const uint8_t *buffer, unsigned int length, std::map<std::string, std::string> &response,
-        size_t &dataOffset);
+    // Credit granted to the server per file and the binary response bytes received against it
+    struct FileCredit {
+        int64_t granted = 0;
+        int64_t received = 0;
+    };
+    std::mutex creditLock_;
+    // Ordered maps, looked up with the file id viewed in the received packet
+    std::map<std::string, FileCredit, std::less<>> credits_;
+    // Bytes the server may have in flight per file, a little more than the largest prefetch window of a data source
+    static constexpr int64_t CREDIT_WINDOW = 8 * 1024 * 1024;
+    // Credit is given back once this much of it is used
+    static constexpr int64_t CREDIT_GRANT_STEP = 2 * 1024 * 1024;
+
+    bool ProcessServerResponse(const uint8_t *buffer, unsigned int length, HttpResponseHeader &response);
+    void ProcessHttpResponse(const uint8_t *buffer, unsigned int length);
+    void ProcessBinaryResponse(const uint8_t *buffer, unsigned int length);
+    bool SendBinaryRequest(std::shared_ptr<Channel> channel, uint8_t type, int64_t start, int64_t end,
+        const std::string &fileId, uint16_t priority, uint32_t &requestId);
+    std::shared_ptr<Channel> GetChannel();
+    void ResetCredits();
+    bool EnsureCredit(std::shared_ptr<Channel> channel, const std::string &fileId);
+    void OnCreditUsed(std::string_view fileId, int64_t length);
+    bool SendCredit(std::shared_ptr<Channel> channel, std::string_view fileId, int64_t length);
+    void NotifyDataListeners(std::string_view fileId, const uint8_t *data, int64_t start, int64_t length);
+    void NotifyRequestFailed(std::string_view fileId, int64_t start);
 };
 } // namespace CastEngineService
 } // namespace CastEngine
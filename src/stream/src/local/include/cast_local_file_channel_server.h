@@ -19,14 +19,23 @@
 #ifndef CAST_LOCAL_FILE_CHANNEL_SERVER_H
 #define CAST_LOCAL_FILE_CHANNEL_SERVER_H
 
+#include <atomic>
+#include <condition_variable>
 #include <string>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "cast_engine_common.h"
+#include "cast_local_file_channel_common.h"
 #include "channel_listener.h"
 #include "channel.h"
 #include "i_cast_local_file_channel.h"
+#include "shared_read_cache.h"
 
 namespace OHOS {
 namespace CastEngine {
@@ -48,31 +57,159 @@ public:
 
     void OnDataReceived(const uint8_t *buffer, unsigned int length, long timeCost) override;
 
+    struct ReadStats {
+        uint64_t dataRequests = 0;
+        // Data requests whose whole range had been hinted to the kernel ahead of them
+        uint64_t readAheadHits = 0;
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+    };
+    void GetReadStats(ReadStats &stats);
+
 private:
     struct LocalFileInfo {
         std::string encodedUrl;
+        // The encoded url shared with the requests of the file, so queueing a request copies no string
+        std::shared_ptr<const std::string> sharedId;
         std::string localFile;
         int fd = INVALID_VALUE;
         int64_t fileLen = 0;
     };
 
-    std::map<std::string, struct LocalFileInfo> fileMap_;
-    std::shared_ptr<Channel> channel_;
-    std::mutex chLock_;
+    struct FileRequest {
+        std::shared_ptr<const std::string> uri;
+        int64_t start = 0;
+        int64_t end = 0;
+        uint32_t requestId = 0;
+        uint16_t priority = 0;
+        bool binaryFrame = false;
+        bool acceptBinaryFrame = false;
+        bool bulk = false;
+        // Arrival order, and the turn of the response on the channel once a worker takes the request
+        uint64_t sequence = 0;
+        uint64_t sendTicket = 0;
+        // Credit of its file taken for the response, what is not sent goes back
+        int64_t creditUsed = 0;
+    };
+
+    struct RequestOrder {
+        bool operator()(const FileRequest &lhs, const FileRequest &rhs) const
+        {
+            if (lhs.priority != rhs.priority) {
+                return lhs.priority < rhs.priority;
+            }
+            return lhs.sequence > rhs.sequence;
+        }
+    };
+
+    // One connected sink, all fields but channel and id are guarded by taskLock_
+    struct Sink {
+        uint32_t id = 0;
+        std::shared_ptr<Channel> channel;
+        bool removed = false;
+        // Heap ordered by RequestOrder, a plain vector so that a cancelled request can be taken out
+        std::vector<FileRequest> pendingRequests;
+        // Requests waiting for credit of their file, back to pendingRequests once it is there
+        std::vector<FileRequest> parkedRequests;
+        // Bytes each file may still be sent, only the files the sink granted credit for are limited
+        std::map<std::string, int64_t, std::less<>> credits;
+        // Ids of the requests the workers are serving, and the ones of them cancelled by the sink. The parts of a
+        // bulk request are served under one id.
+        std::multiset<uint32_t> servingRequests;
+        std::set<uint32_t> cancelledRequests;
+        size_t servingCount = 0;
+        uint64_t requestSequence = 0;
+        uint64_t nextSendTicket = 0;
+        uint64_t sendingTicket = 0;
+        // Cleared once the channel can't send files at all, responses are then read into a buffer before their turn
+        std::atomic<bool> sendFileAvailable{ true };
+        // Set while the send queue of the channel is over its high watermark, no response gets its turn then
+        bool congested = false;
+    };
+
+    // Sequential access of one file, seen over the data requests of all sinks
+    struct ReadPattern {
+        int64_t lastEnd = 0;
+        int sequentialCount = 0;
+        // End of the range already hinted with WILLNEED
+        int64_t adviseEnd = 0;
+    };
+
+    // Installed on each channel so that its requests come in with the sink they belong to
+    class SinkListener : public IChannelListener {
+    public:
+        SinkListener(std::weak_ptr<CastLocalFileChannelServer> server, std::shared_ptr<Sink> sink)
+            : server_(server), sink_(sink) {}
+        void OnDataReceived(const uint8_t *buffer, unsigned int length, long timeCost) override;
+        void OnSendCongestionChanged(bool congested) override;
+
+    private:
+        std::weak_ptr<CastLocalFileChannelServer> server_;
+        std::weak_ptr<Sink> sink_;
+    };
+
+    // Looked up with the file id viewed in the received request
+    std::map<std::string, struct LocalFileInfo, std::less<>> fileMap_;
     std::mutex mapLock_;
+    std::mutex poolLock_;
+    std::vector<std::unique_ptr<uint8_t[]>> bufferPool_;
+    // Hot blocks of the files, reads not done with SendFile go through it
+    SharedReadCache readCache_;
+    std::mutex readAheadLock_;
+    std::map<std::string, ReadPattern> readPatterns_;
+    uint64_t dataRequestCount_ = 0;
+    uint64_t readAheadHitCount_ = 0;
+
+    std::atomic<bool> isRunning_{ false };
+    std::vector<std::thread> workers_;
+    std::map<uint32_t, std::shared_ptr<Sink>> sinks_;
+    uint32_t nextSinkId_ = 1;
+    // The sink served last, the workers go round the sinks from there
+    uint32_t lastServedSinkId_ = 0;
+    std::mutex taskLock_;
+    std::condition_variable taskCond_;
+    std::condition_variable sendCond_;
 
     int64_t GetFileLengthByFd(int fd);
     int64_t GetFileLengthByFileName(const std::string &file);
+    std::string GetFileVersionByFd(int fd);
     int FindLocalFd(const std::string &encodedUri);
     struct LocalFileInfo FindLocalFileInfo(const std::string &encodedUri);
     int64_t FindFileLengthByUri(const std::string &encodeUri);
+    std::shared_ptr<const std::string> FindSharedFileId(std::string_view encodedUri);
     void AddFileInfoToMap(const std::string encodedId, const struct LocalFileInfo &data);
     int ReadFileData(const struct LocalFileInfo &data, int64_t start, int64_t sendLen, uint8_t *ptr);
-    void ProcessRequestData(const uint8_t *buffer, int length);
-    void ResponseFileLengthRequest(const std::string &uri, int64_t fileLen);
-    void ResponseFileDataRequest(const std::string &uri, int64_t fileLen, int64_t start, int64_t end);
-    void ResponseFileRequest(const std::string &uri, int64_t start, int64_t end);
-    void SendData(const uint8_t *buffer, int length);
+    void ProcessRequestData(std::shared_ptr<Sink> sink, const uint8_t *buffer, int length);
+    void SetSinkCongested(Sink &sink, bool congested);
+    void EnqueueRequest(std::shared_ptr<Sink> sink, FileRequest &request);
+    void CancelRequest(std::shared_ptr<Sink> sink, uint32_t requestId);
+    void GrantCredit(std::shared_ptr<Sink> sink, std::string_view fileId, int64_t length);
+    bool TakeCreditLocked(Sink &sink, FileRequest &request);
+    void ReturnCreditLocked(Sink &sink, const FileRequest &request, int64_t sentLength);
+    void UnparkRequestsLocked(Sink &sink, std::string_view fileId);
+    void SplitBulkRequestLocked(Sink &sink, FileRequest &request);
+    bool IsRequestCancelled(const Sink &sink, uint32_t requestId);
+    std::shared_ptr<Sink> PickSinkLocked();
+    bool IsFanOut();
+    void WorkerLoop();
+    bool WaitSendTurn(Sink &sink, const FileRequest &request);
+    void FinishSendTurn(Sink &sink, uint64_t ticket);
+    bool ParseHttpFileRequest(const uint8_t *buffer, int length, FileRequest &request);
+    bool ParseBinaryFileRequest(const BinaryFrame &frame, FileRequest &request);
+    std::string MakeResponseHeader(const FileRequest &request, int64_t start, int64_t end, int64_t fileLen);
+    void ResponseFileLengthRequest(Sink &sink, const FileRequest &request, int64_t fileLen);
+    int64_t ResponseFileDataRequest(Sink &sink, const FileRequest &request, int64_t fileLen);
+    int64_t ResponseFileRequest(Sink &sink, const FileRequest &request);
+    void ResponseFailure(Sink &sink, const FileRequest &request, uint16_t status);
+    void SendFailureFrame(Sink &sink, const FileRequest &request, uint16_t status);
+    void UpdateReadAhead(const std::string &uri, int fd, int64_t start, int64_t end, int64_t fileLen);
+    int ReadThroughCache(const FileRequest &request, const struct LocalFileInfo &data, int64_t start, int sendLen,
+        uint8_t *ptr);
+    bool SendData(Sink &sink, const uint8_t *buffer, int length);
+    bool SendData(Sink &sink, const std::string &header, const uint8_t *buffer, int length);
+    SendFileResult SendFileData(Sink &sink, const std::string &header, int fd, int64_t start, int length);
+    std::unique_ptr<uint8_t[]> AcquireBuffer();
+    void ReleaseBuffer(std::unique_ptr<uint8_t[]> buffer);
     void ClearAllMapInfo();
     int ReadFileDataByFd(int fd, int64_t start, int sendLen, uint8_t *buffer);
 };
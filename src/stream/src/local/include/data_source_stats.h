@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: streaming counters of a local file data source
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef DATA_SOURCE_STATS_H
+#define DATA_SOURCE_STATS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+/*
+ * Latencies counted in power of two buckets: bucket 0 holds [0, 1)ms, bucket i holds [2^(i-1), 2^i)ms and the last
+ * bucket everything from 2^(BUCKET_COUNT-2)ms on.
+ */
+struct LatencyHistogram {
+    static constexpr size_t BUCKET_COUNT = 16;
+
+    uint64_t buckets[BUCKET_COUNT]{};
+    uint64_t count{ 0 };
+    int64_t totalMs{ 0 };
+    int64_t maxMs{ 0 };
+
+    void Add(int64_t ms)
+    {
+        ms = std::max(ms, static_cast<int64_t>(0));
+        size_t bucket = 0;
+        while (bucket + 1 < BUCKET_COUNT && (static_cast<int64_t>(1) << bucket) <= ms) {
+            bucket++;
+        }
+        buckets[bucket]++;
+        count++;
+        totalMs += ms;
+        maxMs = std::max(maxMs, ms);
+    }
+};
+
+struct DataSourceReadStats {
+    uint64_t reads{ 0 };
+    // Reads that found their first byte cached, the others waited for the channel
+    uint64_t cacheHits{ 0 };
+    uint64_t cacheMisses{ 0 };
+    // Reads that returned nothing once their timeout passed
+    uint64_t timeouts{ 0 };
+    // Bytes handed to readers and bytes that came over the channel, fetched far above consumed means cache thrash
+    uint64_t bytesConsumed{ 0 };
+    uint64_t bytesFetched{ 0 };
+    // Time the missed reads spent waiting for their data
+    LatencyHistogram waitTime;
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // DATA_SOURCE_STATS_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: persistent block cache of remote local files on the sink disk
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef DISK_BLOCK_CACHE_H
+#define DISK_BLOCK_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+/*
+ * Complete blocks of played files are kept in segment files of BLOCKS_PER_SEGMENT blocks under the service sandbox.
+ * A segment file is mapped as a whole: the block data followed by one presence byte per block. Segments are
+ * evicted least recently used first once the total size reaches the capacity, the use order survives restarts
+ * through the modification time of the segment files. The cache is off until SetCapacity gives it room.
+ */
+class DiskBlockCache final {
+public:
+    static DiskBlockCache &GetInstance();
+
+    static std::string MakeKey(const std::string &fileId, int64_t fileLength);
+    // A capacity of 0 turns the cache off and deletes its segment files
+    void SetCapacity(int64_t capacity);
+    bool IsEnabled();
+    bool ReadBlock(const std::string &key, int64_t index, uint8_t *data, int64_t length);
+    bool HasBlock(const std::string &key, int64_t index);
+    void WriteBlock(const std::string &key, int64_t index, const uint8_t *data, int64_t length);
+
+    static constexpr int64_t BLOCK_SIZE = 256 * 1024;                 // same as BlockCache
+    static constexpr int64_t BLOCKS_PER_SEGMENT = 16;                 // 4MB of data per segment
+    static constexpr int64_t DEFAULT_CAPACITY = 0;                    // off unless configured
+
+private:
+    struct Segment {
+        int fd{ -1 };
+        uint8_t *base{ nullptr };
+    };
+
+    DiskBlockCache() = default;
+    ~DiskBlockCache();
+    DiskBlockCache(const DiskBlockCache &) = delete;
+    DiskBlockCache &operator=(const DiskBlockCache &) = delete;
+
+    bool InitLocked();
+    Segment *OpenSegmentLocked(const std::string &name, bool create);
+    void CloseSegmentLocked(const std::string &name);
+    bool IsEnabledLocked();
+    bool ReserveLocked(int64_t newSegments);
+    void PurgeLocked();
+    void TouchLocked(const std::string &name);
+    std::string GetSegmentPath(const std::string &name) const;
+    static std::string GetSegmentName(const std::string &key, int64_t index);
+
+    static constexpr int64_t SEGMENT_DATA_SIZE = BLOCK_SIZE * BLOCKS_PER_SEGMENT;
+    static constexpr int64_t SEGMENT_FILE_SIZE = SEGMENT_DATA_SIZE + BLOCKS_PER_SEGMENT;
+    static constexpr size_t MAX_OPEN_SEGMENTS = 8;
+
+    std::mutex mutex_;
+    bool initialized_{ false };
+    bool scanned_{ false };
+    std::string directory_;
+    int64_t capacity_{ DEFAULT_CAPACITY };
+    // All segment files on disk, the least recently used first
+    std::list<std::string> lruList_;
+    std::map<std::string, std::list<std::string>::iterator> lruIndex_;
+    std::map<std::string, Segment> openSegments_;
+    std::list<std::string> openOrder_;
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // DISK_BLOCK_CACHE_H
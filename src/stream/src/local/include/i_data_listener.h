@@ -19,13 +19,20 @@
 #ifndef I_DATA_LISTENER_H
 #define I_DATA_LISTENER_H
 
+#include <cstdint>
+#include <string_view>
+
 namespace OHOS {
 namespace CastEngine {
 namespace CastEngineService {
+// The file id points into the received packet, it is only valid during the call. The calls come from the I/O thread
+// of the channel and must not block, as for IChannelListener.
 class IDataListener {
 public:
     virtual ~IDataListener() = default;
-    virtual bool OnBytesReceived(const std::string &fileId, const uint8_t *bytes, int64_t offset, int64_t length) = 0;
+    virtual bool OnBytesReceived(std::string_view fileId, const uint8_t *bytes, int64_t offset, int64_t length) = 0;
+    // The server could not serve the request starting at offset, it can be requested again at once
+    virtual void OnRequestFailed(std::string_view fileId, int64_t offset) {}
 };
 } // namespace CastEngineService
 } // namespace CastEngine
@@ -19,53 +19,29 @@
 #ifndef DATA_SOURCE_BUFFER_H
 #define DATA_SOURCE_BUFFER_H
 
-#include <mutex>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "block_cache.h"
 #include "cast_local_file_channel_client.h"
+#include "disk_block_cache.h"
 #include "cast_stream_common.h"
+#include "data_source_stats.h"
 #include "i_data_listener.h"
 #include "media_data_source.h"
+#include "prefetch_window.h"
 
 namespace OHOS {
 namespace CastEngine {
 namespace CastEngineService {
-class Cache final {
-public:
-    Cache(int64_t pos, int64_t capacity = MAX_BUFFER_SIZE);
-    ~Cache();
-    int64_t Read(uint8_t *data, uint32_t length, int64_t pos = 0);
-    bool Write(const uint8_t *data, int64_t offset, int64_t length);
-    bool IsMatch(int64_t pos);
-    bool IsValid();
-    int IsNeedReqData(int64_t &start, int64_t &end);
-    void Reset(int64_t pos);
-    int64_t GetUsedTime();
-
-    static const int NO_NEED_REQ = 0;
-    static const int NEED_REQ_IN_CURR_CACHE = 1;
-    static const int NEED_REQ_IN_NEXT_CACHE = 2;
-
-private:
-    void UpdateUsedTimeLocked();
-    void Init(int64_t pos);
-
-    static const int PAUSE_REQUEST_WATER_LINE = 4 * 1024 * 1024; // 4MB
-    static const int SINGLE_REQUEST_MAX_SIZE = 2 * 1024 * 1024;  // 2MB
-    static const int FIRST_REQUEST_SIZE = 1 * 1024 * 1024;       // 1MB
-    static const int MAX_BUFFER_SIZE = 5 * 1024 * 1024;          // 5MB
-    static const int WAIT_DATA_TIME_OUT_MS = 100;
-    static const int REQUEST_RETRY_TIME_INTERVAL_MS = 3000;
-
-    std::condition_variable dataCond_;
-    std::mutex dataMutex_;
-    std::unique_ptr<uint8_t[]> buffer_;
-    int64_t capacity_{ 0 };
-    int64_t startPos_{ 0 };
-    int64_t currPos_{ 0 };
-    int64_t endPos_{ 0 };
-    int64_t nextEndPos_{ 0 };
-    int64_t lastUsedTime_{ 0 };
-    int64_t lastRequestTime_{ 0 };
+struct DataSourceStats {
+    int64_t fileLength{ 0 };
+    DataSourceReadStats read;
+    PrefetchStats prefetch;
 };
 
 class LocalDataSource : public Media::IMediaDataSource,
@@ -73,31 +49,118 @@ class LocalDataSource : public Media::IMediaDataSource,
     public std::enable_shared_from_this<LocalDataSource> {
 public:
     LocalDataSource(const std::string &fileId, int64_t fileLength,
-        std::shared_ptr<CastLocalFileChannelClient> channelClient)
-        : fileId_(fileId), fileLength_(fileLength), channelClient_(channelClient) {}
+        std::shared_ptr<CastLocalFileChannelClient> channelClient,
+        int64_t cacheCapacity = BlockCache::DEFAULT_CAPACITY, bool useDiskCache = false)
+        : fileId_(fileId), fileLength_(fileLength), channelClient_(channelClient),
+          cache_(std::make_unique<BlockCache>(fileLength, cacheCapacity)),
+          diskCacheKey_(useDiskCache ? DiskBlockCache::MakeKey(fileId, fileLength) : "") {}
     virtual ~LocalDataSource();
     int32_t ReadAt(const std::shared_ptr<Media::AVSharedMemory> &mem, uint32_t length,
         int64_t pos = CAST_STREAM_INT_IGNORE) override;
     int32_t ReadAt(int64_t pos, uint32_t length, const std::shared_ptr<Media::AVSharedMemory> &mem) override;
     int32_t ReadAt(uint32_t length, const std::shared_ptr<Media::AVSharedMemory> &mem) override;
     int32_t GetSize(int64_t &size) override;
-    bool OnBytesReceived(const std::string &fileId, const uint8_t *bytes, int64_t offset, int64_t length) override;
-    int32_t ReadBuffer(uint8_t *data, uint32_t length, int64_t pos);
+    bool OnBytesReceived(std::string_view fileId, const uint8_t *bytes, int64_t offset, int64_t length) override;
+    void OnRequestFailed(std::string_view fileId, int64_t offset) override;
+    int32_t ReadBuffer(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs = DEFAULT_READ_TIMEOUT_MS);
+    // Read of a reader next to the player, see SecondaryDataSource
+    int32_t ReadSecondary(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs = DEFAULT_READ_TIMEOUT_MS);
+    int32_t ReadBufferFully(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs);
     bool Start();
     bool Stop();
+    // Requests the head and tail of the file again, for a replay once they may have left the cache
+    void StartupPrefetch();
+    // Decode-ahead of an image not shown yet asks for it behind the blocking reads
+    bool RequestWholeFile(bool blocking = true);
+    void GetPrefetchStats(PrefetchStats &stats);
+    void GetStats(DataSourceStats &stats);
+
+    static constexpr int64_t DEFAULT_READ_TIMEOUT_MS = 100;
 
 private:
-    std::shared_ptr<Cache> GetBestCache(int64_t pos);
-    void SolveReqData(std::shared_ptr<Cache> cache, int64_t pos);
+    int32_t DoReadBuffer(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs, bool primary);
+    void SolveReqData(int64_t pos, bool blocking);
+    void SolveSecondaryReqData(int64_t pos, uint32_t length);
+    void RequestRangeLocked(int64_t pos, int64_t aheadLimit, bool blocking);
+    bool RequestBulkLocked(int64_t start, int64_t end, bool blocking);
+    void ProbeContainer();
+    void CancelObsoleteRequests(int64_t start, int64_t end);
+    void OnSeekDataRead();
+    bool LoadFromDiskCache(int64_t start, int64_t protectStart, int64_t protectEnd);
+    int64_t TrimToDiskCache(int64_t start, int64_t end);
+    void QueueReceivedWork(const uint8_t *bytes, int64_t offset, int64_t length);
+    void WorkerLoop();
+    void StopWorker();
+    void UpdateReadStats(bool hit, int64_t waitTimeMs, int32_t readBytes, bool timedOut);
+
+    static const int PAUSE_REQUEST_WATER_LINE = 4 * 1024 * 1024; // 4MB
+    // A long read wakes at least this often to request again what was lost on the way
+    static constexpr int64_t READ_RECHECK_INTERVAL_MS = 500;
+    // Demuxers read the head of a file, and often its tail for a trailing index, before the first frame
+    static constexpr int64_t HEAD_PREFETCH_SIZE = BlockCache::FIRST_REQUEST_SIZE;
+    static constexpr int64_t TAIL_PREFETCH_SIZE = BlockCache::FIRST_REQUEST_SIZE;
+    static constexpr int MAX_PROBE_BOX_COUNT = 64;
+    // Blocks waiting for the disk past this are not saved, 4MB of copies at most
+    static constexpr size_t MAX_PENDING_DISK_BLOCKS = 16;
 
-    static const int MAX_CACHE_COUNT = 4; // total cache: 4 * 5 = 20MB
+    struct PendingDiskBlock {
+        int64_t index{ 0 };
+        int64_t length{ 0 };
+        std::unique_ptr<uint8_t[]> data;
+    };
 
     std::string fileId_;
     int64_t fileLength_{ 0 };
 
-    std::mutex dataMutex_;
-    std::vector<std::shared_ptr<Cache>> lruCache_;
+    std::atomic<bool> isStopped_{ false };
+    std::mutex requestMutex_;
     std::shared_ptr<CastLocalFileChannelClient> channelClient_;
+    std::unique_ptr<BlockCache> cache_;
+    PrefetchWindow prefetchWindow_;
+    // Ranges requested in bulk, their responses come without a request in the prefetch window
+    std::vector<std::pair<int64_t, int64_t>> bulkRanges_;
+    // Empty when the disk cache is not used
+    std::string diskCacheKey_;
+    std::unique_ptr<uint8_t[]> diskBuffer_;
+    uint64_t diskCacheHits_{ 0 };
+    // Position of the next top level MP4/MOV box to look at, probing stops once the index is found or not mp4
+    std::atomic<bool> probing_{ false };
+    int64_t probeOffset_{ 0 };
+    int probeBoxCount_{ 0 };
+    // Start time of the cold read waiting for its first byte, 0 if none
+    int64_t seekStartTimeMs_{ 0 };
+    uint64_t seekCount_{ 0 };
+    int64_t lastSeekLatencyMs_{ 0 };
+    int64_t maxSeekLatencyMs_{ 0 };
+    std::mutex statsMutex_;
+    DataSourceReadStats readStats_;
+    // Disk writes and probing run on the worker, data arrives on the I/O thread of the channel which must not block
+    std::mutex workMutex_;
+    std::condition_variable workCond_;
+    std::thread worker_;
+    bool workerStopped_{ false };
+    // Copies of the received blocks that are still to be saved to the disk cache, their buffers are reused
+    std::deque<PendingDiskBlock> pendingDiskBlocks_;
+    std::vector<std::unique_ptr<uint8_t[]>> freeDiskBlockBuffers_;
+    bool probePending_{ false };
+};
+
+/*
+ * Reads the file of a LocalDataSource for a consumer next to the player, such as the extraction of the album cover.
+ * The reads share the cache of the player but are not taken for its seeks: they cancel none of its requests,
+ * request nothing ahead and go out behind its blocking reads.
+ */
+class SecondaryDataSource : public Media::IMediaDataSource {
+public:
+    explicit SecondaryDataSource(std::shared_ptr<LocalDataSource> source) : source_(source) {}
+    int32_t ReadAt(const std::shared_ptr<Media::AVSharedMemory> &mem, uint32_t length,
+        int64_t pos = CAST_STREAM_INT_IGNORE) override;
+    int32_t ReadAt(int64_t pos, uint32_t length, const std::shared_ptr<Media::AVSharedMemory> &mem) override;
+    int32_t ReadAt(uint32_t length, const std::shared_ptr<Media::AVSharedMemory> &mem) override;
+    int32_t GetSize(int64_t &size) override;
+
+private:
+    std::shared_ptr<LocalDataSource> source_;
 };
 } // namespace CastEngineService
 } // namespace CastEngine
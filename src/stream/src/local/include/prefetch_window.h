@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: sliding window of in-flight range requests for local data source
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef PREFETCH_WINDOW_H
+#define PREFETCH_WINDOW_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "data_source_stats.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+struct PrefetchStats {
+    int32_t windowSize{ 0 };
+    int32_t inFlight{ 0 };
+    int32_t maxInFlight{ 0 };
+    uint64_t requestsSent{ 0 };
+    uint64_t requestsCompleted{ 0 };
+    uint64_t requestsExpired{ 0 };
+    uint64_t requestsCancelled{ 0 };
+    // Requests the server answered with a failure
+    uint64_t requestsFailed{ 0 };
+    // number of times a request was wanted but the window was already full
+    uint64_t windowFullCount{ 0 };
+    // sum of in-flight counts sampled at each send, used for the average window occupancy
+    uint64_t inFlightSampleSum{ 0 };
+    int64_t smoothedRttMs{ 0 };
+    int64_t minRttMs{ 0 };
+    int64_t throughputKBps{ 0 };
+    // Reads that found nothing cached or requested under them, such as the first read and seeks
+    uint64_t seekCount{ 0 };
+    int64_t lastSeekLatencyMs{ 0 };
+    int64_t maxSeekLatencyMs{ 0 };
+    // Blocks served from the disk cache instead of the channel
+    uint64_t diskCacheHits{ 0 };
+    LatencyHistogram requestRtt;
+};
+
+struct PrefetchRequest {
+    int64_t start;
+    int64_t end;
+    uint32_t requestId;
+};
+
+/*
+ * Keeps up to windowSize_ range requests in flight for one data source. The window follows the
+ * bandwidth-delay product measured from completed requests: it grows while the link is idle between
+ * responses and shrinks when the smoothed rtt shows that requests are only queueing on the source.
+ */
+class PrefetchWindow final {
+public:
+    PrefetchWindow() = default;
+    ~PrefetchWindow() = default;
+
+    bool CanRequest();
+    void OnRequestSent(int64_t start, int64_t end, uint32_t requestId);
+    void OnDataArrived(int64_t offset, int64_t length);
+    bool OnRequestFailed(int64_t offset, PrefetchRequest &request);
+    void TakeRequestsOutside(int64_t start, int64_t end, std::vector<PrefetchRequest> &requests);
+    void Reset();
+    int32_t GetWindowSize();
+    int64_t GetAheadLimit(int64_t requestSize);
+    void GetStats(PrefetchStats &stats);
+
+    static constexpr int MIN_WINDOW_SIZE = 1;
+    static constexpr int MAX_WINDOW_SIZE = 4;
+
+private:
+    struct InFlightRequest {
+        int64_t start;
+        int64_t end;
+        uint32_t requestId;
+        int64_t sendTimeMs;
+        // Sent under credit, the server answers it for sure
+        bool credited;
+    };
+
+    void ExpireLocked(int64_t now);
+    void EraseLocked(std::list<InFlightRequest>::iterator iter);
+    void AdjustWindowLocked(int64_t rttMs, int64_t bytes, int64_t intervalStart);
+
+    static constexpr int INIT_WINDOW_SIZE = 2;
+    static constexpr int REQUEST_EXPIRE_TIME_MS = 3000;
+    // Only reached when the channel is gone
+    static constexpr int CREDITED_EXPIRE_TIME_MS = 30000;
+    static constexpr int RTT_SMOOTH_FACTOR = 8;
+    static constexpr int RTT_QUEUEING_FACTOR = 2;
+    static constexpr int RTT_QUEUEING_MARGIN_MS = 20;
+
+    std::mutex mutex_;
+    // In send order, and indexed by start offset for the responses
+    std::list<InFlightRequest> inFlight_;
+    std::unordered_map<int64_t, std::list<InFlightRequest>::iterator> inFlightByStart_;
+    int32_t windowSize_{ INIT_WINDOW_SIZE };
+    int64_t lastCompleteTimeMs_{ 0 };
+    int64_t lastRequestSize_{ 0 };
+    PrefetchStats stats_;
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // PREFETCH_WINDOW_H
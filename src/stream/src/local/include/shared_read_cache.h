@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: block cache shared by the sinks of one local file channel server
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef SHARED_READ_CACHE_H
+#define SHARED_READ_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+/*
+ * Keeps the last read blocks of the served files, so a block requested again, by the same sink after a retry or
+ * by another sink, is read from disk once. A block missing from the cache is read by the first request that needs
+ * it, the other requests wait for that read instead of issuing their own.
+ * A block wholly inside a response is read straight into the response on its first miss and only remembered, it
+ * is copied into the cache when another request waits for it or once it is requested again.
+ */
+class SharedReadCache final {
+public:
+    // Reads length bytes at offset into data and returns the number of bytes read
+    using FileReader = std::function<int(int64_t offset, int length, uint8_t *data)>;
+
+    explicit SharedReadCache(int64_t capacity = DEFAULT_CAPACITY) : capacity_(capacity) {}
+    ~SharedReadCache() = default;
+
+    int Read(const std::string &fileId, int64_t fileLength, int64_t offset, int length, uint8_t *data,
+        const FileReader &reader);
+    void Clear();
+    void GetStats(uint64_t &hitCount, uint64_t &missCount);
+
+    static constexpr int64_t BLOCK_SIZE = 256 * 1024;               // same as the sink BlockCache
+    static constexpr int64_t DEFAULT_CAPACITY = 16 * 1024 * 1024;   // 16MB
+
+private:
+    using BlockKey = std::pair<std::string, int64_t>;
+
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        int64_t length = 0;
+        bool loading = true;
+        bool failed = false;
+        // Requests waiting for the block while it is read
+        int waiters = 0;
+        std::list<BlockKey>::iterator lruIter;
+    };
+
+    std::shared_ptr<Block> AcquireBlock(const BlockKey &key, int64_t length, const FileReader &reader,
+        uint8_t *direct, bool &delivered);
+    bool FinishDirectRead(const BlockKey &key, std::shared_ptr<Block> block, const uint8_t *direct, int readLength);
+    void RemoveBlockLocked(const BlockKey &key, const std::shared_ptr<Block> &block);
+    void RememberLocked(const BlockKey &key);
+    void EvictLocked();
+
+    std::mutex mutex_;
+    std::condition_variable loadCond_;
+    int64_t capacity_;
+    int64_t usedSize_ = 0;
+    std::map<BlockKey, std::shared_ptr<Block>> blocks_;
+    // The least recently used block first
+    std::list<BlockKey> lruList_;
+    // Blocks read straight into a response and not cached, the oldest first
+    std::list<BlockKey> recentList_;
+    std::set<BlockKey> recentKeys_;
+    uint64_t hitCount_ = 0;
+    uint64_t missCount_ = 0;
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // SHARED_READ_CACHE_H
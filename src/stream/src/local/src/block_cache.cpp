@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: block granular sparse cache of a remote local file
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "block_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <securec.h>
+#include "cast_engine_log.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+DEFINE_CAST_ENGINE_LABEL("Cast-BlockCache");
+
+namespace {
+int64_t GetNowMs()
+{
+    std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+
+int64_t GetNowUs()
+{
+    std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+}
+
+BlockCache::BlockCache(int64_t fileLength, int64_t capacity) : fileLength_(fileLength)
+{
+    CLOGD("BlockCache in");
+    if (capacity < BLOCK_SIZE) {
+        capacity = DEFAULT_CAPACITY;
+    }
+    // small files such as images don't need the whole budget
+    if (fileLength_ > 0 && fileLength_ < capacity) {
+        capacity = (fileLength_ + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    }
+    int64_t blockCount = capacity / BLOCK_SIZE;
+    arena_ = std::make_unique<uint8_t[]>(blockCount * BLOCK_SIZE);
+    if (!arena_) {
+        CLOGE("arena malloc failed");
+        return;
+    }
+    capacity_ = blockCount * BLOCK_SIZE;
+    freeBlocks_.reserve(blockCount);
+    for (int64_t i = blockCount - 1; i >= 0; i--) {
+        freeBlocks_.push_back(arena_.get() + i * BLOCK_SIZE);
+    }
+}
+
+BlockCache::~BlockCache()
+{
+    CLOGD("~BlockCache in, direct read bytes:%{public}" PRIu64, directBytes_);
+    blocks_.clear();
+    freeBlocks_.clear();
+    arena_.reset();
+}
+
+bool BlockCache::IsValid()
+{
+    return (arena_ != nullptr);
+}
+
+int64_t BlockCache::GetCapacity() const
+{
+    return capacity_;
+}
+
+bool BlockCache::IsCached(int64_t pos)
+{
+    std::lock_guard<std::mutex> lock(dataMutex_);
+    return IsReadyLocked(pos);
+}
+
+int64_t BlockCache::GetBlockLength(int64_t offset) const
+{
+    return std::min(BLOCK_SIZE, fileLength_ - offset);
+}
+
+bool BlockCache::IsCompleteLocked(const Block &block) const
+{
+    return block.begin == 0 && block.filled >= GetBlockLength(block.offset);
+}
+
+bool BlockCache::IsInFlightLocked(const Block &block, int64_t now) const
+{
+    int64_t retryIntervalMs = block.credited ? CREDITED_REQUEST_RETRY_TIME_INTERVAL_MS : REQUEST_RETRY_TIME_INTERVAL_MS;
+    return block.requestTimeMs != 0 && (now - block.requestTimeMs) < retryIntervalMs && !IsCompleteLocked(block);
+}
+
+bool BlockCache::IsMissingLocked(const Block *block, int64_t now) const
+{
+    return block == nullptr || (!IsCompleteLocked(*block) && !IsInFlightLocked(*block, now));
+}
+
+// Like IsMissingLocked, but only the data of the block from pos on matters
+bool BlockCache::IsMissingAtLocked(const Block *block, int64_t pos, int64_t now) const
+{
+    if (block == nullptr || pos - block->offset < block->begin) {
+        return true;
+    }
+    if (block->filled >= GetBlockLength(block->offset)) {
+        return false;
+    }
+    return !IsInFlightLocked(*block, now);
+}
+
+void BlockCache::FreeBlockLocked(int64_t index)
+{
+    auto iter = blocks_.find(index);
+    if (iter != blocks_.end()) {
+        freeBlocks_.push_back(iter->second.data);
+        blocks_.erase(iter);
+    }
+}
+
+BlockCache::Block *BlockCache::FindBlockLocked(int64_t pos)
+{
+    auto iter = blocks_.find(pos / BLOCK_SIZE);
+    return (iter == blocks_.end()) ? nullptr : &iter->second;
+}
+
+BlockCache::Block *BlockCache::AllocBlockLocked(int64_t index, int64_t protectStart, int64_t protectEnd)
+{
+    if (freeBlocks_.empty()) {
+        // Evict the least recently used block which is neither in flight nor ahead of the reading position
+        int64_t now = GetNowMs();
+        auto victim = blocks_.end();
+        for (auto iter = blocks_.begin(); iter != blocks_.end(); iter++) {
+            const Block &block = iter->second;
+            if (IsInFlightLocked(block, now) || (block.offset + BLOCK_SIZE > protectStart && block.offset < protectEnd)) {
+                continue;
+            }
+            if (victim == blocks_.end() || victim->second.lastUsedTimeUs > block.lastUsedTimeUs) {
+                victim = iter;
+            }
+        }
+        if (victim == blocks_.end()) {
+            CLOGW("no block can be evicted, index:%{public}" PRId64, index);
+            return nullptr;
+        }
+        freeBlocks_.push_back(victim->second.data);
+        blocks_.erase(victim);
+    }
+    Block &block = blocks_[index];
+    block.offset = index * BLOCK_SIZE;
+    block.begin = 0;
+    block.filled = 0;
+    block.requestTimeMs = 0;
+    block.credited = false;
+    block.lastUsedTimeUs = GetNowUs();
+    block.data = freeBlocks_.back();
+    freeBlocks_.pop_back();
+    return &block;
+}
+
+bool BlockCache::FindMissingRange(int64_t pos, int64_t aheadLimit, int64_t &start, int64_t &end)
+{
+    std::unique_lock<std::mutex> lock(dataMutex_);
+    int64_t now = GetNowMs();
+    int64_t limit = std::min(fileLength_, pos + aheadLimit);
+    int64_t index = pos / BLOCK_SIZE;
+    for (; index * BLOCK_SIZE < limit; index++) {
+        Block *block = FindBlockLocked(index * BLOCK_SIZE);
+        if (IsMissingAtLocked(block, std::max(pos, index * BLOCK_SIZE), now)) {
+            break;
+        }
+    }
+    if (index * BLOCK_SIZE >= limit) {
+        return false;
+    }
+    Block *first = FindBlockLocked(index * BLOCK_SIZE);
+    int64_t from = std::max(pos, index * BLOCK_SIZE);
+    if (first == nullptr) {
+        start = index * BLOCK_SIZE;
+    } else if (from - first->offset < first->begin) {
+        // Data before a direct read is wanted again, the whole block is fetched anew
+        start = first->offset;
+    } else {
+        start = first->offset + first->filled;
+    }
+    // a cold block under the reading position is requested small to get the first byte quickly
+    int64_t maxSize = (index == pos / BLOCK_SIZE && first == nullptr) ? FIRST_REQUEST_SIZE : SINGLE_REQUEST_MAX_SIZE;
+    end = (index + 1) * BLOCK_SIZE;
+    for (index++; end - start < maxSize && end < fileLength_; index++) {
+        Block *block = FindBlockLocked(index * BLOCK_SIZE);
+        if (!IsMissingLocked(block, now) || (block != nullptr && block->filled > 0)) {
+            break;
+        }
+        end += BLOCK_SIZE;
+    }
+    end = std::min(std::min(end, start + maxSize), fileLength_);
+    return true;
+}
+
+bool BlockCache::MarkRequested(int64_t start, int64_t end, int64_t protectStart, int64_t protectEnd)
+{
+    std::unique_lock<std::mutex> lock(dataMutex_);
+    int64_t now = GetNowMs();
+    std::vector<Block *> requested;
+    for (int64_t index = start / BLOCK_SIZE; index * BLOCK_SIZE < end; index++) {
+        Block *block = FindBlockLocked(index * BLOCK_SIZE);
+        if (block == nullptr) {
+            block = AllocBlockLocked(index, protectStart, protectEnd);
+        }
+        if (block == nullptr) {
+            return false;
+        }
+        requested.push_back(block);
+    }
+    for (auto block : requested) {
+        block->requestTimeMs = now;
+        block->credited = false;
+    }
+    return true;
+}
+
+// The request of [start, end) went out under credit, its blocks stay reserved until it is answered
+void BlockCache::MarkCredited(int64_t start, int64_t end)
+{
+    std::unique_lock<std::mutex> lock(dataMutex_);
+    for (int64_t index = start / BLOCK_SIZE; index * BLOCK_SIZE < end; index++) {
+        Block *block = FindBlockLocked(index * BLOCK_SIZE);
+        if (block != nullptr && block->requestTimeMs != 0) {
+            block->credited = true;
+        }
+    }
+}
+
+void BlockCache::CancelRequested(int64_t start, int64_t end)
+{
+    std::unique_lock<std::mutex> lock(dataMutex_);
+    // Incomplete blocks become missing again, so they are requested anew if they are still needed
+    for (int64_t index = start / BLOCK_SIZE; index * BLOCK_SIZE < end; index++) {
+        Block *block = FindBlockLocked(index * BLOCK_SIZE);
+        if (block != nullptr && !IsCompleteLocked(*block)) {
+            block->requestTimeMs = 0;
+            block->credited = false;
+        }
+    }
+    // A reader waiting for them requests them again without waiting out its recheck interval
+    cancelSequence_++;
+    dataCond_.notify_all();
+}
+
+void BlockCache::Abort()
+{
+    std::unique_lock<std::mutex> lock(dataMutex_);
+    aborted_ = true;
+    dataCond_.notify_all();
+}
+
+bool BlockCache::IsReadyLocked(int64_t pos)
+{
+    Block *block = FindBlockLocked(pos);
+    return block != nullptr && pos - block->offset >= block->begin && pos - block->offset < block->filled;
+}
+
+/*
+ * Waits at most waitTimeMs for the data at pos. The wait ends as soon as that data is written, or when its request
+ * is cancelled so that the caller can request it again. Returns 0 if no data is there yet.
+ */
+int64_t BlockCache::Read(uint8_t *data, uint32_t length, int64_t pos, int64_t waitTimeMs)
+{
+    std::unique_lock<std::mutex> lock(dataMutex_);
+    if (data == nullptr || length == 0) {
+        CLOGE("data is null or length is 0");
+        return 0;
+    }
+    if (!IsReadyLocked(pos) && waitTimeMs > 0 && !aborted_) {
+        // Waiting right at the fill position of a block, the data can be written into data as it arrives
+        Block *waitBlock = FindBlockLocked(pos);
+        DirectRead directRead = { pos, data, static_cast<int64_t>(length), 0 };
+        bool direct = (directRead_ == nullptr && waitBlock != nullptr && pos - waitBlock->offset == waitBlock->filled);
+        if (direct) {
+            directRead_ = &directRead;
+        }
+        uint64_t cancelSequence = cancelSequence_;
+        dataCond_.wait_for(lock, std::chrono::milliseconds(waitTimeMs), [this, pos, cancelSequence, &directRead]() {
+            return aborted_ || IsReadyLocked(pos) || directRead.delivered > 0 ||
+                (cancelSequence_ != cancelSequence && IsMissingAtLocked(FindBlockLocked(pos), pos, GetNowMs()));
+        });
+        if (direct) {
+            directRead_ = nullptr;
+        }
+        if (directRead.delivered > 0) {
+            return directRead.delivered;
+        }
+    }
+    if (aborted_ || !IsReadyLocked(pos)) {
+        return 0;
+    }
+    Block *block = FindBlockLocked(pos);
+    int64_t readBytes = 0;
+    int64_t usedTime = GetNowUs();
+    while (readBytes < length && block != nullptr && pos - block->offset >= block->begin &&
+        pos - block->offset < block->filled) {
+        int64_t inBlockPos = pos - block->offset;
+        int64_t copyBytes = std::min(static_cast<int64_t>(length) - readBytes, block->filled - inBlockPos);
+        errno_t ret = memcpy_s(data + readBytes, copyBytes, block->data + inBlockPos, copyBytes);
+        if (ret != EOK) {
+            CLOGE("memcpy failed ret:%{public}d copyBytes:%{public}" PRId64 " pos:%{public}" PRId64, ret, copyBytes, pos);
+            break;
+        }
+        block->lastUsedTimeUs = usedTime;
+        readBytes += copyBytes;
+        pos += copyBytes;
+        block = FindBlockLocked(pos);
+    }
+    return readBytes;
+}
+
+bool BlockCache::Write(const uint8_t *data, int64_t offset, int64_t length)
+{
+    std::unique_lock<std::mutex> lock(dataMutex_);
+    if (data == nullptr || length <= 0) {
+        CLOGE("data is null or length is 0");
+        return false;
+    }
+    int64_t end = offset + length;
+    bool delivered = WriteDirectLocked(data, offset, end);
+    int64_t written = 0;
+    if (!delivered) {
+        written = WriteRangeLocked(data, offset, offset, end);
+    }
+    CLOGD("written:%{public}" PRId64 " length:%{public}" PRId64 " offset:%{public}" PRId64, written, length, offset);
+    if (delivered || written > 0) {
+        dataCond_.notify_all();
+    }
+    return delivered || written > 0;
+}
+
+/*
+ * Hands the part of [offset, end) that the registered reader waits for straight to its buffer and caches the
+ * rest. The blocks wholly given to the reader are freed, the block where its part ends keeps what follows it, and
+ * also what precedes it when that block already caches data before the reader's part.
+ * Returns false, without writing anything, when the data is not for the reader.
+ */
+bool BlockCache::WriteDirectLocked(const uint8_t *data, int64_t offset, int64_t end)
+{
+    if (directRead_ == nullptr || directRead_->delivered > 0 || directRead_->pos < offset ||
+        directRead_->pos >= end) {
+        return false;
+    }
+    int64_t directStart = directRead_->pos;
+    // Bytes before the reader position may complete its block up to it
+    WriteRangeLocked(data, offset, offset, directStart);
+    Block *first = FindBlockLocked(directStart);
+    if (first == nullptr || directStart - first->offset != first->filled) {
+        WriteRangeLocked(data, offset, directStart, end);
+        return true;
+    }
+    int64_t directEnd = std::min(std::min(end, directStart + directRead_->length), fileLength_);
+    errno_t ret = memcpy_s(directRead_->data, directRead_->length, data + (directStart - offset),
+        directEnd - directStart);
+    if (ret != EOK) {
+        CLOGE("direct memcpy failed ret:%{public}d pos:%{public}" PRId64, ret, directStart);
+        WriteRangeLocked(data, offset, directStart, end);
+        return true;
+    }
+    directRead_->delivered = directEnd - directStart;
+    directBytes_ += static_cast<uint64_t>(directRead_->delivered);
+
+    int64_t firstIndex = directStart / BLOCK_SIZE;
+    int64_t lastIndex = directEnd / BLOCK_SIZE;
+    if (firstIndex != lastIndex) {
+        // The rest of the first block went to the reader, it is requested again if read again
+        if (first->filled == 0) {
+            FreeBlockLocked(firstIndex);
+        } else {
+            first->requestTimeMs = 0;
+        }
+    }
+    for (int64_t index = firstIndex + 1; index < lastIndex; index++) {
+        FreeBlockLocked(index);
+    }
+    Block *last = FindBlockLocked(directEnd);
+    if (last != nullptr && directEnd % BLOCK_SIZE != 0) {
+        int64_t spanStart = std::max(directStart, last->offset);
+        if (last->filled > last->begin && spanStart - last->offset >= last->begin &&
+            spanStart - last->offset <= last->filled) {
+            // The block caches data before the direct span, the span is cached too so the block stays whole
+            WriteRangeLocked(data, offset, spanStart, directEnd);
+        } else {
+            // Nothing cached before directEnd in this block is kept
+            last->begin = directEnd - last->offset;
+            last->filled = last->begin;
+        }
+    }
+    WriteRangeLocked(data, offset, directEnd, end);
+    return true;
+}
+
+// Writes the part [start, end) of the data received at offset into the blocks, returns the bytes written
+int64_t BlockCache::WriteRangeLocked(const uint8_t *data, int64_t offset, int64_t start, int64_t end)
+{
+    int64_t written = 0;
+    for (int64_t pos = start; pos < end;) {
+        int64_t blockEnd = (pos / BLOCK_SIZE + 1) * BLOCK_SIZE;
+        int64_t copyEnd = std::min(std::min(end, blockEnd), fileLength_);
+        Block *block = FindBlockLocked(pos);
+        if (block != nullptr && pos == block->offset && block->begin > 0) {
+            // The block is fetched anew from its start, what it held after a direct read is dropped
+            block->begin = 0;
+            block->filled = 0;
+        }
+        // the block was evicted or data before this position is still missing
+        if (block == nullptr || pos - block->offset > block->filled || pos - block->offset < block->begin ||
+            copyEnd <= pos) {
+            pos = blockEnd;
+            continue;
+        }
+        int64_t inBlockPos = pos - block->offset;
+        int64_t copyBytes = copyEnd - pos;
+        errno_t ret = memcpy_s(block->data + inBlockPos, BLOCK_SIZE - inBlockPos, data + (pos - offset), copyBytes);
+        if (ret != EOK) {
+            CLOGE("memcpy failed ret = %{public}d, copyBytes:%{public}" PRId64 " pos:%{public}" PRId64, ret, copyBytes,
+                pos);
+            block->requestTimeMs = 0; // need Re-request
+            pos = blockEnd;
+            continue;
+        }
+        block->filled = std::max(block->filled, inBlockPos + copyBytes);
+        written += copyBytes;
+        pos = copyEnd;
+        if (copyEnd < blockEnd) {
+            break;
+        }
+    }
+    return written;
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
@@ -18,12 +18,13 @@
 
 #include "cast_local_file_channel_client.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <cinttypes>
+#include <vector>
 
 #include "cast_engine_log.h"
 #include "cast_local_file_channel_common.h"
@@ -99,6 +100,8 @@ void CastLocalFileChannelClient::AddChannel(std::shared_ptr<Channel> channel)
     CLOGI("in");
     std::unique_lock<std::mutex> lock(chLock_);
     channel_ = channel;
+    binaryFraming_ = false;
+    ResetCredits();
     cond_.notify_all();
 }
 
@@ -107,27 +110,171 @@ void CastLocalFileChannelClient::RemoveChannel(std::shared_ptr<Channel> channel)
     CLOGI("in");
     std::unique_lock<std::mutex> lock(chLock_);
     channel_ = nullptr;
+    binaryFraming_ = false;
+    ResetCredits();
 }
 
-void CastLocalFileChannelClient::RequestByteData(int64_t start, int64_t end, const std::string &fileId)
+std::shared_ptr<Channel> CastLocalFileChannelClient::GetChannel()
 {
-    std::shared_ptr<Channel> channel;
-    {
-        std::unique_lock<std::mutex> lock(chLock_);
-        if (!channel_) {
-            CLOGE("channel is not created.");
-            return;
-        }
-        channel = channel_;
+    std::unique_lock<std::mutex> lock(chLock_);
+    if (!channel_) {
+        CLOGE("channel is not created.");
+    }
+    return channel_;
+}
+
+/*
+ * requestId is set to the id of the request, which can be cancelled while its response is not sent. It is 0 when
+ * the request can't be cancelled, which is the case for the http framing. A request with an id is sent under
+ * credit, so it is always answered, with the data or a failure.
+ */
+bool CastLocalFileChannelClient::RequestByteData(int64_t start, int64_t end, const std::string &fileId,
+    uint16_t priority, uint32_t &requestId)
+{
+    requestId = 0;
+    std::shared_ptr<Channel> channel = GetChannel();
+    if (!channel) {
+        return false;
+    }
+    if (binaryFraming_) {
+        return SendBinaryRequest(channel, FRAME_TYPE_REQUEST, start, end, fileId, priority, requestId);
     }
-    // Make http request header
+    // Make http request header, offering the binary framing for the following requests
     std::string req("GET ");
     req.append(fileId);
-    req.append(" HTTP/1.1\r\nRange: bytes=" + std::to_string(start) + "-" + std::to_string(end) + "\r\n\r\n");
+    req.append(" HTTP/1.1\r\nRange: bytes=" + std::to_string(start) + "-" + std::to_string(end) + "\r\n");
+    req.append(HTTP_PRIORITY_HEADER + ": " + std::to_string(priority) + "\r\n");
+    req.append(HTTP_FRAMING_HEADER + ": " + BINARY_FRAMING_VERSION + "\r\n\r\n");
+
+    CLOGD("request data: %s len %{public}" PRId64 "-%{public}" PRId64 " priority %{public}u", fileId.c_str(), start,
+        end, priority);
+
+    return channel->Send(reinterpret_cast<uint8_t *>(const_cast<char *>(req.data())), req.size());
+}
+
+/*
+ * Requests [start, end) in one go, the server streams it in consecutive responses as the credit of the file allows.
+ * Returns false when the server does not speak the binary framing, the range has then to be requested piecewise.
+ */
+bool CastLocalFileChannelClient::RequestBulkData(int64_t start, int64_t end, const std::string &fileId,
+    uint16_t priority, uint32_t &requestId)
+{
+    requestId = 0;
+    if (!binaryFraming_ || end <= start) {
+        return false;
+    }
+    std::shared_ptr<Channel> channel = GetChannel();
+    if (!channel) {
+        return false;
+    }
+    return SendBinaryRequest(channel, FRAME_TYPE_BULK_REQUEST, start, end, fileId, priority, requestId);
+}
+
+bool CastLocalFileChannelClient::CancelRequest(uint32_t requestId, const std::string &fileId)
+{
+    // Only a server that speaks the binary framing knows the request ids
+    if (requestId == 0 || !binaryFraming_) {
+        return false;
+    }
+    std::shared_ptr<Channel> channel = GetChannel();
+    if (!channel) {
+        return false;
+    }
+    BinaryFrame frame;
+    frame.type = FRAME_TYPE_CANCEL;
+    frame.requestId = requestId;
+    frame.fileId = fileId;
+    std::vector<uint8_t> req(GetBinaryFrameHeaderLength(frame));
+    if (!EncodeBinaryFrame(frame, req.data(), req.size())) {
+        return false;
+    }
+
+    CLOGD("cancel request: %s id %{public}u", fileId.c_str(), requestId);
+
+    return channel->Send(req.data(), req.size());
+}
+
+bool CastLocalFileChannelClient::SendBinaryRequest(std::shared_ptr<Channel> channel, uint8_t type, int64_t start,
+    int64_t end, const std::string &fileId, uint16_t priority, uint32_t &requestId)
+{
+    BinaryFrame frame;
+    frame.type = type;
+    frame.status = priority;
+    frame.requestId = ++requestId_;
+    if (frame.requestId == 0) {
+        // 0 stands for no request id, skip it when the counter wraps around
+        frame.requestId = ++requestId_;
+    }
+    frame.offset = start;
+    frame.length = std::max(end - start, static_cast<int64_t>(0));
+    frame.fileId = fileId;
+    std::vector<uint8_t> req(GetBinaryFrameHeaderLength(frame));
+    if (!EncodeBinaryFrame(frame, req.data(), req.size()) || !EnsureCredit(channel, fileId)) {
+        return false;
+    }
+
+    CLOGD("request data: %s id %{public}u len %{public}" PRId64 "-%{public}" PRId64, fileId.c_str(),
+        frame.requestId, start, end);
+
+    requestId = frame.requestId;
+    return channel->Send(req.data(), req.size());
+}
+
+void CastLocalFileChannelClient::ResetCredits()
+{
+    std::lock_guard<std::mutex> lock(creditLock_);
+    credits_.clear();
+}
+
+// Grants the first credit window of a file ahead of its first binary request
+bool CastLocalFileChannelClient::EnsureCredit(std::shared_ptr<Channel> channel, const std::string &fileId)
+{
+    std::lock_guard<std::mutex> lock(creditLock_);
+    if (credits_.count(fileId) != 0) {
+        return true;
+    }
+    // Sent under the lock, so no request of the file gets on the channel ahead of its credit
+    if (!SendCredit(channel, fileId, CREDIT_WINDOW)) {
+        return false;
+    }
+    credits_[fileId].granted = CREDIT_WINDOW;
+    return true;
+}
 
-    CLOGD("request data: %s len %{public}" PRId64 "-%{public}" PRId64, fileId.c_str(), start, end);
+void CastLocalFileChannelClient::OnCreditUsed(std::string_view fileId, int64_t length)
+{
+    // Taken before creditLock_, which is nested in chLock_ when the channel changes
+    std::shared_ptr<Channel> channel = GetChannel();
+    std::lock_guard<std::mutex> lock(creditLock_);
+    auto it = credits_.find(fileId);
+    if (it == credits_.end()) {
+        return;
+    }
+    FileCredit &credit = it->second;
+    credit.received += length;
+    if (credit.granted - credit.received > CREDIT_WINDOW - CREDIT_GRANT_STEP) {
+        return;
+    }
+    // The data is taken off the channel whether a listener keeps it or not, so its credit is given back
+    int64_t grant = credit.received + CREDIT_WINDOW - credit.granted;
+    if (channel && SendCredit(channel, fileId, grant)) {
+        credit.granted += grant;
+    }
+}
 
-    channel->Send(reinterpret_cast<uint8_t *>(const_cast<char *>(req.data())), req.size());
+bool CastLocalFileChannelClient::SendCredit(std::shared_ptr<Channel> channel, std::string_view fileId,
+    int64_t length)
+{
+    BinaryFrame frame;
+    frame.type = FRAME_TYPE_CREDIT;
+    frame.length = length;
+    frame.fileId = fileId;
+    std::vector<uint8_t> req(GetBinaryFrameHeaderLength(frame));
+    if (!EncodeBinaryFrame(frame, req.data(), req.size())) {
+        return false;
+    }
+    CLOGD("grant credit: %.*s %{public}" PRId64, static_cast<int>(fileId.size()), fileId.data(), length);
+    return channel->Send(req.data(), req.size());
 }
 
 int64_t CastLocalFileChannelClient::RequestFileLength(const std::string &fileId)
@@ -135,39 +282,55 @@ int64_t CastLocalFileChannelClient::RequestFileLength(const std::string &fileId)
     return 0;
 }
 
-void CastLocalFileChannelClient::AddDataListener(std::shared_ptr<IDataListener> dataListener)
+void CastLocalFileChannelClient::AddDataListener(const std::string &fileId,
+    std::shared_ptr<IDataListener> dataListener)
 {
     if (!dataListener) {
         CLOGE("listener is null");
         return;
     }
     std::lock_guard<std::mutex> lock(listenerLock_);
-    dataListeners_.push_back(dataListener);
-    CLOGD("listener count %{public}u", dataListeners_.size());
+    std::shared_ptr<const DataListeners> &listeners = dataListeners_[fileId];
+    auto updated = listeners ? std::make_shared<DataListeners>(*listeners) : std::make_shared<DataListeners>();
+    updated->push_back(dataListener);
+    listeners = updated;
+    CLOGD("file count %{public}zu", dataListeners_.size());
 }
 
-void CastLocalFileChannelClient::RemoveDataListener(std::shared_ptr<IDataListener> dataListener)
+void CastLocalFileChannelClient::RemoveDataListener(const std::string &fileId,
+    std::shared_ptr<IDataListener> dataListener)
 {
     if (!dataListener) {
         CLOGE("listener is null");
         return;
     }
     std::lock_guard<std::mutex> lock(listenerLock_);
-    dataListeners_.remove(dataListener);
-    CLOGD("listener count %{public}u", dataListeners_.size());
+    auto it = dataListeners_.find(fileId);
+    if (it == dataListeners_.end()) {
+        return;
+    }
+    auto updated = std::make_shared<DataListeners>(*it->second);
+    updated->erase(std::remove(updated->begin(), updated->end(), dataListener), updated->end());
+    if (updated->empty()) {
+        dataListeners_.erase(it);
+    } else {
+        it->second = updated;
+    }
+    CLOGD("file count %{public}zu", dataListeners_.size());
 }
 
 bool CastLocalFileChannelClient::ProcessServerResponse(const uint8_t *buffer, unsigned int length,
-    std::map<std::string, std::string> &response, size_t &dataOffset)
+    HttpResponseHeader &response)
 {
-    bool ret = ParseHttpResponse(buffer, length, response, dataOffset);
+    bool ret = ParseHttpResponse(buffer, length, response);
     if (!ret) {
         CLOGE("http response header parse error");
         return false;
     }
 
-    if (response[HTTP_RSP_CODE].compare("200") != 0) {
-        CLOGE("http status code %{public}s", response[HTTP_RSP_CODE].c_str());
+    if (response.statusCode != "200") {
+        CLOGE("http status code %{public}.*s", static_cast<int>(response.statusCode.size()),
+            response.statusCode.data());
         return false;
     }
 
@@ -178,38 +341,104 @@ void CastLocalFileChannelClient::OnDataReceived(const uint8_t *buffer, unsigned
 {
     CLOGD("buffer length %{public}u", length);
 
+    if (IsBinaryFrame(buffer, length)) {
+        ProcessBinaryResponse(buffer, length);
+    } else {
+        ProcessHttpResponse(buffer, length);
+    }
+    CLOGD("End");
+}
+
+void CastLocalFileChannelClient::ProcessHttpResponse(const uint8_t *buffer, unsigned int length)
+{
     // Parse http header
-    size_t dataOffset = 0;
-    std::map<std::string, std::string> response;
-    bool ret = ProcessServerResponse(buffer, length, response, dataOffset);
-    if (!ret) {
+    HttpResponseHeader response;
+    if (!ProcessServerResponse(buffer, length, response)) {
         CLOGE("buffer length %{public}u", length);
         return;
     }
 
-    int64_t contentLen = 0;
-    int64_t start = 0;
-    ret = ParseStringToInt64(response[HTTP_RSP_CONTENT_LENGTH], contentLen);
-    ret = ret && ParseStringToInt64(response[HTTP_RSP_CONTENT_RANGE_START], start);
-    if (!ret || contentLen <= 0 || contentLen > static_cast<int64_t>(length - dataOffset) || start <= INVALID_END_POS) {
+    if (!binaryFraming_ && response.framing == BINARY_FRAMING_VERSION) {
+        CLOGI("server accepts binary framing");
+        binaryFraming_ = true;
+    }
+
+    size_t dataOffset = response.dataOffset;
+    int64_t contentLen = response.contentLength;
+    int64_t start = response.rangeStart;
+    if (contentLen <= 0 || contentLen > static_cast<int64_t>(length - dataOffset) || start <= INVALID_END_POS) {
         CLOGE("Invalid response, len:%{public}" PRId64 ", start: %{public}" PRId64, contentLen, start);
         return;
     }
 
-    const std::string &fileName = response[HTTP_RSP_CONTENT_DISPOSITION];
-    CLOGD("headerLen %{public}zu URL %s start %{public}" PRId64 " content %{public}" PRId64, dataOffset,
-        fileName.c_str(), start, contentLen);
+    CLOGD("headerLen %{public}zu URL %.*s start %{public}" PRId64 " content %{public}" PRId64, dataOffset,
+        static_cast<int>(response.fileName.size()), response.fileName.data(), start, contentLen);
 
-    // Notify data to listener
-    std::lock_guard<std::mutex> lock(listenerLock_);
-    for (auto it = dataListeners_.begin(); it != dataListeners_.end(); it++) {
-        bool ret = (*it)->OnBytesReceived(fileName, buffer + dataOffset, start, contentLen);
-        if (ret) {
+    NotifyDataListeners(response.fileName, buffer + dataOffset, start, contentLen);
+}
+
+void CastLocalFileChannelClient::ProcessBinaryResponse(const uint8_t *buffer, unsigned int length)
+{
+    BinaryFrame frame;
+    size_t dataOffset = 0;
+    if (!ParseBinaryFrame(buffer, length, frame, dataOffset) || frame.type != FRAME_TYPE_RESPONSE) {
+        CLOGE("binary response parse error, buffer length %{public}u", length);
+        return;
+    }
+    if (frame.status != FRAME_STATUS_OK) {
+        CLOGE("frame status %{public}u, id %{public}u", frame.status, frame.requestId);
+        NotifyRequestFailed(frame.fileId, frame.offset);
+        return;
+    }
+    if (frame.length <= 0 || frame.length > static_cast<int64_t>(length - dataOffset) ||
+        frame.offset <= INVALID_END_POS) {
+        CLOGE("Invalid response, len:%{public}" PRId64 ", start: %{public}" PRId64, frame.length, frame.offset);
+        return;
+    }
+
+    CLOGD("id %{public}u URL %.*s start %{public}" PRId64 " content %{public}" PRId64, frame.requestId,
+        static_cast<int>(frame.fileId.size()), frame.fileId.data(), frame.offset, frame.length);
+
+    NotifyDataListeners(frame.fileId, buffer + dataOffset, frame.offset, frame.length);
+    OnCreditUsed(frame.fileId, frame.length);
+}
+
+void CastLocalFileChannelClient::NotifyDataListeners(std::string_view fileId, const uint8_t *data, int64_t start,
+    int64_t length)
+{
+    // Only the listeners of this file see the data, and the lock isn't held while they store it
+    std::shared_ptr<const DataListeners> listeners;
+    {
+        std::lock_guard<std::mutex> lock(listenerLock_);
+        auto it = dataListeners_.find(fileId);
+        if (it == dataListeners_.end()) {
+            CLOGW("no listener of the file, start:%{public}" PRId64, start);
+            return;
+        }
+        listeners = it->second;
+    }
+    for (const auto &listener : *listeners) {
+        if (listener->OnBytesReceived(fileId, data, start, length)) {
             CLOGD("data uploaded");
             break;
         }
     }
-    CLOGD("End");
+}
+
+void CastLocalFileChannelClient::NotifyRequestFailed(std::string_view fileId, int64_t start)
+{
+    std::shared_ptr<const DataListeners> listeners;
+    {
+        std::lock_guard<std::mutex> lock(listenerLock_);
+        auto it = dataListeners_.find(fileId);
+        if (it == dataListeners_.end()) {
+            return;
+        }
+        listeners = it->second;
+    }
+    for (const auto &listener : *listeners) {
+        listener->OnRequestFailed(fileId, start);
+    }
 }
 } // namespace CastEngineService
 } // namespace CastEngine
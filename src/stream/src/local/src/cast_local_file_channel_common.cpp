@@ -18,12 +18,14 @@
 
 #include "cast_local_file_channel_common.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cinttypes>
-#include <map>
-#include <optional>
 #include <regex>
 #include <string>
-#include <vector>
+#include <string_view>
+
+#include <securec.h>
 
 #include "cast_engine_common.h"
 #include "cast_engine_log.h"
@@ -35,27 +37,45 @@ namespace CastEngineService {
 DEFINE_CAST_ENGINE_LABEL("Cast-Localfile-Common");
 
 namespace {
-const std::string COMMON_SEPARATOR = ";";
-const std::string MSG_SEPARATOR = "\r\n";
-const std::string BLANK_SEPARATOR = " ";
-const std::string HTTP_HEADER_END_SEPARATOR = "\r\n\r\n";
-const std::string HTTP_HEADER_ENDX_SEPARATOR = "\n\n";
-const std::string HTTP_HEADER_RANGE = "Range";
-const std::string CONTENT_TYPE_TEXT = "Content-Type";
-const std::string CONTENT_LENGTH = "Content-Length";
-const std::string CONTENT_RANGE = "Content-Range";
-const std::string CONTENT_DISPOSITION = "Content-Disposition";
-const std::string STATUS_OK_STR = "200 OK";
-
-const int RANGE_START_IDX = 1;
-const int RANGE_END_IDX = 2;
-const int HTTP_REQ_METHOD_IDX = 0;
-const int HTTP_REQ_URI_IDX = 1;
-const int HTTP_RSP_PRO_IDX = 0;
-const int HTTP_RSP_CODE_IDX = 1;
-const int HTTP_REQ_CNT = 2;
-const int HTTP_RSP_CNT = 2;
-const int HTTP_MIN_HEADER = 2;
+const std::string_view HTTP_HEADER_RANGE = "Range";
+const std::string_view CONTENT_LENGTH = "Content-Length";
+const std::string_view CONTENT_RANGE = "Content-Range";
+const std::string_view CONTENT_DISPOSITION = "Content-Disposition";
+const std::string_view RANGE_UNIT_PREFIX = "bytes=";
+const std::string_view CONTENT_RANGE_UNIT_PREFIX = "bytes ";
+const std::string_view FILENAME_PARAM = "filename";
+// The headers of the channel are far shorter, a chunk without its end within this is no http message
+const size_t MAX_HTTP_HEADER_LEN = 4096;
+
+const uint32_t BINARY_FRAME_MAGIC = 0x43415354; // "CAST", never the start of a http message
+const uint8_t BINARY_FRAME_VERSION = 1;
+const size_t FRAME_MAGIC_POS = 0;
+const size_t FRAME_VERSION_POS = 4;
+const size_t FRAME_TYPE_POS = 5;
+const size_t FRAME_STATUS_POS = 6;
+const size_t FRAME_REQUEST_ID_POS = 8;
+const size_t FRAME_FILE_ID_LEN_POS = 12;
+const size_t FRAME_OFFSET_POS = 16;
+const size_t FRAME_LENGTH_POS = 24;
+const size_t FRAME_TOTAL_POS = 32;
+const uint32_t MAX_FRAME_FILE_ID_LEN = 1024;
+const unsigned int BITS_PER_BYTE = 8;
+
+void PutBigEndian(uint8_t *buffer, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++) {
+        buffer[bytes - 1 - i] = static_cast<uint8_t>(value >> (BITS_PER_BYTE * i));
+    }
+}
+
+uint64_t GetBigEndian(const uint8_t *buffer, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value = (value << BITS_PER_BYTE) | buffer[i];
+    }
+    return value;
+}
 
 bool IsRemoteUrl(const std::string &url)
 {
@@ -72,81 +92,183 @@ bool IsAllDigtal(const std::string &url)
     return true;
 }
 
-std::optional<size_t> CheckAndGetHttpHeader(const uint8_t *buffer, unsigned int length,
-    std::vector<std::string> &hdrList)
+/*
+ * Finds the blank line closing the header, looking at no more than MAX_HTTP_HEADER_LEN bytes so that a chunk
+ * without header is not scanned through its payload. Lines may end with "\r\n" or, tolerated, "\n".
+ */
+bool FindHttpHeaderEnd(std::string_view buffer, size_t &headerLength, size_t &dataOffset)
 {
-    std::string http(reinterpret_cast<const char *>(buffer), length);
-    auto pos = http.find(HTTP_HEADER_END_SEPARATOR);
-    size_t dataOffset = pos;
-    if (pos == std::string::npos) {
-        // Tolerance
-        pos = http.find(HTTP_HEADER_ENDX_SEPARATOR);
-        if (pos == std::string::npos) {
-            CLOGE("cannot find http header");
-            return std::nullopt;
+    std::string_view head = buffer.substr(0, MAX_HTTP_HEADER_LEN);
+    for (size_t pos = head.find('\n'); pos != std::string_view::npos; pos = head.find('\n', pos + 1)) {
+        if (pos + 1 < buffer.size() && buffer[pos + 1] == '\n') {
+            headerLength = pos;
+            dataOffset = pos + 2; // 2: "\n\n"
+            return true;
+        }
+        if (pos + 2 < buffer.size() && buffer[pos + 1] == '\r' && buffer[pos + 2] == '\n') {
+            headerLength = (pos > 0 && buffer[pos - 1] == '\r') ? pos - 1 : pos;
+            dataOffset = pos + 3; // 3: "\r\n" after the "\n" of the last line
+            return true;
         }
+    }
+    CLOGE("cannot find http header");
+    return false;
+}
 
-        dataOffset += HTTP_HEADER_ENDX_SEPARATOR.length();
-    } else {
-        dataOffset += HTTP_HEADER_END_SEPARATOR.length();
+// Takes the next line off header, without its line end
+std::string_view NextHttpLine(std::string_view &header)
+{
+    size_t pos = header.find('\n');
+    std::string_view line = header.substr(0, pos);
+    header.remove_prefix(pos == std::string_view::npos ? header.size() : pos + 1);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
     }
+    return line;
+}
 
-    http.resize(pos);
-    Utils::SplitString(http, hdrList, MSG_SEPARATOR);
-    if (hdrList.size() < HTTP_MIN_HEADER) {
-        CLOGE("Http header list %{public}zu", hdrList.size());
-        return std::nullopt;
+std::string_view TrimView(std::string_view str)
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
     }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
 
-    return dataOffset;
+// Takes the text up to the next occurrence of separator off str, all of str if there is none
+std::string_view NextToken(std::string_view &str, char separator)
+{
+    size_t pos = str.find(separator);
+    std::string_view token = str.substr(0, pos);
+    str.remove_prefix(pos == std::string_view::npos ? str.size() : pos + 1);
+    return token;
 }
 
-bool ParseHttpRangeHeader(std::string &range, int64_t &start, int64_t &end)
+bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs)
 {
-    if (range.empty()) {
+    if (lhs.size() != rhs.size()) {
         return false;
     }
-    /* Parse Range
-        Range: <unit>=<range-start>-
-        Range: <unit>=<range-start>-<range-end>
-        Range: <unit>=<range-start>-<range-end>, <range-start>-<range-end> # not support
-        Range: <unit>=<range-start>-<range-end>, <range-start>-<range-end>, <range-start>-<range-end> # not support
-    */
-    std::regex regex("bytes=(\\d+)-(\\d+)?");
-    std::smatch matches;
-    if (!std::regex_search(range, matches, regex)) {
+    for (size_t i = 0; i < lhs.size(); i++) {
+        if (std::tolower(static_cast<unsigned char>(lhs[i])) != std::tolower(static_cast<unsigned char>(rhs[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseDigits(std::string_view str, int64_t &val)
+{
+    if (str.empty()) {
         return false;
     }
+    int64_t result = 0;
+    for (char c : str) {
+        if (c < '0' || c > '9' || result > (INT64_MAX - (c - '0')) / DECIMALISM) {
+            return false;
+        }
+        result = result * DECIMALISM + (c - '0');
+    }
+    val = result;
+    return true;
+}
 
-    if (!ParseStringToInt64(matches[RANGE_START_IDX].str(), start) || start <= INVALID_END_POS) {
-        CLOGE("Invalid parsing or invalid start pos:%{public}" PRId64, start);
+// "<start>-" or "<start>-<end>", the end is INVALID_END_POS when absent
+bool ParseRangeSpec(std::string_view spec, int64_t &start, int64_t &end)
+{
+    size_t dash = spec.find('-');
+    if (dash == std::string_view::npos || !ParseDigits(spec.substr(0, dash), start)) {
         return false;
     }
+    std::string_view endStr = spec.substr(dash + 1);
+    end = INVALID_END_POS;
+    return endStr.empty() || ParseDigits(endStr, end);
+}
 
-    if (matches[RANGE_END_IDX].str().empty()) {
-        end = INVALID_END_POS;
-        return true;
+/*
+ * Parse Range
+ *   Range: <unit>=<range-start>-
+ *   Range: <unit>=<range-start>-<range-end>
+ *   Range: <unit>=<range-start>-<range-end>, <range-start>-<range-end> # only the first range is used
+ */
+bool ParseHttpRangeHeader(std::string_view range, int64_t &start, int64_t &end)
+{
+    if (range.substr(0, RANGE_UNIT_PREFIX.size()) != RANGE_UNIT_PREFIX) {
+        return false;
     }
+    range.remove_prefix(RANGE_UNIT_PREFIX.size());
+    return ParseRangeSpec(TrimView(NextToken(range, ',')), start, end);
+}
 
-    if (!ParseStringToInt64(matches[RANGE_END_IDX].str(), end)) {
-        CLOGE("Invalid parsing");
+// Content-Range: bytes <start>-<end>/<total>, end and total may be empty
+bool ParseContentRangeHeader(std::string_view range, HttpResponseHeader &response)
+{
+    if (range.substr(0, CONTENT_RANGE_UNIT_PREFIX.size()) != CONTENT_RANGE_UNIT_PREFIX) {
         return false;
     }
+    range.remove_prefix(CONTENT_RANGE_UNIT_PREFIX.size());
+    std::string_view spec = NextToken(range, '/');
+    if (!ParseRangeSpec(spec, response.rangeStart, response.rangeEnd)) {
+        return false;
+    }
+    response.rangeTotal = 0;
+    return range.empty() || ParseDigits(range, response.rangeTotal);
+}
 
-    return true;
+// Content-Disposition: attachment; filename=<name>, the name may be quoted
+bool ParseDispositionHeader(std::string_view disposition, std::string_view &fileName)
+{
+    while (!disposition.empty()) {
+        std::string_view param = TrimView(NextToken(disposition, ';'));
+        size_t equal = param.find('=');
+        if (equal == std::string_view::npos || TrimView(param.substr(0, equal)).substr(0, FILENAME_PARAM.size()) !=
+            FILENAME_PARAM) {
+            continue;
+        }
+        std::string_view value = TrimView(param.substr(equal + 1));
+        if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front()) {
+            value = value.substr(1, value.size() - 2); // 2: both quotes
+        }
+        fileName = value;
+        return !fileName.empty();
+    }
+    return false;
 }
 
-void ParseHttpHeaderList(std::vector<std::string> &hdrList, std::map<std::string, std::string> &request)
+/*
+ * Splits the header block into the start line, returned, and the header fields, handed to onField with their
+ * name and trimmed value.
+ */
+template<typename FieldHandler>
+bool ForEachHttpField(const uint8_t *buffer, int length, std::string_view &startLine, size_t &dataOffset,
+    FieldHandler onField)
 {
-    // Parse other header
-    for (size_t index = 1; index < hdrList.size(); index++) {
+    if (buffer == nullptr || length <= 0) {
+        return false;
+    }
+    std::string_view message(reinterpret_cast<const char *>(buffer), static_cast<size_t>(length));
+    size_t headerLength = 0;
+    if (!FindHttpHeaderEnd(message, headerLength, dataOffset)) {
+        return false;
+    }
+    std::string_view header = message.substr(0, headerLength);
+    startLine = NextHttpLine(header);
+    if (startLine.empty() || header.empty()) {
+        CLOGE("Http header without fields");
+        return false;
+    }
+    while (!header.empty()) {
+        std::string_view line = NextHttpLine(header);
         // split with ": ". A ":" may used as prefix in http/2, skip this
-        std::size_t pos = hdrList[index].find(": ");
-        if (pos != std::string::npos) {
-            std::string value = hdrList[index].substr(pos + std::string(": ").size());
-            request.insert({ hdrList[index].substr(0, pos), Utils::Trim(value) });
+        size_t pos = line.find(": ");
+        if (pos != std::string_view::npos) {
+            onField(line.substr(0, pos), TrimView(line.substr(pos + 2))); // 2: ": "
         }
     }
+    return true;
 }
 }
 
@@ -211,91 +333,127 @@ bool ParseStringToInt64(const std::string &str, int64_t &val)
     return true;
 }
 
-bool ParseHttpRequest(const uint8_t *buffer, int length, std::map<std::string, std::string> &request)
+bool ParseHttpRequest(const uint8_t *buffer, int length, HttpRequestHeader &request)
 {
-    std::vector<std::string> hdrList;
-    if (!CheckAndGetHttpHeader(buffer, length, hdrList)) {
+    std::string_view requestLine;
+    size_t dataOffset = 0;
+    std::string_view range;
+    bool ret = ForEachHttpField(buffer, length, requestLine, dataOffset,
+        [&request, &range](std::string_view name, std::string_view value) {
+            if (EqualsIgnoreCase(name, HTTP_HEADER_RANGE)) {
+                range = value;
+            } else if (EqualsIgnoreCase(name, HTTP_PRIORITY_HEADER)) {
+                int64_t priority = 0;
+                request.priority = ParseDigits(value, priority) ? static_cast<uint16_t>(priority) : 0;
+            } else if (EqualsIgnoreCase(name, HTTP_FRAMING_HEADER)) {
+                request.framing = value;
+            }
+        });
+    if (!ret) {
         return false;
     }
 
     // Process http request line
-    std::vector<std::string> reqList;
-    Utils::SplitString(hdrList[0], reqList, BLANK_SEPARATOR);
-    if (reqList.size() < HTTP_REQ_CNT) {
-        return false;
-    }
-    request.insert({ HTTP_REQ_METHOD, reqList[HTTP_REQ_METHOD_IDX] });
-    request.insert({ HTTP_REQ_URI, reqList[HTTP_REQ_URI_IDX] });
-
-    // Parse other header
-    ParseHttpHeaderList(hdrList, request);
-
-    // Parse "Range", it is necessary
-    if (request.count(HTTP_HEADER_RANGE) == 0) {
-        return false;
-    }
-    int64_t start;
-    int64_t end;
-    if (!ParseHttpRangeHeader(request[HTTP_HEADER_RANGE], start, end)) {
+    request.method = NextToken(requestLine, ' ');
+    request.uri = NextToken(requestLine, ' ');
+    if (request.method.empty() || request.uri.empty()) {
         return false;
     }
-    request.insert({ HTTP_REQ_RANGE_START, std::to_string(start) });
-    request.insert({ HTTP_REQ_RANGE_END, std::to_string(end) });
 
-    return true;
+    // "Range" is necessary
+    return ParseHttpRangeHeader(range, request.rangeStart, request.rangeEnd);
 }
 
-bool ParseHttpResponse(const uint8_t *buffer, int length, std::map<std::string, std::string> &response,
-    size_t &dataOffset)
+bool ParseHttpResponse(const uint8_t *buffer, int length, HttpResponseHeader &response)
 {
-    std::vector<std::string> hdrList;
-    auto offset = CheckAndGetHttpHeader(buffer, length, hdrList);
-    if (!offset) {
+    std::string_view statusLine;
+    bool hasLength = false;
+    bool hasRange = false;
+    bool hasDisposition = false;
+    bool ret = ForEachHttpField(buffer, length, statusLine, response.dataOffset,
+        [&response, &hasLength, &hasRange, &hasDisposition](std::string_view name, std::string_view value) {
+            if (EqualsIgnoreCase(name, CONTENT_LENGTH)) {
+                hasLength = ParseDigits(value, response.contentLength);
+            } else if (EqualsIgnoreCase(name, CONTENT_RANGE)) {
+                hasRange = ParseContentRangeHeader(value, response);
+            } else if (EqualsIgnoreCase(name, CONTENT_DISPOSITION)) {
+                hasDisposition = ParseDispositionHeader(value, response.fileName);
+            } else if (EqualsIgnoreCase(name, HTTP_FRAMING_HEADER)) {
+                response.framing = value;
+            }
+        });
+    if (!ret) {
         return false;
     }
 
     // Process http response line
-    std::vector<std::string> rspList;
-    Utils::SplitString(hdrList[0], rspList, BLANK_SEPARATOR);
-    if (rspList.size() < HTTP_RSP_CNT) {
+    response.protocol = NextToken(statusLine, ' ');
+    response.statusCode = NextToken(statusLine, ' ');
+    if (response.protocol.empty() || response.statusCode.empty()) {
         return false;
     }
-    response.insert({ HTTP_RSP_PROTOCOL, rspList[HTTP_RSP_PRO_IDX] });
-    response.insert({ HTTP_RSP_CODE, rspList[HTTP_RSP_CODE_IDX] });
-
-    // Parse other header
-    ParseHttpHeaderList(hdrList, response);
 
     // Check necessary headers
-    if (response.find(CONTENT_LENGTH) == response.end()) {
+    return hasLength && hasRange && hasDisposition;
+}
+
+bool IsBinaryFrame(const uint8_t *buffer, unsigned int length)
+{
+    return buffer != nullptr && length >= BINARY_FRAME_HEADER_LEN &&
+        GetBigEndian(buffer + FRAME_MAGIC_POS, sizeof(uint32_t)) == BINARY_FRAME_MAGIC;
+}
+
+size_t GetBinaryFrameHeaderLength(const BinaryFrame &frame)
+{
+    return BINARY_FRAME_HEADER_LEN + frame.fileId.size();
+}
+
+bool EncodeBinaryFrame(const BinaryFrame &frame, uint8_t *buffer, size_t length)
+{
+    if (buffer == nullptr || frame.fileId.size() > MAX_FRAME_FILE_ID_LEN ||
+        length < GetBinaryFrameHeaderLength(frame)) {
+        CLOGE("Invalid frame buffer %{public}zu, file id len %{public}zu", length, frame.fileId.size());
         return false;
     }
-    if (response.find(CONTENT_RANGE) == response.end()) {
+    PutBigEndian(buffer + FRAME_MAGIC_POS, BINARY_FRAME_MAGIC, sizeof(uint32_t));
+    buffer[FRAME_VERSION_POS] = BINARY_FRAME_VERSION;
+    buffer[FRAME_TYPE_POS] = frame.type;
+    PutBigEndian(buffer + FRAME_STATUS_POS, frame.status, sizeof(uint16_t));
+    PutBigEndian(buffer + FRAME_REQUEST_ID_POS, frame.requestId, sizeof(uint32_t));
+    PutBigEndian(buffer + FRAME_FILE_ID_LEN_POS, frame.fileId.size(), sizeof(uint32_t));
+    PutBigEndian(buffer + FRAME_OFFSET_POS, static_cast<uint64_t>(frame.offset), sizeof(uint64_t));
+    PutBigEndian(buffer + FRAME_LENGTH_POS, static_cast<uint64_t>(frame.length), sizeof(uint64_t));
+    PutBigEndian(buffer + FRAME_TOTAL_POS, static_cast<uint64_t>(frame.total), sizeof(uint64_t));
+    if (!frame.fileId.empty() && memcpy_s(buffer + BINARY_FRAME_HEADER_LEN, length - BINARY_FRAME_HEADER_LEN,
+        frame.fileId.data(), frame.fileId.size()) != EOK) {
+        CLOGE("memcpy_s fail");
         return false;
     }
+    return true;
+}
 
-    response.insert({ HTTP_RSP_CONTENT_LENGTH, response[CONTENT_LENGTH] });
-    // Extract Content-Range: start/end/filelen
-    std::regex regexRange("bytes (\\d+)-(\\d*)/(\\d*)");
-    std::smatch matches;
-    if (!std::regex_search(response[CONTENT_RANGE], matches, regexRange)) {
+bool ParseBinaryFrame(const uint8_t *buffer, unsigned int length, BinaryFrame &frame, size_t &dataOffset)
+{
+    if (!IsBinaryFrame(buffer, length)) {
         return false;
     }
-    response.insert({ HTTP_RSP_CONTENT_RANGE_START, matches[1].str() });
-    response.insert({ HTTP_RSP_CONTENT_RANGE_END, matches[2].str() });
-    response.insert({ HTTP_RSP_CONTENT_RANGE_TOTAL, matches[3].str() });
-    // Extract Content-Disposition
-    if (response.find(CONTENT_DISPOSITION) == response.end()) {
+    if (buffer[FRAME_VERSION_POS] != BINARY_FRAME_VERSION) {
+        CLOGE("Not support frame version %{public}u", buffer[FRAME_VERSION_POS]);
         return false;
     }
-    std::regex regexFile("filename[^;=\\n]*=((['\"]).*?\\2|[^;\\n]*)");
-    if (!std::regex_search(response[CONTENT_DISPOSITION], matches, regexFile)) {
+    uint32_t fileIdLen = static_cast<uint32_t>(GetBigEndian(buffer + FRAME_FILE_ID_LEN_POS, sizeof(uint32_t)));
+    if (fileIdLen > MAX_FRAME_FILE_ID_LEN || fileIdLen > length - BINARY_FRAME_HEADER_LEN) {
+        CLOGE("Invalid file id len %{public}u, frame len %{public}u", fileIdLen, length);
         return false;
     }
-    response.insert({ HTTP_RSP_CONTENT_DISPOSITION, matches[1].str() });
-
-    dataOffset = *offset;
-
+    frame.type = buffer[FRAME_TYPE_POS];
+    frame.status = static_cast<uint16_t>(GetBigEndian(buffer + FRAME_STATUS_POS, sizeof(uint16_t)));
+    frame.requestId = static_cast<uint32_t>(GetBigEndian(buffer + FRAME_REQUEST_ID_POS, sizeof(uint32_t)));
+    frame.offset = static_cast<int64_t>(GetBigEndian(buffer + FRAME_OFFSET_POS, sizeof(uint64_t)));
+    frame.length = static_cast<int64_t>(GetBigEndian(buffer + FRAME_LENGTH_POS, sizeof(uint64_t)));
+    frame.total = static_cast<int64_t>(GetBigEndian(buffer + FRAME_TOTAL_POS, sizeof(uint64_t)));
+    frame.fileId = std::string_view(reinterpret_cast<const char *>(buffer + BINARY_FRAME_HEADER_LEN), fileIdLen);
+    dataOffset = BINARY_FRAME_HEADER_LEN + fileIdLen;
     return true;
 }
 } // namespace CastEngineService
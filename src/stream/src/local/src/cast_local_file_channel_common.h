@@ -19,33 +19,95 @@
 #ifndef CAST_LOCAL_FILE_CHANNEL_COMMON_H
 #define CAST_LOCAL_FILE_CHANNEL_COMMON_H
 
+#include <cstdint>
 #include <string>
-#include <map>
+#include <string_view>
 
 namespace OHOS {
 namespace CastEngine {
 namespace CastEngineService {
-const std::string HTTP_REQ_METHOD = "method";
-const std::string HTTP_REQ_URI = "uri";
-const std::string HTTP_REQ_RANGE_START = "range_start";
-const std::string HTTP_REQ_RANGE_END = "range_end";
-const std::string HTTP_RSP_PROTOCOL = "protocol_ver";
-const std::string HTTP_RSP_CODE = "statusCode";
-const std::string HTTP_RSP_CONTENT_LENGTH = "content_length";
-const std::string HTTP_RSP_CONTENT_RANGE_START = "range_start";
-const std::string HTTP_RSP_CONTENT_RANGE_END = "range_end";
-const std::string HTTP_RSP_CONTENT_RANGE_TOTAL = "range_total";
-const std::string HTTP_RSP_CONTENT_DISPOSITION = "disposition";
-
 const int64_t INVALID_END_POS = -1;
 
+// The client offers the binary framing with this http header, a server supporting it echoes it in the response
+const std::string HTTP_FRAMING_HEADER = "X-Cast-Framing";
+const std::string BINARY_FRAMING_VERSION = "binary/1";
+
+// Priority of a range request, a blocking read of the player is served ahead of the background prefetch
+const std::string HTTP_PRIORITY_HEADER = "X-Cast-Priority";
+const uint16_t REQUEST_PRIORITY_PREFETCH = 0;
+const uint16_t REQUEST_PRIORITY_BLOCKING = 1;
+
+const uint8_t FRAME_TYPE_REQUEST = 1;
+const uint8_t FRAME_TYPE_RESPONSE = 2;
+// Drops the request with the same request id if the server has not sent its response yet
+const uint8_t FRAME_TYPE_CANCEL = 3;
+/*
+ * Grants the server length more bytes of binary responses for the file. A file the sink granted credit for is sent
+ * only within it, and each of its binary requests is answered, with FRAME_STATUS_SERVER_ERROR if it can't be served.
+ */
+const uint8_t FRAME_TYPE_CREDIT = 4;
+// Requests [offset, offset + length) at once, answered with consecutive responses carrying the same request id
+const uint8_t FRAME_TYPE_BULK_REQUEST = 5;
+const uint16_t FRAME_STATUS_OK = 200;
+const uint16_t FRAME_STATUS_NOT_FOUND = 404;
+const uint16_t FRAME_STATUS_SERVER_ERROR = 500;
+// Refused unserved because the server already queues too many requests of the sink, it may be asked again later
+const uint16_t FRAME_STATUS_BUSY = 503;
+
+/*
+ * Compact binary framing of the local file channel. Big endian fixed header of BINARY_FRAME_HEADER_LEN bytes:
+ * magic(4) version(1) type(1) status(2) requestId(4) fileIdLen(4) offset(8) length(8) total(8),
+ * followed by the file id and, for a response, the file data. A request carries its priority in the status field.
+ */
+const size_t BINARY_FRAME_HEADER_LEN = 40;
+
+/*
+ * Parsed http headers of the local file channel. The views point into the received buffer and are only valid
+ * as long as it is.
+ */
+struct HttpRequestHeader {
+    std::string_view method;
+    std::string_view uri;
+    int64_t rangeStart{ 0 };
+    int64_t rangeEnd{ INVALID_END_POS };
+    uint16_t priority{ REQUEST_PRIORITY_PREFETCH };
+    std::string_view framing;
+};
+
+struct HttpResponseHeader {
+    std::string_view protocol;
+    std::string_view statusCode;
+    int64_t contentLength{ 0 };
+    int64_t rangeStart{ 0 };
+    int64_t rangeEnd{ INVALID_END_POS };
+    int64_t rangeTotal{ 0 };
+    std::string_view fileName;
+    std::string_view framing;
+    // Start of the body in the buffer
+    size_t dataOffset{ 0 };
+};
+
+// A parsed frame's file id points into the received buffer and is only valid as long as it is
+struct BinaryFrame {
+    uint8_t type{ 0 };
+    uint16_t status{ 0 };
+    uint32_t requestId{ 0 };
+    int64_t offset{ 0 };
+    int64_t length{ 0 };
+    int64_t total{ 0 };
+    std::string_view fileId;
+};
+
 int ConvertFileId(const std::string &fileId);
 bool IsLocalFile(const std::string &url);
 bool IsLocalUrl(const std::string &url);
-bool ParseHttpRequest(const uint8_t *buffer, int length, std::map<std::string, std::string> &request);
+bool ParseHttpRequest(const uint8_t *buffer, int length, HttpRequestHeader &request);
 bool ParseStringToInt64(const std::string &str, int64_t &val);
-bool ParseHttpResponse(const uint8_t *buffer, int length, std::map<std::string, std::string> &response,
-    size_t &dataOffset);
+bool ParseHttpResponse(const uint8_t *buffer, int length, HttpResponseHeader &response);
+bool IsBinaryFrame(const uint8_t *buffer, unsigned int length);
+size_t GetBinaryFrameHeaderLength(const BinaryFrame &frame);
+bool EncodeBinaryFrame(const BinaryFrame &frame, uint8_t *buffer, size_t length);
+bool ParseBinaryFrame(const uint8_t *buffer, unsigned int length, BinaryFrame &frame, size_t &dataOffset);
 } // namespace CastEngineService
 } // namespace CastEngine
 } // namespace OHOS
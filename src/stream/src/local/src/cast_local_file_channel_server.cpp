@@ -29,6 +29,7 @@
 #include <securec.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -42,17 +43,47 @@ namespace CastEngineService {
 DEFINE_CAST_ENGINE_LABEL("Cast-Localfile-Server");
 
 // DSoftbus, sendByte limit max data 2M at one time. Reserve 1KB for http header
-static const int64_t MAX_READ_LEN = 2 * 1024 * 1024 - 1024;
+static const int64_t HTTP_HEADER_RESERVE_LEN = 1024;
+static const int64_t MAX_READ_LEN = 2 * 1024 * 1024 - HTTP_HEADER_RESERVE_LEN;
+// Disk reads of different requests overlap on the workers, each channel itself is still one ordered pipe
+static const size_t WORKER_COUNT = 3;
+static const size_t MAX_POOL_BUFFER_COUNT = WORKER_COUNT;
+// Queued and parked requests per sink, more of them are refused as busy
+static const size_t MAX_PENDING_REQUEST_COUNT = 32;
+// Sequential reads are hinted this far ahead, topped up once half of it has been requested
+static const int64_t READ_AHEAD_SIZE = 8 * 1024 * 1024;
+// Requests of a prefetch window arrive slightly out of order, a start this close to the last end still counts
+static const int64_t SEQUENTIAL_SLACK = 4 * 1024 * 1024;
+static const int SEQUENTIAL_THRESHOLD = 2;
 
 CastLocalFileChannelServer::CastLocalFileChannelServer()
 {
     CLOGD("in");
+    isRunning_.store(true);
+    for (size_t i = 0; i < WORKER_COUNT; i++) {
+        workers_.emplace_back(&CastLocalFileChannelServer::WorkerLoop, this);
+    }
 }
 
 CastLocalFileChannelServer::~CastLocalFileChannelServer()
 {
     CLOGD("in");
 
+    isRunning_.store(false);
+    {
+        std::lock_guard<std::mutex> lock(taskLock_);
+        for (auto &sink : sinks_) {
+            sink.second->pendingRequests.clear();
+            sink.second->parkedRequests.clear();
+        }
+        taskCond_.notify_all();
+        sendCond_.notify_all();
+    }
+    for (auto &worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
     ClearAllMapInfo();
 }
 
@@ -68,6 +99,8 @@ void CastLocalFileChannelServer::ClearAllMapInfo()
         }
     }
     fileMap_.clear();
+    std::lock_guard<std::mutex> readAheadLock(readAheadLock_);
+    readPatterns_.clear();
 }
 
 std::shared_ptr<IChannelListener> CastLocalFileChannelServer::GetChannelListener()
@@ -78,16 +111,38 @@ std::shared_ptr<IChannelListener> CastLocalFileChannelServer::GetChannelListener
 void CastLocalFileChannelServer::AddChannel(std::shared_ptr<Channel> channel)
 {
     CLOGI("in");
-    std::unique_lock<std::mutex> lock(chLock_);
-    channel_ = channel;
-    CLOGI("out");
+    if (!channel) {
+        return;
+    }
+    auto sink = std::make_shared<Sink>();
+    sink->channel = channel;
+    {
+        std::lock_guard<std::mutex> lock(taskLock_);
+        sink->id = nextSinkId_++;
+        sinks_[sink->id] = sink;
+    }
+    // The channel was created with this server as listener, which can't tell the sinks apart
+    channel->SetListener(std::make_shared<SinkListener>(shared_from_this(), sink));
+    CLOGI("out, sink %{public}u", sink->id);
 }
 
 void CastLocalFileChannelServer::RemoveChannel(std::shared_ptr<Channel> channel)
 {
     CLOGI("in");
-    std::unique_lock<std::mutex> lock(chLock_);
-    channel_ = nullptr;
+    std::lock_guard<std::mutex> lock(taskLock_);
+    for (auto it = sinks_.begin(); it != sinks_.end(); it++) {
+        if (it->second->channel != channel) {
+            continue;
+        }
+        // Workers serving it drop their responses, its receive thread stops waiting for room
+        it->second->removed = true;
+        it->second->pendingRequests.clear();
+        it->second->parkedRequests.clear();
+        sinks_.erase(it);
+        taskCond_.notify_all();
+        sendCond_.notify_all();
+        break;
+    }
     CLOGI("out");
 }
 
@@ -109,17 +164,7 @@ bool CastLocalFileChannelServer::AddLocalFileInfo(MediaInfo &mediaInfo)
 
     CLOGD("local url");
 
-    // Encode url. Normal base64 is ok.
-    std::string encodedFileId;
-    if (!Utils::Base64Encode(mediaInfo.mediaUrl, encodedFileId)) {
-        CLOGE("base64 encode fail");
-        return false;
-    }
-
-    CLOGD("encoded url %s", encodedFileId.c_str());
-
     LocalFileInfo data;
-    data.encodedUrl = encodedFileId;
     if (!IsLocalFile(mediaInfo.mediaUrl)) {
         // local fd
         data.fd = ConvertFileId(mediaInfo.mediaUrl);
@@ -130,6 +175,16 @@ bool CastLocalFileChannelServer::AddLocalFileInfo(MediaInfo &mediaInfo)
         CLOGE("not support local file url");
         return false;
     }
+
+    // Encode url. Normal base64 is ok. The file version makes the id differ whenever the fd number is reused for
+    // another file or the file is modified, so the sink can keep data cached under it.
+    std::string encodedFileId;
+    if (!Utils::Base64Encode(mediaInfo.mediaUrl + GetFileVersionByFd(data.fd), encodedFileId)) {
+        CLOGE("base64 encode fail");
+        return false;
+    }
+    data.encodedUrl = encodedFileId;
+    data.sharedId = std::make_shared<const std::string>(encodedFileId);
     CLOGD("encoded url %s, Local fd: %{public}d, len: %{public}" PRId64, encodedFileId.c_str(), data.fd, data.fileLen);
 
     // Add to local map for feature use.
@@ -145,6 +200,42 @@ void CastLocalFileChannelServer::ClearAllLocalFileInfo()
 {
     CLOGI("in");
     ClearAllMapInfo();
+    readCache_.Clear();
+}
+
+void CastLocalFileChannelServer::SinkListener::OnDataReceived(const uint8_t *buffer, unsigned int length,
+    long timeCost)
+{
+    auto server = server_.lock();
+    auto sink = sink_.lock();
+    if (!server || !sink) {
+        return;
+    }
+    if (!buffer || length == 0) {
+        CLOGE("Invalid param buffer length %{public}u", length);
+        return;
+    }
+    server->ProcessRequestData(sink, buffer, length);
+}
+
+void CastLocalFileChannelServer::SinkListener::OnSendCongestionChanged(bool congested)
+{
+    auto server = server_.lock();
+    auto sink = sink_.lock();
+    if (!server || !sink) {
+        return;
+    }
+    server->SetSinkCongested(*sink, congested);
+}
+
+// Holds the responses of the sink back while its channel can't take more, instead of piling them in its queue
+void CastLocalFileChannelServer::SetSinkCongested(Sink &sink, bool congested)
+{
+    std::lock_guard<std::mutex> lock(taskLock_);
+    sink.congested = congested;
+    if (!congested) {
+        sendCond_.notify_all();
+    }
 }
 
 void CastLocalFileChannelServer::OnDataReceived(const uint8_t *buffer, unsigned int length, long timeCost)
@@ -154,37 +245,376 @@ void CastLocalFileChannelServer::OnDataReceived(const uint8_t *buffer, unsigned
         return;
     }
 
-    ProcessRequestData(buffer, length);
+    // Only reached before AddChannel has put a SinkListener on the channel, which is unambiguous with one sink
+    std::shared_ptr<Sink> sink;
+    {
+        std::lock_guard<std::mutex> lock(taskLock_);
+        if (sinks_.size() != 1) {
+            CLOGE("Request of an unknown sink, sinks:%{public}zu", sinks_.size());
+            return;
+        }
+        sink = sinks_.begin()->second;
+    }
+    ProcessRequestData(sink, buffer, length);
 }
 
-void CastLocalFileChannelServer::ProcessRequestData(const uint8_t *buffer, int length)
+void CastLocalFileChannelServer::ProcessRequestData(std::shared_ptr<Sink> sink, const uint8_t *buffer, int length)
 {
-    CLOGD("request len %{public}d", length);
+    CLOGD("sink %{public}u request len %{public}d", sink->id, length);
 
-    // Valid and Parse http header
-    std::map<std::string, std::string> request;
-    if (!ParseHttpRequest(buffer, length, request)) {
-        CLOGE("Invalid http header");
+    FileRequest request;
+    if (!IsBinaryFrame(buffer, static_cast<unsigned int>(length))) {
+        if (ParseHttpFileRequest(buffer, length, request)) {
+            EnqueueRequest(sink, request);
+        }
         return;
     }
 
-    // Get request param and valid. URI/Range is checked in ParseHttpRequest
-    if (request[HTTP_REQ_METHOD].compare("GET") != 0) {
-        CLOGE("Not support request method %{public}s", request[HTTP_REQ_METHOD].c_str());
+    BinaryFrame frame;
+    size_t dataOffset = 0;
+    if (!ParseBinaryFrame(buffer, static_cast<unsigned int>(length), frame, dataOffset)) {
+        CLOGE("Invalid binary frame");
+        return;
+    }
+    if (frame.type == FRAME_TYPE_CANCEL) {
+        CancelRequest(sink, frame.requestId);
         return;
     }
+    if (frame.type == FRAME_TYPE_CREDIT) {
+        GrantCredit(sink, frame.fileId, frame.length);
+        return;
+    }
+    if (ParseBinaryFileRequest(frame, request)) {
+        EnqueueRequest(sink, request);
+    }
+}
+
+/*
+ * Runs on the I/O thread of the channel, shared with every other socket of its loop, so it never waits for the
+ * workers. A sink far ahead of them gets its excess requests refused as busy, and asks for them again later.
+ */
+void CastLocalFileChannelServer::EnqueueRequest(std::shared_ptr<Sink> sink, FileRequest &request)
+{
+    {
+        std::lock_guard<std::mutex> lock(taskLock_);
+        if (sink->removed || !isRunning_.load()) {
+            return;
+        }
+        if (sink->pendingRequests.size() + sink->parkedRequests.size() < MAX_PENDING_REQUEST_COUNT) {
+            request.sequence = sink->requestSequence++;
+            sink->pendingRequests.push_back(request);
+            std::push_heap(sink->pendingRequests.begin(), sink->pendingRequests.end(), RequestOrder());
+            taskCond_.notify_all();
+            return;
+        }
+    }
+    CLOGW("sink %{public}u busy, refuse request %{public}u", sink->id, request.requestId);
+    // Out of the send turns, which only order the responses of queued requests
+    SendFailureFrame(*sink, request, FRAME_STATUS_BUSY);
+}
 
-    // Response
-    int64_t start = 0;
-    int64_t end = 0;
-    bool ret = ParseStringToInt64(request[HTTP_REQ_RANGE_START], start);
-    ret = ret && ParseStringToInt64(request[HTTP_REQ_RANGE_END], end);
-    if (!ret || start <= INVALID_END_POS) {
-        CLOGE("Invalid request param, start:%{public}" PRId64 ", end: %{public}" PRId64, start, end);
+void CastLocalFileChannelServer::CancelRequest(std::shared_ptr<Sink> sink, uint32_t requestId)
+{
+    std::lock_guard<std::mutex> lock(taskLock_);
+    auto isCancelled = [requestId](const FileRequest &request) { return request.requestId == requestId; };
+    auto &pending = sink->pendingRequests;
+    auto &parked = sink->parkedRequests;
+    size_t queuedCount = pending.size() + parked.size();
+    // The rest of a bulk request may be queued while a part of it is served
+    pending.erase(std::remove_if(pending.begin(), pending.end(), isCancelled), pending.end());
+    std::make_heap(pending.begin(), pending.end(), RequestOrder());
+    parked.erase(std::remove_if(parked.begin(), parked.end(), isCancelled), parked.end());
+    if (pending.size() + parked.size() != queuedCount) {
+        CLOGD("cancel queued request %{public}u", requestId);
+        taskCond_.notify_all();
+    }
+    // Being read by a worker, which drops it before its turn to send
+    if (sink->servingRequests.count(requestId) != 0) {
+        CLOGD("cancel serving request %{public}u", requestId);
+        sink->cancelledRequests.insert(requestId);
+    }
+}
+
+void CastLocalFileChannelServer::GrantCredit(std::shared_ptr<Sink> sink, std::string_view fileId, int64_t length)
+{
+    if (length <= 0) {
+        CLOGE("Invalid credit %{public}" PRId64, length);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(taskLock_);
+    auto credit = sink->credits.find(fileId);
+    if (credit == sink->credits.end()) {
+        credit = sink->credits.emplace(std::string(fileId), 0).first;
+    }
+    credit->second += length;
+    CLOGD("sink %{public}u credit %{public}" PRId64 " +%{public}" PRId64, sink->id, credit->second, length);
+    UnparkRequestsLocked(*sink, fileId);
+}
+
+/*
+ * A binary data request of a file under credit takes the credit of its longest possible response before it is
+ * served. Returns false, taking nothing, when the file has less credit left.
+ */
+bool CastLocalFileChannelServer::TakeCreditLocked(Sink &sink, FileRequest &request)
+{
+    request.creditUsed = 0;
+    auto credit = sink.credits.find(*request.uri);
+    if (!request.binaryFrame || credit == sink.credits.end() || (request.start == 0 && request.end == 0)) {
+        return true;
+    }
+    int64_t length = (request.end > request.start) ? std::min(request.end - request.start, MAX_READ_LEN) :
+        MAX_READ_LEN;
+    if (credit->second < length) {
+        CLOGD("park request %{public}u, credit %{public}" PRId64 " < %{public}" PRId64, request.requestId,
+            credit->second, length);
+        return false;
+    }
+    credit->second -= length;
+    request.creditUsed = length;
+    return true;
+}
+
+void CastLocalFileChannelServer::ReturnCreditLocked(Sink &sink, const FileRequest &request, int64_t sentLength)
+{
+    if (request.creditUsed <= sentLength) {
+        return;
+    }
+    sink.credits[*request.uri] += request.creditUsed - sentLength;
+    UnparkRequestsLocked(sink, *request.uri);
+}
+
+// Serves the first part of a bulk request now and queues the rest, which another worker can read meanwhile
+void CastLocalFileChannelServer::SplitBulkRequestLocked(Sink &sink, FileRequest &request)
+{
+    if (!request.bulk || request.end - request.start <= MAX_READ_LEN) {
+        return;
+    }
+    FileRequest rest = request;
+    rest.start = request.start + MAX_READ_LEN;
+    rest.creditUsed = 0;
+    request.end = rest.start;
+    // Same sequence, so the rest comes next among the requests of its priority
+    sink.pendingRequests.push_back(std::move(rest));
+    std::push_heap(sink.pendingRequests.begin(), sink.pendingRequests.end(), RequestOrder());
+}
+
+void CastLocalFileChannelServer::UnparkRequestsLocked(Sink &sink, std::string_view fileId)
+{
+    auto &parked = sink.parkedRequests;
+    auto first = std::partition(parked.begin(), parked.end(),
+        [fileId](const FileRequest &request) { return *request.uri != fileId; });
+    if (first == parked.end()) {
         return;
     }
+    // They keep their sequence, so they are served in the order they came in
+    for (auto it = first; it != parked.end(); it++) {
+        sink.pendingRequests.push_back(std::move(*it));
+        std::push_heap(sink.pendingRequests.begin(), sink.pendingRequests.end(), RequestOrder());
+    }
+    parked.erase(first, parked.end());
+    taskCond_.notify_all();
+}
 
-    ResponseFileRequest(request[HTTP_REQ_URI], start, end);
+bool CastLocalFileChannelServer::IsRequestCancelled(const Sink &sink, uint32_t requestId)
+{
+    std::lock_guard<std::mutex> lock(taskLock_);
+    return sink.removed || (requestId != 0 && sink.cancelledRequests.count(requestId) != 0);
+}
+
+bool CastLocalFileChannelServer::IsFanOut()
+{
+    std::lock_guard<std::mutex> lock(taskLock_);
+    return sinks_.size() > 1;
+}
+
+/*
+ * Goes round the sinks with pending requests, starting after the one served last. A sink gets no more workers
+ * than its share among the sinks with work, so one whose channel is slow to drain can hold its share of the
+ * workers at most and the others keep being served.
+ */
+std::shared_ptr<CastLocalFileChannelServer::Sink> CastLocalFileChannelServer::PickSinkLocked()
+{
+    size_t activeCount = 0;
+    for (const auto &sink : sinks_) {
+        if (!sink.second->pendingRequests.empty() || sink.second->servingCount != 0) {
+            activeCount++;
+        }
+    }
+    if (activeCount == 0) {
+        return nullptr;
+    }
+    size_t share = std::max(static_cast<size_t>(1), (WORKER_COUNT + activeCount - 1) / activeCount);
+    auto start = sinks_.upper_bound(lastServedSinkId_);
+    for (size_t i = 0; i < sinks_.size(); i++, start++) {
+        if (start == sinks_.end()) {
+            start = sinks_.begin();
+        }
+        const auto &sink = start->second;
+        if (!sink->pendingRequests.empty() && sink->servingCount < share) {
+            lastServedSinkId_ = sink->id;
+            return sink;
+        }
+    }
+    return nullptr;
+}
+
+void CastLocalFileChannelServer::WorkerLoop()
+{
+    CLOGD("in");
+    while (isRunning_.load()) {
+        FileRequest request;
+        std::shared_ptr<Sink> sink;
+        {
+            std::unique_lock<std::mutex> lock(taskLock_);
+            taskCond_.wait(lock, [this, &sink] {
+                sink = isRunning_.load() ? PickSinkLocked() : nullptr;
+                return sink != nullptr || !isRunning_.load();
+            });
+            if (!isRunning_.load()) {
+                break;
+            }
+            std::pop_heap(sink->pendingRequests.begin(), sink->pendingRequests.end(), RequestOrder());
+            request = std::move(sink->pendingRequests.back());
+            sink->pendingRequests.pop_back();
+            if (!TakeCreditLocked(*sink, request)) {
+                sink->parkedRequests.push_back(std::move(request));
+                continue;
+            }
+            SplitBulkRequestLocked(*sink, request);
+            // Responses go out in the order the requests are taken, which is already priority order
+            request.sendTicket = sink->nextSendTicket++;
+            if (request.requestId != 0) {
+                sink->servingRequests.insert(request.requestId);
+            }
+            sink->servingCount++;
+            taskCond_.notify_all();
+        }
+        int64_t sentLength = ResponseFileRequest(*sink, request);
+        FinishSendTurn(*sink, request.sendTicket);
+        std::lock_guard<std::mutex> lock(taskLock_);
+        ReturnCreditLocked(*sink, request, sentLength);
+        auto serving = sink->servingRequests.find(request.requestId);
+        if (serving != sink->servingRequests.end()) {
+            sink->servingRequests.erase(serving);
+        }
+        if (sink->servingRequests.count(request.requestId) == 0) {
+            sink->cancelledRequests.erase(request.requestId);
+        }
+        sink->servingCount--;
+        // A sink below its share again may be picked by a waiting worker
+        taskCond_.notify_all();
+    }
+    CLOGD("out");
+}
+
+bool CastLocalFileChannelServer::WaitSendTurn(Sink &sink, const FileRequest &request)
+{
+    std::unique_lock<std::mutex> lock(taskLock_);
+    uint64_t ticket = request.sendTicket;
+    sendCond_.wait(lock, [this, &sink, ticket] {
+        return (sink.sendingTicket == ticket && !sink.congested) || sink.removed || !isRunning_.load();
+    });
+    if (request.requestId != 0 && sink.cancelledRequests.count(request.requestId) != 0) {
+        CLOGD("drop cancelled request %{public}u", request.requestId);
+        return false;
+    }
+    return !sink.removed && isRunning_.load();
+}
+
+void CastLocalFileChannelServer::FinishSendTurn(Sink &sink, uint64_t ticket)
+{
+    std::unique_lock<std::mutex> lock(taskLock_);
+    // A request that failed before sending still has to wait for its turn to hand it on
+    sendCond_.wait(lock, [this, &sink, ticket] {
+        return sink.sendingTicket == ticket || sink.removed || !isRunning_.load();
+    });
+    if (sink.sendingTicket == ticket) {
+        sink.sendingTicket++;
+    }
+    sendCond_.notify_all();
+}
+
+bool CastLocalFileChannelServer::ParseHttpFileRequest(const uint8_t *buffer, int length, FileRequest &request)
+{
+    // Valid and Parse http header
+    HttpRequestHeader httpRequest;
+    if (!ParseHttpRequest(buffer, length, httpRequest)) {
+        CLOGE("Invalid http header");
+        return false;
+    }
+
+    // Get request param and valid. URI/Range is checked in ParseHttpRequest
+    if (httpRequest.method != "GET") {
+        CLOGE("Not support request method %{public}.*s", static_cast<int>(httpRequest.method.size()),
+            httpRequest.method.data());
+        return false;
+    }
+
+    request.start = httpRequest.rangeStart;
+    request.end = httpRequest.rangeEnd;
+    request.uri = FindSharedFileId(httpRequest.uri);
+    request.priority = httpRequest.priority;
+    request.acceptBinaryFrame = (httpRequest.framing == BINARY_FRAMING_VERSION);
+    return true;
+}
+
+bool CastLocalFileChannelServer::ParseBinaryFileRequest(const BinaryFrame &frame, FileRequest &request)
+{
+    if (frame.type != FRAME_TYPE_REQUEST && frame.type != FRAME_TYPE_BULK_REQUEST) {
+        CLOGE("Invalid binary request type %{public}u", frame.type);
+        return false;
+    }
+    if (frame.type == FRAME_TYPE_BULK_REQUEST && frame.length <= 0) {
+        CLOGE("Invalid bulk request length %{public}" PRId64, frame.length);
+        return false;
+    }
+    if (frame.offset <= INVALID_END_POS || frame.length < 0) {
+        CLOGE("Invalid request param, offset:%{public}" PRId64 ", length: %{public}" PRId64, frame.offset,
+            frame.length);
+        return false;
+    }
+
+    request.uri = FindSharedFileId(frame.fileId);
+    request.start = frame.offset;
+    // Same range convention as the http request, length 0 means up to the end of file
+    request.end = (frame.length == 0) ? 0 : frame.offset + frame.length;
+    request.requestId = frame.requestId;
+    request.priority = frame.status;
+    request.binaryFrame = true;
+    request.bulk = (frame.type == FRAME_TYPE_BULK_REQUEST);
+    return true;
+}
+
+std::string CastLocalFileChannelServer::MakeResponseHeader(const FileRequest &request, int64_t start, int64_t end,
+    int64_t fileLen)
+{
+    if (request.binaryFrame) {
+        BinaryFrame frame;
+        frame.type = FRAME_TYPE_RESPONSE;
+        frame.status = FRAME_STATUS_OK;
+        frame.requestId = request.requestId;
+        frame.offset = start;
+        frame.length = end - start;
+        frame.total = fileLen;
+        frame.fileId = *request.uri;
+        std::string header(GetBinaryFrameHeaderLength(frame), '\0');
+        if (!EncodeBinaryFrame(frame, reinterpret_cast<uint8_t *>(&header[0]), header.size())) {
+            return "";
+        }
+        return header;
+    }
+
+    std::string rsp("HTTP/1.1 200 OK\r\n"
+        "Accept-Ranges: bytes\r\n"
+        "Content-Length: ");
+    rsp.append(std::to_string(end - start) + "\r\n");
+    rsp.append("Content-Range: bytes " + std::to_string(start) + "-" + std::to_string(end) + "/" +
+        std::to_string(fileLen) + "\r\n");
+    if (request.acceptBinaryFrame) {
+        rsp.append(HTTP_FRAMING_HEADER + ": " + BINARY_FRAMING_VERSION + "\r\n");
+    }
+    rsp.append("Content-Disposition: attachment; filename=" + *request.uri + "\r\n\r\n");
+    return rsp;
 }
 
 struct CastLocalFileChannelServer::LocalFileInfo CastLocalFileChannelServer::FindLocalFileInfo(
@@ -219,6 +649,17 @@ int64_t CastLocalFileChannelServer::GetFileLengthByFd(int fd)
     return ret;
 }
 
+std::string CastLocalFileChannelServer::GetFileVersionByFd(int fd)
+{
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) < 0) {
+        CLOGE("file stat fail, errno %{public}s", strerror(errno));
+        return "";
+    }
+    return "@" + std::to_string(fileStat.st_dev) + ":" + std::to_string(fileStat.st_ino) + ":" +
+        std::to_string(fileStat.st_mtim.tv_sec) + "." + std::to_string(fileStat.st_mtim.tv_nsec);
+}
+
 int64_t CastLocalFileChannelServer::GetFileLengthByFileName(const std::string &file)
 {
     struct stat filestatus;
@@ -229,6 +670,22 @@ int64_t CastLocalFileChannelServer::GetFileLengthByFileName(const std::string &f
     return filestatus.st_size;
 }
 
+/*
+ * The id shared by the registered file, or a copy of the given one for a file that is not registered, whose
+ * request is only answered as not found.
+ */
+std::shared_ptr<const std::string> CastLocalFileChannelServer::FindSharedFileId(std::string_view encodedUri)
+{
+    {
+        std::lock_guard<std::mutex> lock(mapLock_);
+        auto it = fileMap_.find(encodedUri);
+        if (it != fileMap_.end() && it->second.sharedId) {
+            return it->second.sharedId;
+        }
+    }
+    return std::make_shared<const std::string>(encodedUri);
+}
+
 int64_t CastLocalFileChannelServer::FindFileLengthByUri(const std::string &encodeUri)
 {
     std::lock_guard<std::mutex> lock(mapLock_);
@@ -239,25 +696,27 @@ int64_t CastLocalFileChannelServer::FindFileLengthByUri(const std::string &encod
     return (it->second).fileLen;
 }
 
-void CastLocalFileChannelServer::ResponseFileLengthRequest(const std::string &uri, int64_t fileLen)
+void CastLocalFileChannelServer::ResponseFileLengthRequest(Sink &sink, const FileRequest &request,
+    int64_t fileLen)
 {
-    if (fileLen <= 0 || !channel_) {
+    if (fileLen <= 0) {
         return;
     }
 
-    std::string rsp("HTTP/1.1 200 OK\r\n"
-        "Accept-Ranges: bytes\r\n"
-        "Content-Length: 0\r\n"
-        "Content-Range: bytes ");
-    rsp.append(std::to_string(0) + "-" + std::to_string(0) + "/" + std::to_string(fileLen) + "\r\n");
-    rsp.append("Content-Disposition: attachment; filename=" + uri + "\r\n\r\n");
+    std::string rsp = MakeResponseHeader(request, 0, 0, fileLen);
+    if (rsp.empty()) {
+        return;
+    }
 
     CLOGI("filelen %{public}" PRId64, fileLen);
 
     // Not support data encrypt yet
     int len = static_cast<int>(rsp.size());
 
-    SendData(reinterpret_cast<uint8_t *>(const_cast<char *>(rsp.data())), len);
+    if (!WaitSendTurn(sink, request)) {
+        return;
+    }
+    SendData(sink, reinterpret_cast<uint8_t *>(const_cast<char *>(rsp.data())), len);
 }
 
 int CastLocalFileChannelServer::ReadFileData(const struct LocalFileInfo &data, int64_t start, int64_t sendLen,
@@ -276,109 +735,287 @@ int CastLocalFileChannelServer::ReadFileData(const struct LocalFileInfo &data, i
     return readLen;
 }
 
-void CastLocalFileChannelServer::ResponseFileDataRequest(const std::string &uri, int64_t fileLen, int64_t start,
-    int64_t end)
+int64_t CastLocalFileChannelServer::ResponseFileDataRequest(Sink &sink, const FileRequest &request, int64_t fileLen)
 {
-    int64_t newEnd = end;
+    int64_t start = request.start;
+    int64_t newEnd = request.end;
     // If end is not in the request
-    if (newEnd <= 0 || !channel_) {
+    if (newEnd <= 0) {
         newEnd = fileLen;
     }
     newEnd = std::min(fileLen, std::min(newEnd, start + MAX_READ_LEN));
     if (newEnd <= start) {
         CLOGE("Invalid pos %{public}" PRId64 "-%{public}" PRId64, newEnd, start);
-        return;
+        return 0;
     }
 
     int sendLen = static_cast<int>(std::max(static_cast<int64_t>(0), newEnd - start));
 
     // Make response header
-    std::string rsp("HTTP/1.1 200 OK\r\n"
-        "Accept-Ranges: bytes\r\n"
-        "Content-Length: ");
-    rsp.append(std::to_string(sendLen) + "\r\n");
-    rsp.append("Content-Range: bytes " + std::to_string(start) + "-" + std::to_string(newEnd) + "/" +
-        std::to_string(fileLen) + "\r\n");
-    rsp.append("Content-Disposition: attachment; filename=" + uri + "\r\n\r\n");
+    std::string rsp = MakeResponseHeader(request, start, newEnd, fileLen);
+    if (rsp.empty()) {
+        return 0;
+    }
 
-    // Alloca response buffer
-    size_t offset = rsp.size();
-    std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(sendLen + offset);
+    // Don't read data that the client has already given up
+    if (IsRequestCancelled(sink, request.requestId)) {
+        CLOGD("skip cancelled request %{public}u", request.requestId);
+        return 0;
+    }
+    LocalFileInfo data = FindLocalFileInfo(*request.uri);
+    if (data.fd == INVALID_VALUE) {
+        CLOGE("Invalid file info");
+        return 0;
+    }
+    UpdateReadAhead(*request.uri, data.fd, start, newEnd, fileLen);
+    // With several sinks the data goes through the shared cache instead, so that each range is read once
+    bool fanOut = IsFanOut();
+    if (!fanOut && sink.sendFileAvailable.load()) {
+        // Start the disk read now, so the data is in the page cache when this response gets its turn
+        posix_fadvise(data.fd, start, sendLen, POSIX_FADV_WILLNEED);
+        if (!WaitSendTurn(sink, request)) {
+            return 0;
+        }
+        // Let the channel move the file data to the peer without reading it into user space
+        SendFileResult result = SendFileData(sink, rsp, data.fd, start, sendLen);
+        if (result == SendFileResult::SENT) {
+            CLOGD("send file out start:%{public}" PRId64 " len:%{public}d", start, sendLen);
+            return sendLen;
+        }
+        // Part of it may be out, sending it again would only follow a truncated packet on the broken channel
+        if (result == SendFileResult::FAILED) {
+            CLOGE("send file failed start:%{public}" PRId64 " len:%{public}d", start, sendLen);
+            return 0;
+        }
+        if (result == SendFileResult::UNSUPPORTED) {
+            sink.sendFileAvailable.store(false);
+        }
+    }
+
+    // Softbus still joins them into one packet, which has to stay within its limit
+    if (rsp.size() > HTTP_HEADER_RESERVE_LEN) {
+        CLOGE("response header too long %{public}zu", rsp.size());
+        return 0;
+    }
+    std::unique_ptr<uint8_t[]> buffer = AcquireBuffer();
     if (!buffer) {
         CLOGE("malloc buffer[%{public}d] fail", sendLen);
-        return;
-    }
-    // Copy http header to buffer
-    if (memcpy_s(buffer.get(), sendLen + offset, rsp.data(), rsp.size()) != EOK) {
-        CLOGE("memcpy_s fail");
-        return;
+        return 0;
     }
 
-    LocalFileInfo data = FindLocalFileInfo(uri);
-    uint8_t *ptr = buffer.get() + offset;
-    int readLen = ReadFileData(data, start, sendLen, ptr);
-    if (readLen > 0) {
-        // Send response
-        SendData(buffer.get(), sendLen + offset);
+    int readLen = ReadThroughCache(request, data, start, sendLen, buffer.get());
+    int64_t sentLength = 0;
+    if (readLen != sendLen) {
+        CLOGE("read file fail, start:%{public}" PRId64 " len:%{public}d read:%{public}d", start, sendLen, readLen);
+    } else if (WaitSendTurn(sink, request) && SendData(sink, rsp, buffer.get(), sendLen)) {
         CLOGD("send out start:%{public}" PRId64 " len:%{public}d", start, sendLen);
+        sentLength = sendLen;
     }
+    ReleaseBuffer(std::move(buffer));
+    return sentLength;
 }
 
-void CastLocalFileChannelServer::ResponseFileRequest(const std::string &uri, int64_t start, int64_t end)
+/*
+ * Follows the data requests of a file. Once they run sequential, the kernel is told to read the file
+ * sequentially and the range after them is hinted with WILLNEED, so the following requests find their data in
+ * the page cache. Works the same for a file read with SendFile, where no user space cache can help.
+ */
+void CastLocalFileChannelServer::UpdateReadAhead(const std::string &uri, int fd, int64_t start, int64_t end,
+    int64_t fileLen)
+{
+    int64_t adviseStart = 0;
+    int64_t adviseEnd = 0;
+    bool startSequential = false;
+    {
+        std::lock_guard<std::mutex> lock(readAheadLock_);
+        ReadPattern &pattern = readPatterns_[uri];
+        dataRequestCount_++;
+        if (end <= pattern.adviseEnd && start >= pattern.adviseEnd - READ_AHEAD_SIZE) {
+            readAheadHitCount_++;
+        }
+        if (start >= pattern.lastEnd - SEQUENTIAL_SLACK && start <= pattern.lastEnd + SEQUENTIAL_SLACK) {
+            pattern.sequentialCount++;
+            startSequential = (pattern.sequentialCount == SEQUENTIAL_THRESHOLD);
+        } else {
+            // A seek, whatever was hinted before is not what comes next
+            pattern.sequentialCount = 0;
+            pattern.adviseEnd = 0;
+        }
+        pattern.lastEnd = std::max(end, pattern.lastEnd - SEQUENTIAL_SLACK);
+        if (pattern.sequentialCount < SEQUENTIAL_THRESHOLD ||
+            end + READ_AHEAD_SIZE / 2 <= pattern.adviseEnd || end >= fileLen) {
+            return;
+        }
+        adviseStart = std::max(end, pattern.adviseEnd);
+        adviseEnd = std::min(fileLen, end + READ_AHEAD_SIZE);
+        pattern.adviseEnd = adviseEnd;
+    }
+    if (startSequential) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    if (adviseEnd > adviseStart) {
+        CLOGD("read ahead %{public}" PRId64 "-%{public}" PRId64, adviseStart, adviseEnd);
+        posix_fadvise(fd, adviseStart, adviseEnd - adviseStart, POSIX_FADV_WILLNEED);
+    }
+}
+
+int CastLocalFileChannelServer::ReadThroughCache(const FileRequest &request, const struct LocalFileInfo &data,
+    int64_t start, int sendLen, uint8_t *ptr)
 {
-    CLOGD("file: %s start: %{public}lld end: %{public}lld", uri.c_str(), start, end);
+    return readCache_.Read(*request.uri, data.fileLen, start, sendLen, ptr,
+        [this, &data](int64_t readStart, int readLength, uint8_t *readData) {
+            return ReadFileData(data, readStart, readLength, readData);
+        });
+}
 
-    if (uri.empty()) {
-        CLOGE("Invalid request, %{public}lld - %{public}lld", start, end);
-        return;
+void CastLocalFileChannelServer::GetReadStats(ReadStats &stats)
+{
+    {
+        std::lock_guard<std::mutex> lock(readAheadLock_);
+        stats.dataRequests = dataRequestCount_;
+        stats.readAheadHits = readAheadHitCount_;
+    }
+    readCache_.GetStats(stats.cacheHits, stats.cacheMisses);
+}
+
+// Returns the number of file data bytes sent
+int64_t CastLocalFileChannelServer::ResponseFileRequest(Sink &sink, const FileRequest &request)
+{
+    if (!request.uri || request.uri->empty()) {
+        CLOGE("Invalid request, %{public}lld - %{public}lld", request.start, request.end);
+        return 0;
     }
+    CLOGD("file: %s start: %{public}lld end: %{public}lld id: %{public}u", request.uri->c_str(), request.start,
+        request.end, request.requestId);
 
-    int64_t fileLen = FindFileLengthByUri(uri);
+    int64_t fileLen = FindFileLengthByUri(*request.uri);
     if (fileLen <= 0) {
-        CLOGE("Invalid file: %s, len %{public}lld", uri.c_str(), fileLen);
+        CLOGE("Invalid file: %s, len %{public}lld", request.uri->c_str(), fileLen);
+        ResponseFailure(sink, request, FRAME_STATUS_NOT_FOUND);
+        return 0;
+    }
+
+    if (request.start == 0 && request.end == 0) {
+        ResponseFileLengthRequest(sink, request, fileLen);
+        return 0;
+    }
+    int64_t sentLength = ResponseFileDataRequest(sink, request, fileLen);
+    if (sentLength == 0) {
+        ResponseFailure(sink, request, FRAME_STATUS_SERVER_ERROR);
+    }
+    return sentLength;
+}
+
+// Tells the sink at once that a binary request is not served, so that it doesn't wait for the data
+void CastLocalFileChannelServer::ResponseFailure(Sink &sink, const FileRequest &request, uint16_t status)
+{
+    if (!request.binaryFrame || !WaitSendTurn(sink, request)) {
         return;
     }
+    SendFailureFrame(sink, request, status);
+}
 
-    if (start == 0 && end == 0) {
-        ResponseFileLengthRequest(uri, fileLen);
-    } else {
-        ResponseFileDataRequest(uri, fileLen, start, end);
+// Only binary requests can be told they failed, an http request has no id to answer
+void CastLocalFileChannelServer::SendFailureFrame(Sink &sink, const FileRequest &request, uint16_t status)
+{
+    if (!request.binaryFrame) {
+        return;
     }
+    BinaryFrame frame;
+    frame.type = FRAME_TYPE_RESPONSE;
+    frame.status = status;
+    frame.requestId = request.requestId;
+    frame.offset = request.start;
+    frame.fileId = *request.uri;
+    std::vector<uint8_t> rsp(GetBinaryFrameHeaderLength(frame));
+    if (!EncodeBinaryFrame(frame, rsp.data(), rsp.size())) {
+        return;
+    }
+    CLOGW("request %{public}u failed, status %{public}u", request.requestId, status);
+    SendData(sink, rsp.data(), static_cast<int>(rsp.size()));
 }
 
-void CastLocalFileChannelServer::SendData(const uint8_t *buffer, int length)
+bool CastLocalFileChannelServer::SendData(Sink &sink, const uint8_t *buffer, int length)
 {
     if (!buffer || length <= 0) {
-        return;
+        return false;
+    }
+    if (!sink.channel) {
+        CLOGE("channel is not created.");
+        return false;
+    }
+
+    return sink.channel->Send(buffer, length);
+}
+
+// Sends the response header and the file data read into buffer as one packet, without joining them first
+bool CastLocalFileChannelServer::SendData(Sink &sink, const std::string &header, const uint8_t *buffer, int length)
+{
+    if (!buffer || length <= 0) {
+        return false;
+    }
+    if (!sink.channel) {
+        CLOGE("channel is not created.");
+        return false;
     }
-    std::shared_ptr<Channel> channel;
+
+    struct iovec iov[] = {
+        { const_cast<char *>(header.data()), header.size() },
+        { const_cast<uint8_t *>(buffer), static_cast<size_t>(length) },
+    };
+    return sink.channel->SendV(iov, sizeof(iov) / sizeof(iov[0]));
+}
+
+SendFileResult CastLocalFileChannelServer::SendFileData(Sink &sink, const std::string &header, int fd,
+    int64_t start, int length)
+{
+    if (!sink.channel) {
+        CLOGE("channel is not created.");
+        return SendFileResult::NOT_SENT;
+    }
+
+    return sink.channel->SendFile(reinterpret_cast<const uint8_t *>(header.data()), static_cast<int>(header.size()),
+        fd, start, length);
+}
+
+std::unique_ptr<uint8_t[]> CastLocalFileChannelServer::AcquireBuffer()
+{
     {
-        std::unique_lock<std::mutex> lock(chLock_);
-        if (!channel_) {
-            CLOGE("channel is not created.");
-            return;
+        std::lock_guard<std::mutex> lock(poolLock_);
+        if (!bufferPool_.empty()) {
+            std::unique_ptr<uint8_t[]> buffer = std::move(bufferPool_.back());
+            bufferPool_.pop_back();
+            return buffer;
         }
-        channel = channel_;
     }
-
-    channel->Send(buffer, length);
+    return std::make_unique<uint8_t[]>(MAX_READ_LEN);
 }
 
-int CastLocalFileChannelServer::ReadFileDataByFd(int fd, int64_t start, int sendLen, uint8_t *buffer)
+void CastLocalFileChannelServer::ReleaseBuffer(std::unique_ptr<uint8_t[]> buffer)
 {
-    // seek to start, read data
-    if (start != lseek64(fd, start, SEEK_SET)) {
-        CLOGE("lseek64 fail, start:%{public}" PRId64 " errno = %{public}s", start, strerror(errno));
-        return 0;
+    std::lock_guard<std::mutex> lock(poolLock_);
+    if (buffer && bufferPool_.size() < MAX_POOL_BUFFER_COUNT) {
+        bufferPool_.push_back(std::move(buffer));
     }
+}
 
-    int nread = 0;
+int CastLocalFileChannelServer::ReadFileDataByFd(int fd, int64_t start, int sendLen, uint8_t *buffer)
+{
+    // pread keeps the offset of the shared fd untouched, so ranges can be read concurrently
     int total = 0;
-    nread = read(fd, buffer + total, sendLen - total);
-    while (total < sendLen && nread > 0) {
-        total += nread;
-        nread = read(fd, buffer + total, sendLen - total);
-    };
+    while (total < sendLen) {
+        ssize_t nread = pread64(fd, buffer + total, sendLen - total, start + total);
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nread <= 0) {
+            if (nread < 0) {
+                CLOGE("pread64 fail, start:%{public}" PRId64 " errno = %{public}s", start + total, strerror(errno));
+            }
+            break;
+        }
+        total += static_cast<int>(nread);
+    }
 
     return total;
 }
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: persistent block cache of remote local files on the sink disk
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "disk_block_cache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <securec.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cast_engine_log.h"
+#include "utils.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+DEFINE_CAST_ENGINE_LABEL("Cast-DiskBlockCache");
+
+namespace {
+const std::string CACHE_DIRECTORY_NAME = "/local_file_cache";
+const std::string SEGMENT_SUFFIX = ".seg";
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+const uint8_t BLOCK_PRESENT = 1;
+const char FILE_VERSION_TAG = '@';
+const int HEX_WIDTH = 16;
+
+// Stable across builds, unlike std::hash, so the keys stay valid after an upgrade
+uint64_t HashString(const std::string &str)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (unsigned char c : str) {
+        hash = (hash ^ c) * FNV_PRIME;
+    }
+    return hash;
+}
+}
+
+DiskBlockCache &DiskBlockCache::GetInstance()
+{
+    static DiskBlockCache instance;
+    return instance;
+}
+
+DiskBlockCache::~DiskBlockCache()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!openSegments_.empty()) {
+        CloseSegmentLocked(openSegments_.begin()->first);
+    }
+}
+
+/*
+ * The file id carries the fd number the sender opened the file with, which changes every time the file is opened
+ * again. Only the file version after the last '@' (device, inode and modification time) is kept, so a file cast
+ * again hits the blocks of the earlier cast. Ids without a version get no key and are not cached on disk.
+ */
+std::string DiskBlockCache::MakeKey(const std::string &fileId, int64_t fileLength)
+{
+    std::string decoded;
+    if (!Utils::Base64Decode(fileId, decoded)) {
+        return "";
+    }
+    size_t versionPos = decoded.rfind(FILE_VERSION_TAG);
+    if (versionPos == std::string::npos || versionPos + 1 == decoded.size()) {
+        return "";
+    }
+    char hash[HEX_WIDTH + 1] = { 0 };
+    if (sprintf_s(hash, sizeof(hash), "%016" PRIx64, HashString(decoded.substr(versionPos))) < 0) {
+        return "";
+    }
+    return std::string(hash) + "_" + std::to_string(fileLength);
+}
+
+void DiskBlockCache::SetCapacity(int64_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = std::max<int64_t>(capacity, 0);
+    CLOGI("disk cache capacity %{public}" PRId64, capacity_);
+    if (!InitLocked()) {
+        return;
+    }
+    if (capacity_ == 0) {
+        PurgeLocked();
+        return;
+    }
+    ReserveLocked(0);
+}
+
+bool DiskBlockCache::IsEnabled()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return IsEnabledLocked();
+}
+
+bool DiskBlockCache::IsEnabledLocked()
+{
+    return capacity_ > 0 && InitLocked();
+}
+
+void DiskBlockCache::PurgeLocked()
+{
+    while (!openSegments_.empty()) {
+        CloseSegmentLocked(openSegments_.begin()->first);
+    }
+    for (const auto &name : lruList_) {
+        unlink(GetSegmentPath(name).c_str());
+    }
+    lruIndex_.clear();
+    lruList_.clear();
+}
+
+std::string DiskBlockCache::GetSegmentName(const std::string &key, int64_t index)
+{
+    return key + "_" + std::to_string(index / BLOCKS_PER_SEGMENT);
+}
+
+std::string DiskBlockCache::GetSegmentPath(const std::string &name) const
+{
+    return directory_ + "/" + name + SEGMENT_SUFFIX;
+}
+
+bool DiskBlockCache::InitLocked()
+{
+    if (initialized_) {
+        return scanned_;
+    }
+    initialized_ = true;
+    directory_ = std::string(SANDBOX_PATH) + CACHE_DIRECTORY_NAME;
+    if (mkdir(directory_.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+        CLOGE("mkdir failed, errno:%{public}s", strerror(errno));
+        return false;
+    }
+    DIR *dir = opendir(directory_.c_str());
+    if (dir == nullptr) {
+        CLOGE("opendir failed, errno:%{public}s", strerror(errno));
+        return false;
+    }
+    // Rebuild the use order of the segments left by a previous run
+    std::vector<std::pair<int64_t, std::string>> segments;
+    struct dirent *entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string fileName(entry->d_name);
+        if (fileName.size() <= SEGMENT_SUFFIX.size() ||
+            fileName.compare(fileName.size() - SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        struct stat fileStat{};
+        std::string path = directory_ + "/" + fileName;
+        if (stat(path.c_str(), &fileStat) != 0 || fileStat.st_size != SEGMENT_FILE_SIZE) {
+            unlink(path.c_str());
+            continue;
+        }
+        segments.emplace_back(static_cast<int64_t>(fileStat.st_mtime),
+            fileName.substr(0, fileName.size() - SEGMENT_SUFFIX.size()));
+    }
+    closedir(dir);
+    std::sort(segments.begin(), segments.end());
+    for (const auto &segment : segments) {
+        lruIndex_[segment.second] = lruList_.insert(lruList_.end(), segment.second);
+    }
+    CLOGI("disk cache has %{public}zu segments", lruList_.size());
+    scanned_ = true;
+    return true;
+}
+
+void DiskBlockCache::TouchLocked(const std::string &name)
+{
+    auto iter = lruIndex_.find(name);
+    if (iter != lruIndex_.end()) {
+        lruList_.splice(lruList_.end(), lruList_, iter->second);
+    }
+}
+
+bool DiskBlockCache::ReserveLocked(int64_t newSegments)
+{
+    auto overCapacity = [this, newSegments]() {
+        return (static_cast<int64_t>(lruList_.size()) + newSegments) * SEGMENT_FILE_SIZE > capacity_;
+    };
+    while (!lruList_.empty() && overCapacity()) {
+        std::string victim = lruList_.front();
+        CLOGD("evict segment %{public}s", victim.c_str());
+        CloseSegmentLocked(victim);
+        unlink(GetSegmentPath(victim).c_str());
+        lruIndex_.erase(victim);
+        lruList_.pop_front();
+    }
+    return !overCapacity();
+}
+
+DiskBlockCache::Segment *DiskBlockCache::OpenSegmentLocked(const std::string &name, bool create)
+{
+    auto opened = openSegments_.find(name);
+    if (opened != openSegments_.end()) {
+        TouchLocked(name);
+        return &opened->second;
+    }
+    bool exists = (lruIndex_.count(name) != 0);
+    if (!exists && (!create || !ReserveLocked(1))) {
+        return nullptr;
+    }
+    std::string path = GetSegmentPath(name);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        CLOGE("open segment failed, errno:%{public}s", strerror(errno));
+        return nullptr;
+    }
+    // A new segment stays sparse until its blocks are written
+    if ((!exists && ftruncate(fd, SEGMENT_FILE_SIZE) != 0) || futimens(fd, nullptr) != 0) {
+        CLOGE("prepare segment failed, errno:%{public}s", strerror(errno));
+        close(fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+    void *base = mmap(nullptr, SEGMENT_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        CLOGE("mmap segment failed, errno:%{public}s", strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    if (!exists) {
+        lruIndex_[name] = lruList_.insert(lruList_.end(), name);
+    }
+    TouchLocked(name);
+    while (openSegments_.size() >= MAX_OPEN_SEGMENTS && !openOrder_.empty()) {
+        CloseSegmentLocked(openOrder_.front());
+    }
+    openOrder_.push_back(name);
+    Segment &segment = openSegments_[name];
+    segment.fd = fd;
+    segment.base = static_cast<uint8_t *>(base);
+    return &segment;
+}
+
+void DiskBlockCache::CloseSegmentLocked(const std::string &name)
+{
+    auto iter = openSegments_.find(name);
+    if (iter == openSegments_.end()) {
+        return;
+    }
+    munmap(iter->second.base, SEGMENT_FILE_SIZE);
+    close(iter->second.fd);
+    // The name may be the key of the entry or an element of the list, so the list goes first on a copy
+    openOrder_.remove(std::string(name));
+    openSegments_.erase(iter);
+}
+
+bool DiskBlockCache::HasBlock(const std::string &key, int64_t index)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!IsEnabledLocked() || key.empty() || index < 0) {
+        return false;
+    }
+    Segment *segment = OpenSegmentLocked(GetSegmentName(key, index), false);
+    return segment != nullptr && segment->base[SEGMENT_DATA_SIZE + index % BLOCKS_PER_SEGMENT] == BLOCK_PRESENT;
+}
+
+bool DiskBlockCache::ReadBlock(const std::string &key, int64_t index, uint8_t *data, int64_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!IsEnabledLocked() || key.empty() || index < 0 || data == nullptr || length <= 0 || length > BLOCK_SIZE) {
+        return false;
+    }
+    Segment *segment = OpenSegmentLocked(GetSegmentName(key, index), false);
+    int64_t slot = index % BLOCKS_PER_SEGMENT;
+    if (segment == nullptr || segment->base[SEGMENT_DATA_SIZE + slot] != BLOCK_PRESENT) {
+        return false;
+    }
+    return memcpy_s(data, length, segment->base + slot * BLOCK_SIZE, length) == EOK;
+}
+
+void DiskBlockCache::WriteBlock(const std::string &key, int64_t index, const uint8_t *data, int64_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!IsEnabledLocked() || key.empty() || index < 0 || data == nullptr || length <= 0 || length > BLOCK_SIZE) {
+        return;
+    }
+    Segment *segment = OpenSegmentLocked(GetSegmentName(key, index), true);
+    if (segment == nullptr) {
+        return;
+    }
+    int64_t slot = index % BLOCKS_PER_SEGMENT;
+    if (segment->base[SEGMENT_DATA_SIZE + slot] == BLOCK_PRESENT) {
+        return;
+    }
+    uint8_t *block = segment->base + slot * BLOCK_SIZE;
+    if (memcpy_s(block, BLOCK_SIZE, data, length) != EOK) {
+        CLOGE("memcpy failed, index:%{public}" PRId64, index);
+        return;
+    }
+    // The data has to be on disk before its presence byte, or a crash in between serves stale data on restart.
+    // Blocks and the presence bytes start on page boundaries, as msync requires.
+    if (msync(block, static_cast<size_t>(length), MS_SYNC) != 0) {
+        CLOGE("msync block failed, errno:%{public}s", strerror(errno));
+        return;
+    }
+    segment->base[SEGMENT_DATA_SIZE + slot] = BLOCK_PRESENT;
+    if (msync(segment->base + SEGMENT_DATA_SIZE, BLOCKS_PER_SEGMENT, MS_ASYNC) != 0) {
+        CLOGE("msync presence failed, errno:%{public}s", strerror(errno));
+    }
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
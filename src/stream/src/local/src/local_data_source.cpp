@@ -17,9 +17,13 @@
  */
 
 #include "local_data_source.h"
+#include <algorithm>
+#include <chrono>
 #include <cinttypes>
 #include <securec.h>
+#include <thread>
 #include "cast_engine_log.h"
+#include "cast_local_file_channel_common.h"
 #include "media_errors.h"
 
 namespace OHOS {
@@ -27,9 +31,38 @@ namespace CastEngine {
 namespace CastEngineService {
 DEFINE_CAST_ENGINE_LABEL("Cast-LocalDataSource");
 
+static_assert(DiskBlockCache::BLOCK_SIZE == BlockCache::BLOCK_SIZE, "disk and memory cache blocks must match");
+
+namespace {
+const int64_t BOX_HEADER_SIZE = 8;
+const int64_t BOX_LARGE_HEADER_SIZE = 16;
+const int64_t BOX_TYPE_POS = 4;
+const uint64_t BOX_SIZE_LARGE = 1;
+const uint64_t BOX_SIZE_TO_END = 0;
+const uint32_t BOX_TYPE_FTYP = 0x66747970; // "ftyp"
+const uint32_t BOX_TYPE_MOOV = 0x6d6f6f76; // "moov"
+const unsigned int BITS_PER_BYTE = 8;
+
+int64_t GetNowMs()
+{
+    std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+
+uint64_t ReadBigEndian(const uint8_t *data, int64_t bytes)
+{
+    uint64_t value = 0;
+    for (int64_t i = 0; i < bytes; i++) {
+        value = (value << BITS_PER_BYTE) | data[i];
+    }
+    return value;
+}
+}
+
 LocalDataSource::~LocalDataSource()
 {
     CLOGD("destructor in");
+    StopWorker();
 }
 
 bool LocalDataSource::Start()
@@ -38,75 +71,405 @@ bool LocalDataSource::Start()
     if (!channelClient_) {
         return false;
     }
-    channelClient_->AddDataListener(shared_from_this());
+    {
+        std::lock_guard<std::mutex> lock(workMutex_);
+        if (!worker_.joinable()) {
+            workerStopped_ = false;
+            worker_ = std::thread(&LocalDataSource::WorkerLoop, this);
+        }
+    }
+    channelClient_->AddDataListener(fileId_, shared_from_this());
+    StartupPrefetch();
     return true;
 }
 
+void LocalDataSource::StartupPrefetch()
+{
+    if (!cache_ || !cache_->IsValid() || fileLength_ <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(requestMutex_);
+    probing_ = true;
+    probeOffset_ = 0;
+    probeBoxCount_ = 0;
+    // Head and tail go out together, so a trailing index costs no extra round trip
+    RequestRangeLocked(0, HEAD_PREFETCH_SIZE, false);
+    if (fileLength_ > HEAD_PREFETCH_SIZE + TAIL_PREFETCH_SIZE) {
+        RequestRangeLocked(fileLength_ - TAIL_PREFETCH_SIZE, TAIL_PREFETCH_SIZE, false);
+    }
+}
+
+/*
+ * Requests all of the file still missing in bulk, for a file read whole such as an image, so the server streams it
+ * without waiting for the reads. Returns false when the file is larger than the cache or the channel doesn't take
+ * bulk requests yet, the reads then fetch it piecewise as usual.
+ */
+bool LocalDataSource::RequestWholeFile(bool blocking)
+{
+    if (!cache_ || !cache_->IsValid() || fileLength_ <= 0 || fileLength_ > cache_->GetCapacity()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(requestMutex_);
+    int64_t spanStart = 0;
+    int64_t spanEnd = 0;
+    int64_t start;
+    int64_t end;
+    // Adjacent missing ranges go out as one request, data cached or in flight between them splits it
+    while (cache_->FindMissingRange(spanEnd, fileLength_ - spanEnd, start, end)) {
+        if (start != spanEnd) {
+            if (spanEnd > spanStart && !RequestBulkLocked(spanStart, spanEnd, blocking)) {
+                return false;
+            }
+            spanStart = start;
+        }
+        if (!cache_->MarkRequested(start, end, 0, fileLength_)) {
+            cache_->CancelRequested(spanStart, spanEnd);
+            return false;
+        }
+        spanEnd = end;
+    }
+    return spanEnd <= spanStart || RequestBulkLocked(spanStart, spanEnd, blocking);
+}
+
+bool LocalDataSource::RequestBulkLocked(int64_t start, int64_t end, bool blocking)
+{
+    uint32_t requestId = 0;
+    uint16_t priority = blocking ? REQUEST_PRIORITY_BLOCKING : REQUEST_PRIORITY_PREFETCH;
+    if (!channelClient_->RequestBulkData(start, end, fileId_, priority, requestId)) {
+        cache_->CancelRequested(start, end);
+        return false;
+    }
+    CLOGI("bulk request %{public}u, start:%{public}" PRId64 " end:%{public}" PRId64, requestId, start, end);
+    cache_->MarkCredited(start, end);
+    bulkRanges_.emplace_back(start, end);
+    return true;
+}
+
+/*
+ * Walks the top level boxes of an MP4/MOV file through the cached data to find the moov box, which the demuxer
+ * needs before the first frame. A box header that is not cached yet is requested and the walk goes on when it
+ * arrives, the whole moov box is requested once it is found.
+ */
+void LocalDataSource::ProbeContainer()
+{
+    std::lock_guard<std::mutex> lock(requestMutex_);
+    while (probing_ && probeOffset_ + BOX_HEADER_SIZE <= fileLength_ && probeBoxCount_ < MAX_PROBE_BOX_COUNT) {
+        uint8_t header[BOX_LARGE_HEADER_SIZE] = { 0 };
+        int64_t headerLength = std::min(BOX_LARGE_HEADER_SIZE, fileLength_ - probeOffset_);
+        int64_t readBytes = cache_->Read(header, static_cast<uint32_t>(headerLength), probeOffset_, 0);
+        uint64_t size = ReadBigEndian(header, BOX_TYPE_POS);
+        if (readBytes < BOX_HEADER_SIZE || (size == BOX_SIZE_LARGE && readBytes < BOX_LARGE_HEADER_SIZE)) {
+            RequestRangeLocked(probeOffset_, BlockCache::BLOCK_SIZE, false);
+            return;
+        }
+        uint32_t type = static_cast<uint32_t>(ReadBigEndian(header + BOX_TYPE_POS, BOX_TYPE_POS));
+        if (size == BOX_SIZE_LARGE) {
+            size = ReadBigEndian(header + BOX_HEADER_SIZE, BOX_HEADER_SIZE);
+        } else if (size == BOX_SIZE_TO_END) {
+            size = static_cast<uint64_t>(fileLength_ - probeOffset_);
+        }
+        if ((probeBoxCount_ == 0 && type != BOX_TYPE_FTYP) || size < static_cast<uint64_t>(BOX_HEADER_SIZE) ||
+            size > static_cast<uint64_t>(fileLength_ - probeOffset_)) {
+            CLOGD("not a mp4 file or broken box at %{public}" PRId64, probeOffset_);
+            probing_ = false;
+            return;
+        }
+        if (type == BOX_TYPE_MOOV) {
+            CLOGI("moov at %{public}" PRId64 " size %{public}" PRIu64, probeOffset_, size);
+            probing_ = false;
+            RequestRangeLocked(probeOffset_, static_cast<int64_t>(size), false);
+            return;
+        }
+        probeOffset_ += static_cast<int64_t>(size);
+        probeBoxCount_++;
+    }
+    probing_ = false;
+}
+
 bool LocalDataSource::Stop()
 {
     CLOGD("in");
     if (!channelClient_) {
         return false;
     }
-    channelClient_->RemoveDataListener(shared_from_this());
+    channelClient_->RemoveDataListener(fileId_, shared_from_this());
+    isStopped_.store(true);
+    StopWorker();
+    if (cache_) {
+        cache_->Abort();
+    }
+    PrefetchStats stats;
+    GetPrefetchStats(stats);
+    CLOGI("prefetch window:%{public}d sent:%{public}" PRIu64 " completed:%{public}" PRIu64 " expired:%{public}" PRIu64
+        " cancelled:%{public}" PRIu64 " failed:%{public}" PRIu64 " maxInFlight:%{public}d full:%{public}" PRIu64
+        " srtt:%{public}" PRId64 " throughput:%{public}" PRId64, stats.windowSize, stats.requestsSent,
+        stats.requestsCompleted, stats.requestsExpired, stats.requestsCancelled, stats.requestsFailed,
+        stats.maxInFlight, stats.windowFullCount, stats.smoothedRttMs, stats.throughputKBps);
+    CLOGI("seek count:%{public}" PRIu64 " last seek latency:%{public}" PRId64 " max:%{public}" PRId64
+        " disk cache hits:%{public}" PRIu64, stats.seekCount, stats.lastSeekLatencyMs, stats.maxSeekLatencyMs,
+        stats.diskCacheHits);
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    CLOGI("reads:%{public}" PRIu64 " hits:%{public}" PRIu64 " misses:%{public}" PRIu64 " timeouts:%{public}" PRIu64
+        " consumed:%{public}" PRIu64 " fetched:%{public}" PRIu64 " wait total:%{public}" PRId64 " max:%{public}" PRId64,
+        readStats_.reads, readStats_.cacheHits, readStats_.cacheMisses, readStats_.timeouts, readStats_.bytesConsumed,
+        readStats_.bytesFetched, readStats_.waitTime.totalMs, readStats_.waitTime.maxMs);
+    prefetchWindow_.Reset();
     return true;
 }
 
-std::shared_ptr<Cache> LocalDataSource::GetBestCache(int64_t pos)
+void LocalDataSource::GetPrefetchStats(PrefetchStats &stats)
+{
+    prefetchWindow_.GetStats(stats);
+    std::lock_guard<std::mutex> lock(requestMutex_);
+    stats.seekCount = seekCount_;
+    stats.lastSeekLatencyMs = lastSeekLatencyMs_;
+    stats.maxSeekLatencyMs = maxSeekLatencyMs_;
+    stats.diskCacheHits = diskCacheHits_;
+}
+
+void LocalDataSource::GetStats(DataSourceStats &stats)
+{
+    stats.fileLength = fileLength_;
+    GetPrefetchStats(stats.prefetch);
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats.read = readStats_;
+}
+
+void LocalDataSource::UpdateReadStats(bool hit, int64_t waitTimeMs, int32_t readBytes, bool timedOut)
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    readStats_.reads++;
+    if (hit) {
+        readStats_.cacheHits++;
+    } else {
+        readStats_.cacheMisses++;
+        readStats_.waitTime.Add(waitTimeMs);
+    }
+    if (timedOut) {
+        readStats_.timeouts++;
+    }
+    if (readBytes > 0) {
+        readStats_.bytesConsumed += static_cast<uint64_t>(readBytes);
+    }
+}
+
+bool LocalDataSource::LoadFromDiskCache(int64_t start, int64_t protectStart, int64_t protectEnd)
+{
+    if (diskCacheKey_.empty()) {
+        return false;
+    }
+    if (!diskBuffer_) {
+        diskBuffer_ = std::make_unique<uint8_t[]>(BlockCache::BLOCK_SIZE);
+    }
+    int64_t index = start / BlockCache::BLOCK_SIZE;
+    int64_t blockStart = index * BlockCache::BLOCK_SIZE;
+    int64_t blockEnd = std::min(blockStart + BlockCache::BLOCK_SIZE, fileLength_);
+    if (!DiskBlockCache::GetInstance().ReadBlock(diskCacheKey_, index, diskBuffer_.get(), blockEnd - blockStart)) {
+        return false;
+    }
+    if (!cache_->MarkRequested(start, blockEnd, protectStart, protectEnd)) {
+        return false;
+    }
+    diskCacheHits_++;
+    return cache_->Write(diskBuffer_.get() + (start - blockStart), start, blockEnd - start);
+}
+
+int64_t LocalDataSource::TrimToDiskCache(int64_t start, int64_t end)
 {
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    // get hit cache
-    for (auto iter = lruCache_.begin(); iter != lruCache_.end(); iter++) {
-        if ((*iter)->IsMatch(pos)) {
-            return *iter;
+    if (diskCacheKey_.empty()) {
+        return end;
+    }
+    // Don't fetch over the channel what the disk cache has after the start
+    for (int64_t index = start / BlockCache::BLOCK_SIZE + 1; index * BlockCache::BLOCK_SIZE < end; index++) {
+        if (DiskBlockCache::GetInstance().HasBlock(diskCacheKey_, index)) {
+            return index * BlockCache::BLOCK_SIZE;
         }
     }
-    std::shared_ptr<Cache> cache;
-    // cache limit not reached, create a new cache
-    if (lruCache_.size() < MAX_CACHE_COUNT) {
-        cache = std::make_shared<Cache>(pos);
-        if (!cache || !cache->IsValid()) {
-            CLOGE("malloc failed");
-            return nullptr;
+    return end;
+}
+
+/*
+ * Hands what follows the arrival of data to the worker: saving the blocks it completed to the disk cache, which
+ * syncs them to disk, and probing the container, which takes requestMutex_ and sends requests.
+ * The blocks are copied from the received bytes, the memory cache may hand them straight to a reader or evict them.
+ */
+void LocalDataSource::QueueReceivedWork(const uint8_t *bytes, int64_t offset, int64_t length)
+{
+    bool probe = probing_.load();
+    if (diskCacheKey_.empty() && !probe) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(workMutex_);
+    if (workerStopped_ || !worker_.joinable()) {
+        return;
+    }
+    if (!diskCacheKey_.empty()) {
+        // Only blocks wholly carried by this response are saved, the disk cache keeps complete blocks
+        int64_t end = offset + length;
+        for (int64_t index = (offset + BlockCache::BLOCK_SIZE - 1) / BlockCache::BLOCK_SIZE;
+            index * BlockCache::BLOCK_SIZE < end; index++) {
+            int64_t blockEnd = std::min((index + 1) * BlockCache::BLOCK_SIZE, fileLength_);
+            if (blockEnd > end) {
+                break;
+            }
+            if (pendingDiskBlocks_.size() >= MAX_PENDING_DISK_BLOCKS) {
+                CLOGD("disk cache behind, block %{public}" PRId64 " not saved", index);
+                continue;
+            }
+            PendingDiskBlock block;
+            block.index = index;
+            block.length = blockEnd - index * BlockCache::BLOCK_SIZE;
+            if (freeDiskBlockBuffers_.empty()) {
+                block.data = std::make_unique<uint8_t[]>(BlockCache::BLOCK_SIZE);
+            } else {
+                block.data = std::move(freeDiskBlockBuffers_.back());
+                freeDiskBlockBuffers_.pop_back();
+            }
+            if (memcpy_s(block.data.get(), BlockCache::BLOCK_SIZE, bytes + (index * BlockCache::BLOCK_SIZE - offset),
+                static_cast<size_t>(block.length)) != EOK) {
+                freeDiskBlockBuffers_.push_back(std::move(block.data));
+                continue;
+            }
+            pendingDiskBlocks_.push_back(std::move(block));
         }
-        lruCache_.push_back(cache);
-        return cache;
     }
-    // cache limit reached, get the oldest used cache for reuse
-    for (auto iter = lruCache_.begin(); iter != lruCache_.end(); iter++) {
-        if (!cache || cache->GetUsedTime() > (*iter)->GetUsedTime()) {
-            cache = *iter;
+    probePending_ = probePending_ || probe;
+    workCond_.notify_one();
+}
+
+void LocalDataSource::WorkerLoop()
+{
+    while (true) {
+        PendingDiskBlock block;
+        bool probe = false;
+        {
+            std::unique_lock<std::mutex> lock(workMutex_);
+            workCond_.wait(lock, [this] { return workerStopped_ || probePending_ || !pendingDiskBlocks_.empty(); });
+            if (workerStopped_) {
+                return;
+            }
+            probe = probePending_;
+            probePending_ = false;
+            if (!pendingDiskBlocks_.empty()) {
+                block = std::move(pendingDiskBlocks_.front());
+                pendingDiskBlocks_.pop_front();
+            }
+        }
+        // The probe goes first, the demuxer waits for the index it finds before the first frame
+        if (probe) {
+            ProbeContainer();
+        }
+        if (block.data) {
+            DiskBlockCache::GetInstance().WriteBlock(diskCacheKey_, block.index, block.data.get(), block.length);
+            std::lock_guard<std::mutex> lock(workMutex_);
+            freeDiskBlockBuffers_.push_back(std::move(block.data));
         }
     }
-    CLOGD("GetBestCache:reset:%{public}" PRId64, pos);
-    cache->Reset(pos);
-    return cache;
 }
 
-void LocalDataSource::SolveReqData(std::shared_ptr<Cache> cache, int64_t pos)
+// Blocks still waiting to be saved are dropped, they are fetched again on a replay
+void LocalDataSource::StopWorker()
 {
-    int64_t start;
-    int64_t end;
-    int isNeedReq = cache->IsNeedReqData(start, end);
-    if (isNeedReq == Cache::NO_NEED_REQ) {
+    {
+        std::lock_guard<std::mutex> lock(workMutex_);
+        workerStopped_ = true;
+        pendingDiskBlocks_.clear();
+        probePending_ = false;
+        workCond_.notify_all();
+    }
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void LocalDataSource::CancelObsoleteRequests(int64_t start, int64_t end)
+{
+    std::vector<PrefetchRequest> requests;
+    prefetchWindow_.TakeRequestsOutside(start, end, requests);
+    for (const auto &request : requests) {
+        CLOGD("cancel request %{public}u, start:%{public}" PRId64 " end:%{public}" PRId64, request.requestId,
+            request.start, request.end);
+        channelClient_->CancelRequest(request.requestId, fileId_);
+        cache_->CancelRequested(request.start, request.end);
+    }
+}
+
+void LocalDataSource::OnSeekDataRead()
+{
+    std::lock_guard<std::mutex> lock(requestMutex_);
+    if (seekStartTimeMs_ == 0) {
         return;
     }
-    if (isNeedReq == Cache::NEED_REQ_IN_NEXT_CACHE) {
-        cache = GetBestCache(start);
-        if (!cache) {
+    lastSeekLatencyMs_ = GetNowMs() - seekStartTimeMs_;
+    maxSeekLatencyMs_ = std::max(maxSeekLatencyMs_, lastSeekLatencyMs_);
+    seekStartTimeMs_ = 0;
+    CLOGI("seek to first byte %{public}" PRId64 " ms", lastSeekLatencyMs_);
+}
+
+void LocalDataSource::SolveReqData(int64_t pos, bool blocking)
+{
+    std::lock_guard<std::mutex> lock(requestMutex_);
+    int64_t aheadLimit = std::max(static_cast<int64_t>(PAUSE_REQUEST_WATER_LINE),
+        prefetchWindow_.GetAheadLimit(BlockCache::SINGLE_REQUEST_MAX_SIZE));
+    RequestRangeLocked(pos, aheadLimit, blocking);
+}
+
+// Only what the read needs, without read-ahead, so the player's data ahead stays in the cache
+void LocalDataSource::SolveSecondaryReqData(int64_t pos, uint32_t length)
+{
+    std::lock_guard<std::mutex> lock(requestMutex_);
+    RequestRangeLocked(pos, static_cast<int64_t>(length), false);
+}
+
+void LocalDataSource::RequestRangeLocked(int64_t pos, int64_t aheadLimit, bool blocking)
+{
+    // Keep requesting until the window is full or enough data is requested ahead of the reading position
+    int requests = 0;
+    bool firstRange = true;
+    while (requests <= PrefetchWindow::MAX_WINDOW_SIZE) {
+        int64_t start;
+        int64_t end;
+        if (!cache_->FindMissingRange(pos, aheadLimit, start, end)) {
             return;
         }
-        if (cache->IsNeedReqData(start, end) != Cache::NEED_REQ_IN_CURR_CACHE) {
+        if (LoadFromDiskCache(start, pos, pos + aheadLimit)) {
+            firstRange = false;
+            continue;
+        }
+        if (firstRange && blocking && start <= pos) {
+            // Nothing cached or requested under a waiting read, the player has seeked. Ranges left behind only
+            // delay the data it waits for now.
+            seekCount_++;
+            seekStartTimeMs_ = GetNowMs();
+            CancelObsoleteRequests(pos, pos + aheadLimit);
+        }
+        firstRange = false;
+        end = TrimToDiskCache(start, end);
+        if (!prefetchWindow_.CanRequest()) {
             return;
         }
+        if (!cache_->MarkRequested(start, end, pos, pos + aheadLimit)) {
+            return;
+        }
+        CLOGD("request data, start:%{public}" PRId64 " end:%{public}" PRId64 " pos:%{public}" PRId64, start, end, pos);
+        // Only the range under a waiting read is urgent, the rest is prefetch
+        uint16_t priority = (blocking && start <= pos) ? REQUEST_PRIORITY_BLOCKING : REQUEST_PRIORITY_PREFETCH;
+        uint32_t requestId = 0;
+        if (!channelClient_->RequestByteData(start, end, fileId_, priority, requestId)) {
+            cache_->CancelRequested(start, end);
+            return;
+        }
+        if (requestId != 0) {
+            cache_->MarkCredited(start, end);
+        }
+        prefetchWindow_.OnRequestSent(start, end, requestId);
+        requests++;
     }
-    CLOGD("request data, start:%{public}" PRId64 " end:%{public}" PRId64 " pos:%{public}" PRId64, start, end, pos);
-    channelClient_->RequestByteData(start, end, fileId_);
 }
 
 int32_t LocalDataSource::ReadAt(const std::shared_ptr<Media::AVSharedMemory> &mem, uint32_t length, int64_t pos)
 {
-    return ReadBuffer(mem->GetBase(), length, pos);
+    return ReadBuffer(mem->GetBase(), length, pos, DEFAULT_READ_TIMEOUT_MS);
 }
 
 int32_t LocalDataSource::ReadAt(int64_t pos, uint32_t length, const std::shared_ptr<Media::AVSharedMemory> &mem)
@@ -119,9 +482,19 @@ int32_t LocalDataSource::ReadAt(uint32_t length, const std::shared_ptr<Media::AV
     return ReadAt(mem, length);
 }
 
-int32_t LocalDataSource::ReadBuffer(uint8_t *data, uint32_t length, int64_t pos)
+int32_t LocalDataSource::ReadBuffer(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs)
+{
+    return DoReadBuffer(data, length, pos, timeoutMs, true);
+}
+
+int32_t LocalDataSource::ReadSecondary(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs)
+{
+    return DoReadBuffer(data, length, pos, timeoutMs, false);
+}
+
+int32_t LocalDataSource::DoReadBuffer(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs, bool primary)
 {
-    CLOGD("ReadBuffer length = %{public}d pos = %{public}lld", length, pos);
+    CLOGD("ReadBuffer length = %{public}d pos = %{public}lld primary = %{public}d", length, pos, primary);
     if (pos >= fileLength_) {
         CLOGE("ReadAt EOF, pos:%{public}" PRId64 " fileLength_:%{public}" PRId64, pos, fileLength_);
         return Media::SOURCE_ERROR_EOF;
@@ -131,18 +504,59 @@ int32_t LocalDataSource::ReadBuffer(uint8_t *data, uint32_t length, int64_t pos)
         return Media::SOURCE_ERROR_IO;
     }
 
-    auto cache = GetBestCache(pos);
-    if (!cache) {
+    if (!cache_ || !cache_->IsValid()) {
         return Media::SOURCE_ERROR_IO;
     }
-    // The cache may be a new that has no data, need req data before reading
-    SolveReqData(cache, pos);
-    int32_t readBytes = static_cast<int32_t>(cache->Read(data, length, pos));
+    int64_t startTimeMs = GetNowMs();
+    int64_t deadline = startTimeMs + timeoutMs;
+    bool hit = cache_->IsCached(pos);
+    int32_t readBytes = 0;
+    while (!isStopped_.load()) {
+        // The block may be a new that has no data, need req data before reading
+        if (primary) {
+            SolveReqData(pos, true);
+        } else {
+            SolveSecondaryReqData(pos, length);
+        }
+        int64_t waitTimeMs = std::min(deadline - GetNowMs(), READ_RECHECK_INTERVAL_MS);
+        readBytes = static_cast<int32_t>(cache_->Read(data, length, pos,
+            std::max(waitTimeMs, static_cast<int64_t>(0))));
+        if (readBytes > 0 || GetNowMs() >= deadline) {
+            break;
+        }
+    }
+    // The read stats, the seek latency and the read-ahead follow the player only
+    if (!primary) {
+        return readBytes;
+    }
+    int64_t nowMs = GetNowMs();
+    UpdateReadStats(hit, nowMs - startTimeMs, readBytes, readBytes <= 0 && nowMs >= deadline);
+    if (readBytes > 0) {
+        OnSeekDataRead();
+    }
     // cache data may be not enoungh after reading, req data in advance for next reading
-    SolveReqData(cache, pos);
+    SolveReqData(pos + readBytes, false);
     return readBytes;
 }
 
+int32_t LocalDataSource::ReadBufferFully(uint8_t *data, uint32_t length, int64_t pos, int64_t timeoutMs)
+{
+    int64_t deadline = GetNowMs() + timeoutMs;
+    uint32_t sumReadBytes = 0;
+    while (sumReadBytes < length && !isStopped_.load()) {
+        int64_t remainingMs = deadline - GetNowMs();
+        if (remainingMs <= 0) {
+            break;
+        }
+        int32_t readBytes = ReadBuffer(data + sumReadBytes, length - sumReadBytes, pos + sumReadBytes, remainingMs);
+        if (readBytes < 0) {
+            return (sumReadBytes > 0) ? static_cast<int32_t>(sumReadBytes) : readBytes;
+        }
+        sumReadBytes += static_cast<uint32_t>(readBytes);
+    }
+    return static_cast<int32_t>(sumReadBytes);
+}
+
 int32_t LocalDataSource::GetSize(int64_t &size)
 {
     if (fileLength_ > 0) {
@@ -155,182 +569,71 @@ int32_t LocalDataSource::GetSize(int64_t &size)
     return Media::MSERR_OK;
 }
 
-bool LocalDataSource::OnBytesReceived(const std::string &fileId, const uint8_t *bytes, int64_t offset, int64_t length)
+bool LocalDataSource::OnBytesReceived(std::string_view fileId, const uint8_t *bytes, int64_t offset, int64_t length)
 {
-    if (fileId.compare(fileId_) != 0) {
-        CLOGE("fileId:%{public}s is not match fileId_:%{public}s", fileId.c_str(), fileId_.c_str());
+    if (fileId != fileId_) {
+        CLOGE("fileId:%{public}.*s is not match fileId_:%{public}s", static_cast<int>(fileId.size()), fileId.data(),
+            fileId_.c_str());
         return false;
     }
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    for (auto iter = lruCache_.begin(); iter != lruCache_.end(); iter++) {
-        if ((*iter)->Write(bytes, offset, length)) {
-            return true;
-        }
-    }
-    CLOGE("OnBytesReceived out, not process");
-    return false;
-}
-
-Cache::Cache(int64_t pos, int64_t capacity)
-{
-    CLOGD("Cache in");
-    if (capacity > MAX_BUFFER_SIZE || capacity <= 0) {
-        capacity = MAX_BUFFER_SIZE;
-    }
-    buffer_ = std::make_unique<uint8_t[]>(capacity);
-    if (!buffer_) {
-        CLOGE("buffer malloc failed");
-        return;
+    prefetchWindow_.OnDataArrived(offset, length);
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        readStats_.bytesFetched += static_cast<uint64_t>(length);
     }
-    capacity_ = capacity;
-    Init(pos);
-}
-
-Cache::~Cache()
-{
-    CLOGD("~Cache in");
-    buffer_.reset();
-    capacity_ = 0;
-    startPos_ = 0;
-    currPos_ = 0;
-    endPos_ = 0;
-    nextEndPos_ = 0;
-}
-
-void Cache::Reset(int64_t pos)
-{
-    Init(pos);
-}
-
-bool Cache::IsMatch(int64_t pos)
-{
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    if (pos < startPos_ || pos >= nextEndPos_) {
+    if (!cache_ || !cache_->Write(bytes, offset, length)) {
+        CLOGE("OnBytesReceived out, not process");
         return false;
     }
-    UpdateUsedTimeLocked();
+    QueueReceivedWork(bytes, offset, length);
     return true;
 }
 
-bool Cache::IsValid()
-{
-    return (buffer_ != nullptr);
-}
-
-int Cache::IsNeedReqData(int64_t &start, int64_t &end)
+void LocalDataSource::OnRequestFailed(std::string_view fileId, int64_t offset)
 {
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    int64_t cachedBytes = endPos_ - startPos_;
-    // 1.already requested  2.curr cached buffer is enough
-    if (nextEndPos_ != endPos_ || (endPos_ - currPos_) >= PAUSE_REQUEST_WATER_LINE) {
-        return NO_NEED_REQ;
+    if (fileId != fileId_ || !cache_) {
+        return;
     }
-    // buffer cached complete, < should not actually happen, it is just for protection
-    if (capacity_ <= cachedBytes) {
-        start = endPos_;
-        return NEED_REQ_IN_NEXT_CACHE;
+    PrefetchRequest request;
+    int64_t end = 0;
+    if (prefetchWindow_.OnRequestFailed(offset, request)) {
+        end = request.end;
+    } else {
+        // A part of a bulk request, whatever of it comes later is still written when it arrives
+        std::lock_guard<std::mutex> lock(requestMutex_);
+        for (const auto &range : bulkRanges_) {
+            if (offset >= range.first && offset < range.second) {
+                end = range.second;
+                break;
+            }
+        }
     }
-    int64_t length =
-        (capacity_ - cachedBytes) > SINGLE_REQUEST_MAX_SIZE ? SINGLE_REQUEST_MAX_SIZE : (capacity_ - cachedBytes);
-    if (startPos_ == endPos_) {
-        length = FIRST_REQUEST_SIZE;
+    if (end <= offset) {
+        return;
     }
-    start = endPos_;
-    end = endPos_ + length;
-    nextEndPos_ = end;
-    std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now().time_since_epoch();
-    lastRequestTime_ = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
-    return NEED_REQ_IN_CURR_CACHE;
+    CLOGW("request failed, start:%{public}" PRId64 " end:%{public}" PRId64, offset, end);
+    // Missing again, a waiting read requests it at once
+    cache_->CancelRequested(offset, end);
 }
 
-int64_t Cache::GetUsedTime()
+int32_t SecondaryDataSource::ReadAt(const std::shared_ptr<Media::AVSharedMemory> &mem, uint32_t length, int64_t pos)
 {
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    return lastUsedTime_;
+    return source_->ReadSecondary(mem->GetBase(), length, pos);
 }
 
-void Cache::Init(int64_t pos)
+int32_t SecondaryDataSource::ReadAt(int64_t pos, uint32_t length, const std::shared_ptr<Media::AVSharedMemory> &mem)
 {
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    startPos_ = pos;
-    currPos_ = pos;
-    endPos_ = pos;
-    nextEndPos_ = pos;
-    UpdateUsedTimeLocked();
+    return ReadAt(mem, length, pos);
 }
 
-void Cache::UpdateUsedTimeLocked()
+int32_t SecondaryDataSource::ReadAt(uint32_t length, const std::shared_ptr<Media::AVSharedMemory> &mem)
 {
-    std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now().time_since_epoch();
-    lastUsedTime_ = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
-}
-
-int64_t Cache::Read(uint8_t *data, uint32_t length, int64_t pos)
-{
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    if (data == nullptr || buffer_ == nullptr || length == 0) {
-        CLOGE("data/buffer_ is null or length is 0");
-        return 0;
-    }
-    if (pos >= nextEndPos_ || pos < startPos_) {
-        CLOGE("has no expected data pos:%{public}" PRId64 " startPos_:%{public}" PRId64 " nextEndPos_:%{public}" PRId64,
-            pos, startPos_, nextEndPos_);
-        return 0;
-    }
-    UpdateUsedTimeLocked();
-    if (pos >= endPos_) {
-        // data req has send to server, wait for server rsp, timeout 100ms
-        dataCond_.wait_for(lock, std::chrono::milliseconds(WAIT_DATA_TIME_OUT_MS));
-        if (pos >= endPos_) {
-            CLOGE("wait for data from server timeout pos:%{public}" PRId64 " endPos_:%{public}" PRId64, pos, endPos_);
-            std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now().time_since_epoch();
-            int64_t now = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
-            if (now > lastRequestTime_ && (now - lastRequestTime_) >= REQUEST_RETRY_TIME_INTERVAL_MS) {
-                nextEndPos_ = endPos_; // need Re-request data
-            }
-            return 0;
-        }
-    }
-    int64_t readBytes = length > (endPos_ - pos) ? (endPos_ - pos) : length;
-    errno_t ret = memcpy_s(data, readBytes, buffer_.get() + (pos - startPos_), readBytes);
-    if (ret != EOK) {
-        CLOGE("memcpy failed ret:%{public}d readBytes:%{public}" PRId64 " pos:%{public}" PRId64
-            " startPos_:%{public}" PRId64,
-            ret, readBytes, pos, startPos_);
-        return 0;
-    }
-    currPos_ = pos;
-    dataCond_.notify_all();
-    return readBytes;
+    return ReadAt(mem, length);
 }
 
-bool Cache::Write(const uint8_t *data, int64_t offset, int64_t length)
+int32_t SecondaryDataSource::GetSize(int64_t &size)
 {
-    std::unique_lock<std::mutex> lock(dataMutex_);
-    if (offset != endPos_) {
-        return false;
-    }
-    int64_t remainLen = capacity_ - (endPos_ - startPos_);
-    if (remainLen <= 0 || length <= 0 || buffer_ == nullptr || data == nullptr) {
-        CLOGE("remainLen/length is 0 or buffer/data is null");
-        return false;
-    }
-    int64_t writeBytes = length > remainLen ? remainLen : length;
-    errno_t ret = memcpy_s(buffer_.get() + endPos_ - startPos_, writeBytes, data, writeBytes);
-    if (ret != EOK) {
-        CLOGE("memcpy failed ret = %{public}d, writeBytes:%{public}" PRId64 " startPos_:%{public}" PRId64
-            " endPos_:%{public}" PRId64,
-            ret, writeBytes, startPos_, endPos_);
-        nextEndPos_ = endPos_; // need Re-request
-        return false;
-    }
-    endPos_ += writeBytes;
-    nextEndPos_ = endPos_;
-    CLOGD("writeBytes:%{public}" PRId64 " length:%{public}" PRId64 " startPos_:%{public}" PRId64
-        " endPos_:%{public}" PRId64,
-        writeBytes, length, startPos_, endPos_);
-    dataCond_.notify_all();
-    return true;
+    return source_->GetSize(size);
 }
 } // namespace CastEngineService
 } // namespace CastEngine
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: sliding window of in-flight range requests for local data source
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "prefetch_window.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include "cast_engine_log.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+DEFINE_CAST_ENGINE_LABEL("Cast-PrefetchWindow");
+
+namespace {
+int64_t GetNowMs()
+{
+    std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+}
+
+bool PrefetchWindow::CanRequest()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ExpireLocked(GetNowMs());
+    if (static_cast<int32_t>(inFlight_.size()) < windowSize_) {
+        return true;
+    }
+    stats_.windowFullCount++;
+    return false;
+}
+
+void PrefetchWindow::OnRequestSent(int64_t start, int64_t end, uint32_t requestId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.inFlightSampleSum += inFlight_.size();
+    auto old = inFlightByStart_.find(start);
+    if (old != inFlightByStart_.end()) {
+        // Asked again, the response answers the latest request
+        EraseLocked(old->second);
+    }
+    // Only a request sent with the binary framing has an id, and those are sent under credit
+    inFlightByStart_[start] = inFlight_.insert(inFlight_.end(), { start, end, requestId, GetNowMs(), requestId != 0 });
+    lastRequestSize_ = end - start;
+    stats_.requestsSent++;
+    stats_.inFlight = static_cast<int32_t>(inFlight_.size());
+    stats_.maxInFlight = std::max(stats_.maxInFlight, stats_.inFlight);
+}
+
+void PrefetchWindow::OnDataArrived(int64_t offset, int64_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = GetNowMs();
+    auto found = inFlightByStart_.find(offset);
+    if (found == inFlightByStart_.end()) {
+        // Not a response to a tracked request, drop everything it covers
+        int64_t end = offset + length;
+        for (auto it = inFlight_.begin(); it != inFlight_.end();) {
+            auto next = std::next(it);
+            if (it->start >= offset && it->end <= end) {
+                EraseLocked(it);
+            }
+            it = next;
+        }
+        stats_.inFlight = static_cast<int32_t>(inFlight_.size());
+        return;
+    }
+    auto iter = found->second;
+    int64_t rttMs = now - iter->sendTimeMs;
+    int64_t sendTimeMs = iter->sendTimeMs;
+    EraseLocked(iter);
+    stats_.requestsCompleted++;
+    stats_.requestRtt.Add(rttMs);
+    stats_.inFlight = static_cast<int32_t>(inFlight_.size());
+    AdjustWindowLocked(rttMs, length, std::max(sendTimeMs, lastCompleteTimeMs_));
+    lastCompleteTimeMs_ = now;
+}
+
+bool PrefetchWindow::OnRequestFailed(int64_t offset, PrefetchRequest &request)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = inFlightByStart_.find(offset);
+    if (found == inFlightByStart_.end()) {
+        return false;
+    }
+    auto iter = found->second;
+    request = { iter->start, iter->end, iter->requestId };
+    EraseLocked(iter);
+    stats_.requestsFailed++;
+    stats_.inFlight = static_cast<int32_t>(inFlight_.size());
+    return true;
+}
+
+void PrefetchWindow::TakeRequestsOutside(int64_t start, int64_t end, std::vector<PrefetchRequest> &requests)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Requests overlapping [start, end) are still useful and stay in flight
+    for (auto it = inFlight_.begin(); it != inFlight_.end();) {
+        auto next = std::next(it);
+        if (it->end <= start || it->start >= end) {
+            requests.push_back({ it->start, it->end, it->requestId });
+            stats_.requestsCancelled++;
+            EraseLocked(it);
+        }
+        it = next;
+    }
+    stats_.inFlight = static_cast<int32_t>(inFlight_.size());
+}
+
+void PrefetchWindow::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    inFlight_.clear();
+    inFlightByStart_.clear();
+    stats_.inFlight = 0;
+    lastCompleteTimeMs_ = 0;
+}
+
+int32_t PrefetchWindow::GetWindowSize()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return windowSize_;
+}
+
+int64_t PrefetchWindow::GetAheadLimit(int64_t requestSize)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return windowSize_ * requestSize;
+}
+
+void PrefetchWindow::GetStats(PrefetchStats &stats)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats = stats_;
+    stats.windowSize = windowSize_;
+}
+
+void PrefetchWindow::ExpireLocked(int64_t now)
+{
+    // Requests lost by the channel are re-requested by the cache after the same interval
+    for (auto it = inFlight_.begin(); it != inFlight_.end();) {
+        auto next = std::next(it);
+        int64_t expireTimeMs = it->credited ? CREDITED_EXPIRE_TIME_MS : REQUEST_EXPIRE_TIME_MS;
+        if (now - it->sendTimeMs >= expireTimeMs) {
+            CLOGW("request expired, start:%{public}" PRId64 " end:%{public}" PRId64, it->start, it->end);
+            EraseLocked(it);
+            stats_.requestsExpired++;
+        }
+        it = next;
+    }
+    stats_.inFlight = static_cast<int32_t>(inFlight_.size());
+}
+
+void PrefetchWindow::EraseLocked(std::list<InFlightRequest>::iterator iter)
+{
+    auto indexed = inFlightByStart_.find(iter->start);
+    if (indexed != inFlightByStart_.end() && indexed->second == iter) {
+        inFlightByStart_.erase(indexed);
+    }
+    inFlight_.erase(iter);
+}
+
+void PrefetchWindow::AdjustWindowLocked(int64_t rttMs, int64_t bytes, int64_t intervalStart)
+{
+    int64_t now = GetNowMs();
+    rttMs = std::max(rttMs, static_cast<int64_t>(1));
+    stats_.smoothedRttMs = (stats_.smoothedRttMs == 0) ? rttMs :
+        stats_.smoothedRttMs + (rttMs - stats_.smoothedRttMs) / RTT_SMOOTH_FACTOR;
+    stats_.minRttMs = (stats_.minRttMs == 0) ? rttMs : std::min(stats_.minRttMs, rttMs);
+
+    // Throughput is measured over the time the link was busy delivering this response
+    int64_t busyMs = std::max(now - intervalStart, static_cast<int64_t>(1));
+    int64_t throughput = bytes / busyMs;
+    stats_.throughputKBps = (stats_.throughputKBps == 0) ? throughput :
+        stats_.throughputKBps + (throughput - stats_.throughputKBps) / RTT_SMOOTH_FACTOR;
+
+    int32_t oldWindowSize = windowSize_;
+    if (stats_.smoothedRttMs > stats_.minRttMs * RTT_QUEUEING_FACTOR + RTT_QUEUEING_MARGIN_MS) {
+        // Requests only wait in the source queue, more of them won't bring data earlier
+        windowSize_ = std::max(windowSize_ - 1, MIN_WINDOW_SIZE);
+    } else if (lastRequestSize_ > 0) {
+        // Window needed to cover one bandwidth-delay product, plus one request to keep the pipe busy
+        int64_t bdpBytes = stats_.minRttMs * stats_.throughputKBps;
+        int32_t target = static_cast<int32_t>((bdpBytes + lastRequestSize_ - 1) / lastRequestSize_) + 1;
+        target = std::clamp(target, MIN_WINDOW_SIZE, MAX_WINDOW_SIZE);
+        if (windowSize_ < target && inFlight_.empty()) {
+            windowSize_++;
+        } else if (windowSize_ > target) {
+            windowSize_--;
+        }
+    }
+    if (oldWindowSize != windowSize_) {
+        CLOGD("window %{public}d -> %{public}d, srtt:%{public}" PRId64 " minRtt:%{public}" PRId64
+            " throughput:%{public}" PRId64, oldWindowSize, windowSize_, stats_.smoothedRttMs, stats_.minRttMs,
+            stats_.throughputKBps);
+    }
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: block cache shared by the sinks of one local file channel server
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "shared_read_cache.h"
+#include <algorithm>
+#include <cinttypes>
+#include <securec.h>
+#include "cast_engine_log.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+DEFINE_CAST_ENGINE_LABEL("Cast-SharedReadCache");
+
+int SharedReadCache::Read(const std::string &fileId, int64_t fileLength, int64_t offset, int length, uint8_t *data,
+    const FileReader &reader)
+{
+    if (data == nullptr || offset < 0 || length <= 0 || offset >= fileLength) {
+        return 0;
+    }
+    int64_t end = std::min(fileLength, offset + length);
+    int64_t pos = offset;
+    while (pos < end) {
+        int64_t index = pos / BLOCK_SIZE;
+        int64_t blockStart = index * BLOCK_SIZE;
+        int64_t blockLength = std::min(BLOCK_SIZE, fileLength - blockStart);
+        // A block wholly inside the response can be read into it without passing through the cache
+        uint8_t *direct = (blockStart == pos && blockStart + blockLength <= end) ? data + (pos - offset) : nullptr;
+        bool delivered = false;
+        std::shared_ptr<Block> block = AcquireBlock({ fileId, index }, blockLength, reader, direct, delivered);
+        if (delivered) {
+            pos += blockLength;
+            continue;
+        }
+        if (!block) {
+            break;
+        }
+        int64_t blockOffset = pos - blockStart;
+        int64_t copyLength = std::min(end - pos, block->length - blockOffset);
+        if (copyLength <= 0 || memcpy_s(data + (pos - offset), end - pos, block->data.get() + blockOffset,
+            copyLength) != EOK) {
+            break;
+        }
+        pos += copyLength;
+    }
+    return static_cast<int>(pos - offset);
+}
+
+/*
+ * Returns the cached block, or sets delivered when the block was read into direct instead. A block is read into
+ * direct only when it is not cached and was not read lately, a block read twice is worth the copy into the cache.
+ */
+std::shared_ptr<SharedReadCache::Block> SharedReadCache::AcquireBlock(const BlockKey &key, int64_t length,
+    const FileReader &reader, uint8_t *direct, bool &delivered)
+{
+    std::shared_ptr<Block> block;
+    bool readDirect = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto iter = blocks_.find(key);
+        if (iter != blocks_.end()) {
+            block = iter->second;
+            lruList_.splice(lruList_.end(), lruList_, block->lruIter);
+            hitCount_++;
+            // Another request is reading this block from disk, take its result
+            block->waiters++;
+            loadCond_.wait(lock, [&block] { return !block->loading; });
+            block->waiters--;
+            return block->failed ? nullptr : block;
+        }
+        missCount_++;
+        auto recent = recentKeys_.find(key);
+        if (recent != recentKeys_.end()) {
+            recentKeys_.erase(recent);
+            recentList_.remove(key);
+        } else {
+            readDirect = (direct != nullptr);
+        }
+        block = std::make_shared<Block>();
+        block->length = length;
+        block->lruIter = lruList_.insert(lruList_.end(), key);
+        blocks_[key] = block;
+        usedSize_ += block->length;
+        EvictLocked();
+    }
+
+    if (readDirect) {
+        int readLength = reader(key.second * BLOCK_SIZE, static_cast<int>(block->length), direct);
+        delivered = FinishDirectRead(key, block, direct, readLength);
+        return nullptr;
+    }
+    // Not zeroed, the read fills it
+    block->data = std::unique_ptr<uint8_t[]>(new (std::nothrow) uint8_t[block->length]);
+    int readLength = block->data ? reader(key.second * BLOCK_SIZE, static_cast<int>(block->length),
+        block->data.get()) : 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    block->loading = false;
+    block->failed = (readLength != block->length);
+    if (block->failed) {
+        CLOGE("read block %{public}" PRId64 " failed, read:%{public}d", key.second, readLength);
+        RemoveBlockLocked(key, block);
+    }
+    loadCond_.notify_all();
+    return block->failed ? nullptr : block;
+}
+
+// Publishes a block read into a response, it is cached only for the requests that wait for it
+bool SharedReadCache::FinishDirectRead(const BlockKey &key, std::shared_ptr<Block> block, const uint8_t *direct,
+    int readLength)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    block->loading = false;
+    bool delivered = (readLength == block->length);
+    if (!delivered) {
+        CLOGE("read block %{public}" PRId64 " failed, read:%{public}d", key.second, readLength);
+    }
+    if (delivered && block->waiters > 0) {
+        block->data = std::unique_ptr<uint8_t[]>(new (std::nothrow) uint8_t[block->length]);
+        block->failed = (block->data == nullptr ||
+            memcpy_s(block->data.get(), block->length, direct, block->length) != EOK);
+    } else {
+        block->failed = true;
+    }
+    if (block->failed) {
+        RemoveBlockLocked(key, block);
+        if (delivered) {
+            RememberLocked(key);
+        }
+    }
+    loadCond_.notify_all();
+    return delivered;
+}
+
+void SharedReadCache::RemoveBlockLocked(const BlockKey &key, const std::shared_ptr<Block> &block)
+{
+    auto iter = blocks_.find(key);
+    if (iter != blocks_.end() && iter->second == block) {
+        usedSize_ -= block->length;
+        lruList_.erase(block->lruIter);
+        blocks_.erase(iter);
+    }
+}
+
+// As many keys as the cache has blocks are remembered
+void SharedReadCache::RememberLocked(const BlockKey &key)
+{
+    if (!recentKeys_.insert(key).second) {
+        return;
+    }
+    recentList_.push_back(key);
+    while (static_cast<int64_t>(recentList_.size()) * BLOCK_SIZE > capacity_ && !recentList_.empty()) {
+        recentKeys_.erase(recentList_.front());
+        recentList_.pop_front();
+    }
+}
+
+void SharedReadCache::EvictLocked()
+{
+    auto iter = lruList_.begin();
+    while (usedSize_ > capacity_ && iter != lruList_.end()) {
+        auto block = blocks_.find(*iter);
+        // A block being read stays until its readers have it, the readers keep it alive after eviction anyway
+        if (block == blocks_.end() || block->second->loading) {
+            ++iter;
+            continue;
+        }
+        usedSize_ -= block->second->length;
+        blocks_.erase(block);
+        iter = lruList_.erase(iter);
+    }
+}
+
+void SharedReadCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (hitCount_ != 0 || missCount_ != 0) {
+        CLOGI("shared cache hits:%{public}" PRIu64 " misses:%{public}" PRIu64, hitCount_, missCount_);
+    }
+    // Blocks being read are kept, their readers still look them up when done
+    for (auto iter = lruList_.begin(); iter != lruList_.end();) {
+        auto block = blocks_.find(*iter);
+        if (block != blocks_.end() && block->second->loading) {
+            ++iter;
+            continue;
+        }
+        if (block != blocks_.end()) {
+            usedSize_ -= block->second->length;
+            blocks_.erase(block);
+        }
+        iter = lruList_.erase(iter);
+    }
+    recentList_.clear();
+    recentKeys_.clear();
+}
+
+void SharedReadCache::GetStats(uint64_t &hitCount, uint64_t &missCount)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    hitCount = hitCount_;
+    missCount = missCount_;
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
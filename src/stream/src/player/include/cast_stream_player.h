@@ -22,6 +22,7 @@
 #include <map>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 #include "media_errors.h"
 #include "audio_system_manager.h"
 #include "avmetadatahelper.h"
@@ -35,6 +36,7 @@
 #include "local_data_source.h"
 #include "cast_local_file_channel_client.h"
 #include "cast_timer.h"
+#include "image_decode_cache.h"
 
 namespace OHOS {
 namespace CastEngine {
@@ -81,6 +83,7 @@ private:
     void OnEndOfStream(int isLooping);
     void SetState(PlayerStates state);
     void CheckPosInfo(int curPos);
+    void CheckPrefetchPoint(int curPos, int duration);
     void HandleInterruptEvent(const Media::Format &infoBody);
     PlaybackSpeed ConvertMediaSpeedToPlaybackSpeed(Media::PlaybackRateMode speedMode);
     sptr<IStreamPlayerListenerImpl> ListenerGetter();
@@ -100,6 +103,8 @@ private:
     int endPosition_ = CAST_STREAM_INT_INIT;
     Media::PlaybackRateMode speedMode_ = Media::SPEED_FORWARD_1_00_X;
     std::atomic<bool> isRequestingResource_{ false };
+    bool isNextItemPrefetched_ = false;
+    static constexpr int NEXT_ITEM_PREFETCH_LEAD_MS = 10000;
 };
 
 class CastStreamVolumeCallback : public AudioStandard::VolumeKeyEventCallback,
@@ -126,6 +131,10 @@ public:
     bool RegisterListener(sptr<IStreamPlayerListenerImpl> listener);
     bool UnregisterListener();
     bool SetSource(const MediaInfo &mediaInfo);
+    bool PrefetchSource(const MediaInfo &mediaInfo);
+    void PrefetchNextItem();
+    void SetNextItem(const MediaInfo &mediaInfo);
+    void ClearNextItem();
     bool Prepare();
     bool PrepareAsync();
     bool Play();
@@ -154,21 +163,63 @@ public:
     bool IsPlaying();
     bool IsLooping();
     void NotifyPlayComplete();
+    void SetImageCache(std::shared_ptr<ImageDecodeCache> imageCache);
+    bool GetStreamingStats(DataSourceStats &stats);
 
 private:
     bool SeekPrepare(int32_t &mseconds, Media::PlayerSeekMode &mode);
     bool Release();
     bool SendInitSysVolume();
     bool GetImageResource();
-    bool ProcessAlbumCover(std::shared_ptr<Media::AVSharedMemory> albumCoverMem);
+    bool ShowCachedImage(const MediaInfo &mediaInfo, std::shared_ptr<LocalDataSource> prefetched);
+    bool ProcessAlbumCover(std::shared_ptr<Media::AVSharedMemory> albumCoverMem, uint64_t seq);
+    void RequestAlbumCover(std::shared_ptr<LocalDataSource> dataSource);
+    void CancelAlbumCover();
+    void StopAlbumCoverThread();
+    void AlbumCoverLoop();
+    std::shared_ptr<LocalDataSource> TakePrefetchedSource(const MediaInfo &mediaInfo);
+    void KeepForReplay(std::shared_ptr<LocalDataSource> dataSource, const MediaInfo &mediaInfo);
+    void StopPrefetchedSource();
+    void PostPrefetch(const MediaInfo &mediaInfo);
+    void StopPrefetchThread();
+    void PrefetchLoop();
+    std::shared_ptr<LocalDataSource> GetDataSource();
+    std::shared_ptr<LocalDataSource> SwapDataSource(std::shared_ptr<LocalDataSource> dataSource);
+
     std::mutex mutex_;
+    std::mutex prefetchMutex_;
     std::shared_ptr<Media::Player> player_ = nullptr;
     std::shared_ptr<Media::AVMetadataHelper> avMetadataHelper_ = nullptr;
     std::shared_ptr<CastStreamPlayerCallback> callback_ = nullptr;
     std::shared_ptr<CastStreamVolumeCallback> castStreamVolumeCallback_ = nullptr;
+    // Set on the thread of the player calls, read from the callback threads of the player too
+    std::mutex dataSourceMutex_;
     std::shared_ptr<LocalDataSource> dataSource_;
+    MediaInfo currentMediaInfo_;
+    // Source of the item expected to play next, already warming over the file channel
+    std::shared_ptr<LocalDataSource> nextDataSource_;
+    std::string nextMediaUrl_;
+    int64_t nextMediaSize_ = 0;
+    // Item after the current one in the playlist, opened once the current item reaches its closing credits
+    bool hasNextItem_ = false;
+    MediaInfo nextItem_;
+    // The next item is opened on its own thread, guarded by prefetchMutex_ like the item itself
+    std::condition_variable prefetchCond_;
+    std::thread prefetchThread_;
+    bool prefetchStopped_ = false;
+    bool hasPendingPrefetch_ = false;
+    MediaInfo pendingPrefetch_;
     std::shared_ptr<CastLocalFileChannelClient> fileChannelClient_;
+    // Decoded images shared with the decode-ahead of the player manager
+    std::shared_ptr<ImageDecodeCache> imageCache_;
     AudioStandard::AudioSystemManager *audioSystemMgr_ = nullptr;
+    // Album covers are extracted on their own thread, a cover finished after its item changed is dropped
+    std::mutex albumCoverMutex_;
+    std::condition_variable albumCoverCond_;
+    std::thread albumCoverThread_;
+    bool albumCoverStopped_ = false;
+    std::shared_ptr<LocalDataSource> albumCoverSource_;
+    uint64_t albumCoverSeq_ = 0;
     LoopMode loopMode_ = LoopMode::LOOP_MODE_LIST;
 };
 } // namespace CastEngineService
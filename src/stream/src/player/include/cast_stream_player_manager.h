@@ -24,6 +24,7 @@
 #include "i_stream_player_listener_impl.h"
 #include "i_cast_stream_manager_server.h"
 #include "cast_local_file_channel_client.h"
+#include "image_decode_cache.h"
 
 namespace OHOS {
 namespace CastEngine {
@@ -36,12 +37,15 @@ public:
     ~CastStreamPlayerManager() override;
 
     void SetSessionCallbackForRelease(const std::function<void(void)>& callback);
+    void SetDiskCacheCapacity(int64_t capacity);
     int32_t RegisterListener(sptr<IStreamPlayerListenerImpl> listener) override;
     int32_t UnregisterListener() override;
     int32_t SetSurface(sptr<IBufferProducer> producer) override;
     int32_t Load(const MediaInfo &mediaInfo) override;
     int32_t Play(const MediaInfo &mediaInfo) override;
     int32_t InnerPlay(const MediaInfo &mediaInfo);
+    void SetPlaylist(const std::vector<MediaInfo> &mediaInfoList, size_t currentIndex);
+    int32_t GetStreamingStats(DataSourceStats &stats);
     int32_t Play(int index) override;
     int32_t Play() override;
     int32_t Pause() override;
@@ -68,13 +72,19 @@ public:
 private:
     bool InnerPlayLocked(bool isLoading);
     bool StopLocked();
+    bool IsImageCached(const MediaInfo &mediaInfo);
     PlaybackSpeed ConvertMediaSpeedToPlaybackSpeed(Media::PlaybackRateMode speedMode);
     std::function<void(void)> sessionCallback_;
 
+    // Images of the list decoded after and before the current one
+    static constexpr size_t DECODE_AHEAD_COUNT = 2;
+    static constexpr size_t DECODE_BEHIND_COUNT = 1;
+
     std::mutex mutex_;
     std::mutex sessionCallbackMutex_;
     std::shared_ptr<CastStreamPlayer> player_;
     std::shared_ptr<CastStreamPlayerCallback> callback_;
+    std::shared_ptr<ImageDecodeCache> imageCache_;
     MediaInfo mediaInfo_{};
     std::atomic<bool> isReceiveLoadCommand_{ false };
     std::atomic<bool> isReceivePlayCommand_{ false };
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: decoded images of a slideshow, decoded ahead of their turn
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#ifndef IMAGE_DECODE_CACHE_H
+#define IMAGE_DECODE_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pixel_map.h"
+#include "cast_engine_common.h"
+#include "cast_stream_common.h"
+#include "cast_local_file_channel_client.h"
+#include "local_data_source.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+/*
+ * Keeps the decoded images last shown or about to be shown, the least recently used leaves first once the decoded
+ * size goes over the capacity. Images to come are fetched and decoded one at a time on a worker thread, behind the
+ * blocking reads of the current item.
+ */
+class ImageDecodeCache final {
+public:
+    ImageDecodeCache(std::shared_ptr<CastLocalFileChannelClient> fileChannel, int64_t capacity = DEFAULT_CAPACITY);
+    ~ImageDecodeCache();
+
+    // Replaces the images waiting to be decoded, the one being decoded goes on
+    void DecodeAhead(const std::vector<MediaInfo> &mediaInfos);
+    // Returns the decoded image or null, waits for it when it is being decoded right now
+    std::shared_ptr<Media::PixelMap> Get(const MediaInfo &mediaInfo);
+    // Whether the image is decoded or being decoded
+    bool Contains(const MediaInfo &mediaInfo);
+    void Put(const MediaInfo &mediaInfo, std::shared_ptr<Media::PixelMap> pixelMap);
+    void Clear();
+
+    // Decodes the image while it streams in, null if it cannot be read or decoded
+    static std::shared_ptr<Media::PixelMap> Decode(std::shared_ptr<LocalDataSource> dataSource, bool blocking);
+
+    static constexpr int64_t DEFAULT_CAPACITY = 128 * 1024 * 1024; // 128MB, about three 12MP photos
+    // Image data is handed to the decoder in pieces of one cache block as it arrives
+    static constexpr int64_t IMAGE_CHUNK_SIZE = BlockCache::BLOCK_SIZE;
+    // Reading an image fails when no data arrives for this long
+    static constexpr int64_t IMAGE_STALL_TIMEOUT_MS = static_cast<int64_t>(CAST_STREAM_MAX_TIMES) *
+        CAST_STREAM_WAIT_TIME;
+
+private:
+    struct Entry {
+        std::shared_ptr<Media::PixelMap> pixelMap;
+        int64_t size = 0;
+        std::list<std::string>::iterator lruIter;
+    };
+
+    static std::string MakeKey(const MediaInfo &mediaInfo);
+    void WorkerLoop();
+    void DecodeOne(const MediaInfo &mediaInfo);
+    void PutLocked(const std::string &key, std::shared_ptr<Media::PixelMap> pixelMap);
+    void EvictLocked();
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread worker_;
+    bool stopped_ = false;
+    std::shared_ptr<CastLocalFileChannelClient> fileChannelClient_;
+    std::deque<MediaInfo> pending_;
+    // Key and source of the image the worker decodes, the source is stopped to abort it
+    std::string decodingKey_;
+    std::shared_ptr<LocalDataSource> decodingSource_;
+    int64_t capacity_;
+    int64_t usedSize_ = 0;
+    std::map<std::string, Entry> entries_;
+    // The least recently used image first
+    std::list<std::string> lruList_;
+    uint64_t hitCount_ = 0;
+    uint64_t missCount_ = 0;
+};
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
+
+#endif // IMAGE_DECODE_CACHE_H
@@ -16,7 +16,9 @@
  * Create: 2023-1-11
  */
 
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <unistd.h>
 #include "image_source.h"
 #include "cast_engine_dfx.h"
@@ -164,6 +166,7 @@ void CastStreamPlayerCallback::SetPosInfo(int startPos, int endPos)
     CLOGD("SetInitPosInfo in, startPos: %{public}d, endPos: %{public}d", startPos, endPos);
     std::lock_guard<std::mutex> lock(posMutex_);
     isRequestingResource_ = false;
+    isNextItemPrefetched_ = false;
     if (endPos > startPos) {
         endPosition_ = endPos;
     } else {
@@ -181,6 +184,26 @@ void CastStreamPlayerCallback::CheckPosInfo(int curPos)
     }
 }
 
+void CastStreamPlayerCallback::CheckPrefetchPoint(int curPos, int duration)
+{
+    if (curPos < 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(posMutex_);
+        int endPos = std::min(endPosition_, duration > 0 ? duration : INT_MAX);
+        if (isNextItemPrefetched_ || endPos == INT_MAX || curPos < endPos - NEXT_ITEM_PREFETCH_LEAD_MS) {
+            return;
+        }
+        isNextItemPrefetched_ = true;
+    }
+    auto player = player_.lock();
+    if (player) {
+        CLOGD("Near the end, curPos: %{public}d", curPos);
+        player->PrefetchNextItem();
+    }
+}
+
 void CastStreamPlayerCallback::HandleInterruptEvent(const Media::Format &infoBody)
 {
     int32_t hintTypeInt32 = 0;
@@ -325,6 +348,7 @@ void CastStreamPlayerCallback::OnPositionChanged(int position, int bufferPositio
         return;
     }
     CheckPosInfo(position);
+    CheckPrefetchPoint(position, duration);
     auto listener = ListenerGetter();
     if (!listener) {
         CLOGE("StreamPlayerListener is null");
@@ -753,9 +777,11 @@ bool CastStreamPlayer::SetSource(const MediaInfo &mediaInfo)
         CLOGE("Media player is null");
         return false;
     }
-    if (dataSource_) {
-        dataSource_->Stop();
-        dataSource_ = nullptr;
+    CancelAlbumCover();
+    std::shared_ptr<LocalDataSource> prefetched = TakePrefetchedSource(mediaInfo);
+    std::shared_ptr<LocalDataSource> current = SwapDataSource(nullptr);
+    if (current && current != prefetched) {
+        current->Stop();
     }
     int32_t ret;
     if (mediaInfo.mediaUrl.find("http") == 0) {
@@ -766,10 +792,22 @@ bool CastStreamPlayer::SetSource(const MediaInfo &mediaInfo)
         if (!fileChannelClient_) {
             return false;
         }
-        fileChannelClient_->NotifyCreateChannel();
-        dataSource_ = std::make_shared<LocalDataSource>(mediaInfo.mediaUrl, mediaInfo.mediaSize, fileChannelClient_);
-        dataSource_->Start();
-        fileChannelClient_->WaitCreateChannel();
+        if (mediaInfo.mediaType == "IMAGE" && ShowCachedImage(mediaInfo, prefetched)) {
+            return true;
+        }
+        std::shared_ptr<LocalDataSource> dataSource = prefetched;
+        if (dataSource) {
+            CLOGI("Use the prefetched data source");
+        } else {
+            fileChannelClient_->NotifyCreateChannel();
+            dataSource = std::make_shared<LocalDataSource>(mediaInfo.mediaUrl, mediaInfo.mediaSize,
+                fileChannelClient_, BlockCache::DEFAULT_CAPACITY, DiskBlockCache::GetInstance().IsEnabled());
+            fileChannelClient_->WaitCreateChannel();
+            // Start prefetches the file, so the channel has to be there
+            dataSource->Start();
+        }
+        SwapDataSource(dataSource);
+        currentMediaInfo_ = mediaInfo;
         if (mediaInfo.mediaType == "IMAGE") {
             CLOGI("Start to get image resource");
             if (!GetImageResource()) {
@@ -777,13 +815,11 @@ bool CastStreamPlayer::SetSource(const MediaInfo &mediaInfo)
             }
             CLOGI("Get image resource successfully");
             return true;
-        } else if (mediaInfo.mediaType == "AUDIO" && avMetadataHelper_) {
-            CLOGD("Start to get album cover");
-            avMetadataHelper_->SetSource(dataSource_);
-            auto albumCoverMem = avMetadataHelper_->FetchArtPicture();
-            ProcessAlbumCover(albumCoverMem);
+        } else if (mediaInfo.mediaType == "AUDIO") {
+            // The cover comes through OnAlbumCoverChanged once extracted, playback does not wait for it
+            RequestAlbumCover(dataSource);
         }
-        ret = player_->SetSource(dataSource_);
+        ret = player_->SetSource(dataSource);
     }
     if (ret != MSERR_OK) {
         CLOGE("Media player setSource failed");
@@ -797,51 +833,211 @@ bool CastStreamPlayer::SetSource(const MediaInfo &mediaInfo)
     return true;
 }
 
-bool CastStreamPlayer::GetImageResource()
+/*
+ * Opens the data source of an item before the player switches to it, so its head, tail and index travel over
+ * the file channel while the current item is torn down. SetSource takes it over when the same file comes.
+ */
+bool CastStreamPlayer::PrefetchSource(const MediaInfo &mediaInfo)
 {
-    int64_t imageSize;
-    if (!dataSource_) {
+    CLOGD("PrefetchSource in");
+    if (mediaInfo.mediaUrl.find("http") == 0 || mediaInfo.mediaSize <= 0 || !fileChannelClient_) {
         return false;
     }
-    dataSource_->GetSize(imageSize);
-    std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(imageSize);
-    if (!buffer) {
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex_);
+        if (nextDataSource_ && nextMediaUrl_ == mediaInfo.mediaUrl && nextMediaSize_ == mediaInfo.mediaSize) {
+            return true;
+        }
     }
-    uint8_t *currDstPos = buffer.get();
-    int32_t sumReadBytes = CAST_STREAM_INT_INIT;
-    int32_t readSize = imageSize;
-    int32_t tryTimes = CAST_STREAM_INT_INIT;
-    while (tryTimes < CAST_STREAM_MAX_TIMES && sumReadBytes < imageSize) {
-        int32_t curReadBytes = dataSource_->ReadBuffer(currDstPos, readSize, sumReadBytes);
-        currDstPos += curReadBytes;
-        sumReadBytes += curReadBytes;
-        readSize -= curReadBytes;
-        if (curReadBytes <= 0) {
-            tryTimes++;
-            std::this_thread::sleep_for(std::chrono::milliseconds(CAST_STREAM_WAIT_TIME));
+    StopPrefetchedSource();
+    fileChannelClient_->NotifyCreateChannel();
+    auto dataSource = std::make_shared<LocalDataSource>(mediaInfo.mediaUrl, mediaInfo.mediaSize, fileChannelClient_,
+        BlockCache::DEFAULT_CAPACITY, DiskBlockCache::GetInstance().IsEnabled());
+    fileChannelClient_->WaitCreateChannel();
+    dataSource->Start();
+    std::lock_guard<std::mutex> lock(prefetchMutex_);
+    nextDataSource_ = dataSource;
+    nextMediaUrl_ = mediaInfo.mediaUrl;
+    nextMediaSize_ = mediaInfo.mediaSize;
+    CLOGI("Prefetch next item, size:%{public}" PRId64, nextMediaSize_);
+    return true;
+}
+
+/*
+ * Called on the callback thread of the player when the current item reaches its closing credits. The source of the
+ * next item in the playlist is opened and started on the prefetch thread, so its head, tail and index are here when
+ * the player switches to it. In single loop mode the current item plays again instead.
+ */
+void CastStreamPlayer::PrefetchNextItem()
+{
+    CLOGD("PrefetchNextItem in");
+    auto dataSource = GetDataSource();
+    if (GetLoopMode() == LoopMode::LOOP_MODE_SINGLE) {
+        if (dataSource) {
+            dataSource->StartupPrefetch();
         }
+        return;
     }
-    if (sumReadBytes != imageSize) {
-        CLOGE("read image bytes failed");
-        return false;
+    MediaInfo nextItem;
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex_);
+        if (!hasNextItem_) {
+            return;
+        }
+        nextItem = nextItem_;
+    }
+    // Images of the list are decoded ahead by the image cache
+    if (nextItem.mediaType == "IMAGE") {
+        return;
     }
+    PostPrefetch(nextItem);
+}
 
-    Media::SourceOptions options;
-    uint32_t errCode;
-    std::unique_ptr<Media::ImageSource> imageSource
-        = Media::ImageSource::CreateImageSource(buffer.get(), imageSize, options, errCode);
-    if (imageSource == nullptr) {
-        CLOGE("imageSource is null, errCode = %{public}d", errCode);
+// Opening a source waits for the file channel, which the callback thread of the player must not do
+void CastStreamPlayer::PostPrefetch(const MediaInfo &mediaInfo)
+{
+    std::lock_guard<std::mutex> lock(prefetchMutex_);
+    if (prefetchStopped_) {
+        return;
+    }
+    pendingPrefetch_ = mediaInfo;
+    hasPendingPrefetch_ = true;
+    if (!prefetchThread_.joinable()) {
+        prefetchThread_ = std::thread(&CastStreamPlayer::PrefetchLoop, this);
+    }
+    prefetchCond_.notify_all();
+}
+
+void CastStreamPlayer::StopPrefetchThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex_);
+        prefetchStopped_ = true;
+        hasPendingPrefetch_ = false;
+        prefetchCond_.notify_all();
+    }
+    if (prefetchThread_.joinable()) {
+        prefetchThread_.join();
+    }
+}
+
+void CastStreamPlayer::PrefetchLoop()
+{
+    CLOGD("PrefetchLoop in");
+    while (true) {
+        MediaInfo mediaInfo;
+        {
+            std::unique_lock<std::mutex> lock(prefetchMutex_);
+            prefetchCond_.wait(lock, [this] { return prefetchStopped_ || hasPendingPrefetch_; });
+            if (prefetchStopped_) {
+                break;
+            }
+            mediaInfo = pendingPrefetch_;
+            hasPendingPrefetch_ = false;
+        }
+        PrefetchSource(mediaInfo);
+    }
+    CLOGD("PrefetchLoop out");
+}
+
+void CastStreamPlayer::SetNextItem(const MediaInfo &mediaInfo)
+{
+    std::lock_guard<std::mutex> lock(prefetchMutex_);
+    nextItem_ = mediaInfo;
+    hasNextItem_ = true;
+}
+
+void CastStreamPlayer::ClearNextItem()
+{
+    std::lock_guard<std::mutex> lock(prefetchMutex_);
+    nextItem_ = MediaInfo{};
+    hasNextItem_ = false;
+}
+
+// Counters of the local file being played, for telling link, source disk and cache thrash stalls apart
+bool CastStreamPlayer::GetStreamingStats(DataSourceStats &stats)
+{
+    auto dataSource = GetDataSource();
+    if (!dataSource) {
         return false;
     }
-    Media::DecodeOptions decodeParam;
-    auto pixelMap = imageSource->CreatePixelMap(0, decodeParam, errCode);
-    if (pixelMap == nullptr || errCode != 0) {
-        CLOGE("pixelMap is null, errCode = %{public}d", errCode);
+    dataSource->GetStats(stats);
+    return true;
+}
+
+std::shared_ptr<LocalDataSource> CastStreamPlayer::GetDataSource()
+{
+    std::lock_guard<std::mutex> lock(dataSourceMutex_);
+    return dataSource_;
+}
+
+// Returns the source played so far
+std::shared_ptr<LocalDataSource> CastStreamPlayer::SwapDataSource(std::shared_ptr<LocalDataSource> dataSource)
+{
+    std::lock_guard<std::mutex> lock(dataSourceMutex_);
+    dataSource_.swap(dataSource);
+    return dataSource;
+}
+
+std::shared_ptr<LocalDataSource> CastStreamPlayer::TakePrefetchedSource(const MediaInfo &mediaInfo)
+{
+    std::shared_ptr<LocalDataSource> dataSource;
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex_);
+        if (!nextDataSource_) {
+            return nullptr;
+        }
+        if (nextMediaUrl_ == mediaInfo.mediaUrl && nextMediaSize_ == mediaInfo.mediaSize) {
+            dataSource = nextDataSource_;
+            nextDataSource_ = nullptr;
+            nextMediaUrl_.clear();
+            nextMediaSize_ = 0;
+            return dataSource;
+        }
+    }
+    StopPrefetchedSource();
+    return nullptr;
+}
+
+void CastStreamPlayer::KeepForReplay(std::shared_ptr<LocalDataSource> dataSource, const MediaInfo &mediaInfo)
+{
+    std::lock_guard<std::mutex> lock(prefetchMutex_);
+    if (nextDataSource_) {
+        dataSource->Stop();
+        return;
+    }
+    // Reads of the next play begin at the head again
+    dataSource->StartupPrefetch();
+    nextDataSource_ = dataSource;
+    nextMediaUrl_ = mediaInfo.mediaUrl;
+    nextMediaSize_ = mediaInfo.mediaSize;
+}
+
+void CastStreamPlayer::StopPrefetchedSource()
+{
+    std::shared_ptr<LocalDataSource> dataSource;
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex_);
+        dataSource = nextDataSource_;
+        nextDataSource_ = nullptr;
+        nextMediaUrl_.clear();
+        nextMediaSize_ = 0;
+    }
+    if (dataSource) {
+        dataSource->Stop();
+    }
+}
+
+bool CastStreamPlayer::GetImageResource()
+{
+    std::shared_ptr<Media::PixelMap> sharedImg = ImageDecodeCache::Decode(GetDataSource(), true);
+    if (!sharedImg) {
         return false;
     }
-    std::shared_ptr<Media::PixelMap> sharedImg = std::move(pixelMap);
+    // Kept for a later Previous, shown again without another transfer
+    if (imageCache_) {
+        imageCache_->Put(currentMediaInfo_, sharedImg);
+    }
     if (!callback_) {
         CLOGE("callback_ is null");
         return false;
@@ -850,7 +1046,93 @@ bool CastStreamPlayer::GetImageResource()
     return true;
 }
 
-bool CastStreamPlayer::ProcessAlbumCover(std::shared_ptr<Media::AVSharedMemory> albumCoverMem)
+void CastStreamPlayer::SetImageCache(std::shared_ptr<ImageDecodeCache> imageCache)
+{
+    imageCache_ = imageCache;
+}
+
+bool CastStreamPlayer::ShowCachedImage(const MediaInfo &mediaInfo, std::shared_ptr<LocalDataSource> prefetched)
+{
+    std::shared_ptr<Media::PixelMap> pixelMap = imageCache_ ? imageCache_->Get(mediaInfo) : nullptr;
+    if (!pixelMap || !callback_) {
+        return false;
+    }
+    CLOGI("Show the image decoded ahead");
+    if (prefetched) {
+        prefetched->Stop();
+    }
+    currentMediaInfo_ = mediaInfo;
+    callback_->OnImageChanged(pixelMap);
+    return true;
+}
+
+/*
+ * Extracting the cover reads the file through the cache of the player's data source, so the ranges both need are
+ * fetched once and the cover mostly comes from data the player already has. It reads as a secondary reader, its
+ * jumps through the file would otherwise be taken for seeks of the player and cancel the player's requests.
+ */
+void CastStreamPlayer::RequestAlbumCover(std::shared_ptr<LocalDataSource> dataSource)
+{
+    if (!avMetadataHelper_ || !dataSource) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(albumCoverMutex_);
+    if (albumCoverStopped_) {
+        return;
+    }
+    albumCoverSeq_++;
+    albumCoverSource_ = dataSource;
+    if (!albumCoverThread_.joinable()) {
+        albumCoverThread_ = std::thread(&CastStreamPlayer::AlbumCoverLoop, this);
+    }
+    albumCoverCond_.notify_all();
+}
+
+void CastStreamPlayer::CancelAlbumCover()
+{
+    std::lock_guard<std::mutex> lock(albumCoverMutex_);
+    albumCoverSeq_++;
+    albumCoverSource_ = nullptr;
+}
+
+void CastStreamPlayer::StopAlbumCoverThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(albumCoverMutex_);
+        albumCoverStopped_ = true;
+        albumCoverSource_ = nullptr;
+        albumCoverCond_.notify_all();
+    }
+    if (albumCoverThread_.joinable()) {
+        albumCoverThread_.join();
+    }
+}
+
+void CastStreamPlayer::AlbumCoverLoop()
+{
+    CLOGD("AlbumCoverLoop in");
+    while (true) {
+        std::shared_ptr<LocalDataSource> dataSource;
+        uint64_t seq = 0;
+        {
+            std::unique_lock<std::mutex> lock(albumCoverMutex_);
+            albumCoverCond_.wait(lock, [this] { return albumCoverStopped_ || albumCoverSource_ != nullptr; });
+            if (albumCoverStopped_) {
+                break;
+            }
+            dataSource = albumCoverSource_;
+            albumCoverSource_ = nullptr;
+            seq = albumCoverSeq_;
+        }
+        CLOGD("Start to get album cover");
+        avMetadataHelper_->SetSource(std::make_shared<SecondaryDataSource>(dataSource));
+        auto albumCoverMem = avMetadataHelper_->FetchArtPicture();
+        ProcessAlbumCover(albumCoverMem, seq);
+    }
+    CLOGD("AlbumCoverLoop out");
+}
+
+bool CastStreamPlayer::ProcessAlbumCover(std::shared_ptr<Media::AVSharedMemory> albumCoverMem, uint64_t seq)
 {
     if (!albumCoverMem) {
         CLOGE("albumCoverMem is null");
@@ -872,6 +1154,13 @@ bool CastStreamPlayer::ProcessAlbumCover(std::shared_ptr<Media::AVSharedMemory>
         return false;
     }
     std::shared_ptr<Media::PixelMap> sharedAlbumCover = std::move(pixelMap);
+    {
+        std::lock_guard<std::mutex> lock(albumCoverMutex_);
+        if (seq != albumCoverSeq_) {
+            CLOGI("Drop the album cover of a previous item");
+            return false;
+        }
+    }
     if (!callback_) {
         CLOGE("callback_ is null");
         return false;
@@ -1037,8 +1326,13 @@ bool CastStreamPlayer::Release()
         audioSystemMgr_->UnregisterVolumeKeyEventCallback(getpid());
         audioSystemMgr_ = nullptr;
     }
+    // The cover thread reports through callback_
+    StopAlbumCoverThread();
     callback_ = nullptr;
     castStreamVolumeCallback_ = nullptr;
+    // A prefetch finished after this would leave a source running
+    StopPrefetchThread();
+    StopPrefetchedSource();
     if (!player_) {
         CLOGE("Media player is null");
         return false;
@@ -1325,9 +1619,9 @@ bool CastStreamPlayer::IsLooping()
 void CastStreamPlayer::NotifyPlayComplete()
 {
     CLOGD("NotifyPlayComplete in");
-    if (dataSource_) {
-        dataSource_->Stop();
-        dataSource_ = nullptr;
+    std::shared_ptr<LocalDataSource> dataSource = SwapDataSource(nullptr);
+    if (dataSource) {
+        KeepForReplay(dataSource, currentMediaInfo_);
     }
 }
 
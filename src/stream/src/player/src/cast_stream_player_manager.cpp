@@ -20,12 +20,19 @@
 #include "cast_engine_log.h"
 #include "cast_stream_player_manager.h"
 #include "cast_engine_dfx.h"
+#include "disk_block_cache.h"
+#include "parameters.h"
 
 namespace OHOS {
 namespace CastEngine {
 namespace CastEngineService {
 DEFINE_CAST_ENGINE_LABEL("Cast-Stream-Player-Manager");
 
+namespace {
+// Size in bytes of the disk cache of played local files, the cache is off unless the device sets it
+const std::string DISK_CACHE_CAPACITY_PARAM = "persist.cast_engine.stream.disk_cache_capacity";
+}
+
 CastStreamPlayerManager::CastStreamPlayerManager(std::shared_ptr<ICastStreamManagerServer> callback,
     std::shared_ptr<CastLocalFileChannelClient> fileChannel)
 {
@@ -42,6 +49,10 @@ CastStreamPlayerManager::CastStreamPlayerManager(std::shared_ptr<ICastStreamMana
         return;
     }
     callback_->SetPlayer(player_);
+    SetDiskCacheCapacity(system::GetIntParameter<int64_t>(DISK_CACHE_CAPACITY_PARAM,
+        DiskBlockCache::DEFAULT_CAPACITY));
+    imageCache_ = std::make_shared<ImageDecodeCache>(fileChannel);
+    player_->SetImageCache(imageCache_);
     CLOGD("CastStreamPlayerManager out");
 }
 
@@ -50,6 +61,12 @@ CastStreamPlayerManager::~CastStreamPlayerManager()
     CLOGD("~CastStreamPlayerManager in");
 }
 
+// Takes effect for the files opened after it, 0 turns the disk cache off and deletes what it holds
+void CastStreamPlayerManager::SetDiskCacheCapacity(int64_t capacity)
+{
+    DiskBlockCache::GetInstance().SetCapacity(capacity);
+}
+
 void CastStreamPlayerManager::SetSessionCallbackForRelease(const std::function<void(void)> &callback)
 {
     std::lock_guard<std::mutex> lock(sessionCallbackMutex_);
@@ -150,6 +167,10 @@ int32_t CastStreamPlayerManager::Load(const MediaInfo &mediaInfo)
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
+    // The new item warms up over the file channel while the current one stops
+    if (!IsImageCached(mediaInfo)) {
+        player_->PrefetchSource(mediaInfo);
+    }
     if (callback_->IsNeededToReset()) {
         callback_->SetSwitching();
         StopLocked();
@@ -172,6 +193,45 @@ int32_t CastStreamPlayerManager::Load(const MediaInfo &mediaInfo)
     return CAST_ENGINE_SUCCESS;
 }
 
+/*
+ * The images around the current item of the list are decoded in the background, so moving to the next or previous
+ * photo of a slideshow shows it at once. Images already shown stay in the same cache. The player learns the item
+ * after the current one, whose source it opens near the end of the current item.
+ */
+void CastStreamPlayerManager::SetPlaylist(const std::vector<MediaInfo> &mediaInfoList, size_t currentIndex)
+{
+    if (currentIndex >= mediaInfoList.size()) {
+        return;
+    }
+    if (player_) {
+        size_t nextIndex = currentIndex + 1;
+        if (nextIndex == mediaInfoList.size() && player_->GetLoopMode() == LoopMode::LOOP_MODE_LIST) {
+            nextIndex = 0;
+        }
+        if (nextIndex < mediaInfoList.size() && nextIndex != currentIndex) {
+            player_->SetNextItem(mediaInfoList[nextIndex]);
+        } else {
+            player_->ClearNextItem();
+        }
+    }
+    if (!imageCache_) {
+        return;
+    }
+    std::vector<MediaInfo> decodeList;
+    for (size_t i = currentIndex + 1; i < mediaInfoList.size() && i <= currentIndex + DECODE_AHEAD_COUNT; i++) {
+        decodeList.push_back(mediaInfoList[i]);
+    }
+    for (size_t i = 1; i <= DECODE_BEHIND_COUNT && i <= currentIndex; i++) {
+        decodeList.push_back(mediaInfoList[currentIndex - i]);
+    }
+    imageCache_->DecodeAhead(decodeList);
+}
+
+bool CastStreamPlayerManager::IsImageCached(const MediaInfo &mediaInfo)
+{
+    return mediaInfo.mediaType == "IMAGE" && imageCache_ && imageCache_->Contains(mediaInfo);
+}
+
 int32_t CastStreamPlayerManager::Play(int index)
 {
     CLOGW("Don't support play index");
@@ -257,6 +317,10 @@ int32_t CastStreamPlayerManager::InnerPlay(const MediaInfo &mediaInfo)
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
+    // The new item warms up over the file channel while the current one stops
+    if (!IsImageCached(mediaInfo)) {
+        player_->PrefetchSource(mediaInfo);
+    }
     if (callback_->IsNeededToReset()) {
         callback_->SetSwitching();
         StopLocked();
@@ -725,9 +789,25 @@ int32_t CastStreamPlayerManager::GetMediaInfoHolder(MediaInfoHolder &mediaInfoHo
     return CAST_ENGINE_ERROR;
 }
 
+int32_t CastStreamPlayerManager::GetStreamingStats(DataSourceStats &stats)
+{
+    if (!player_) {
+        CLOGE("player_ is null");
+        return CAST_ENGINE_ERROR;
+    }
+    if (!player_->GetStreamingStats(stats)) {
+        CLOGD("No local file is streaming");
+        return CAST_ENGINE_ERROR;
+    }
+    return CAST_ENGINE_SUCCESS;
+}
+
 int32_t CastStreamPlayerManager::Release()
 {
     Stop();
+    if (imageCache_) {
+        imageCache_->Clear();
+    }
     std::lock_guard<std::mutex> lock(sessionCallbackMutex_);
     if (!sessionCallback_) {
         CLOGE("sessionCallback is null");
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: decoded images of a slideshow, decoded ahead of their turn
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include "image_decode_cache.h"
+#include <algorithm>
+#include <cinttypes>
+#include "image_source.h"
+#include "incremental_pixel_map.h"
+#include "cast_engine_log.h"
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+DEFINE_CAST_ENGINE_LABEL("Cast-ImageDecodeCache");
+
+ImageDecodeCache::ImageDecodeCache(std::shared_ptr<CastLocalFileChannelClient> fileChannel, int64_t capacity)
+    : fileChannelClient_(fileChannel), capacity_(capacity)
+{
+    worker_ = std::thread(&ImageDecodeCache::WorkerLoop, this);
+}
+
+ImageDecodeCache::~ImageDecodeCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        cond_.notify_all();
+    }
+    Clear();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::string ImageDecodeCache::MakeKey(const MediaInfo &mediaInfo)
+{
+    return mediaInfo.mediaUrl + "_" + std::to_string(mediaInfo.mediaSize);
+}
+
+void ImageDecodeCache::DecodeAhead(const std::vector<MediaInfo> &mediaInfos)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    for (const auto &mediaInfo : mediaInfos) {
+        if (mediaInfo.mediaType != "IMAGE" || mediaInfo.mediaUrl.find("http") == 0 || mediaInfo.mediaSize <= 0) {
+            continue;
+        }
+        std::string key = MakeKey(mediaInfo);
+        if (entries_.find(key) == entries_.end() && key != decodingKey_) {
+            pending_.push_back(mediaInfo);
+        }
+    }
+    if (!pending_.empty()) {
+        CLOGI("decode %{public}zu images ahead", pending_.size());
+        cond_.notify_all();
+    }
+}
+
+std::shared_ptr<Media::PixelMap> ImageDecodeCache::Get(const MediaInfo &mediaInfo)
+{
+    std::string key = MakeKey(mediaInfo);
+    std::unique_lock<std::mutex> lock(mutex_);
+    // An image still waiting is read by the caller at blocking priority instead
+    pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+        [&key](const MediaInfo &item) { return MakeKey(item) == key; }), pending_.end());
+    if (decodingKey_ == key) {
+        CLOGI("wait for the image being decoded ahead");
+        cond_.wait(lock, [this, &key] { return stopped_ || decodingKey_ != key; });
+    }
+    auto iter = entries_.find(key);
+    if (iter == entries_.end()) {
+        missCount_++;
+        return nullptr;
+    }
+    hitCount_++;
+    lruList_.splice(lruList_.end(), lruList_, iter->second.lruIter);
+    return iter->second.pixelMap;
+}
+
+bool ImageDecodeCache::Contains(const MediaInfo &mediaInfo)
+{
+    std::string key = MakeKey(mediaInfo);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.find(key) != entries_.end() || decodingKey_ == key;
+}
+
+void ImageDecodeCache::Put(const MediaInfo &mediaInfo, std::shared_ptr<Media::PixelMap> pixelMap)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    PutLocked(MakeKey(mediaInfo), pixelMap);
+}
+
+void ImageDecodeCache::PutLocked(const std::string &key, std::shared_ptr<Media::PixelMap> pixelMap)
+{
+    int64_t size = pixelMap ? static_cast<int64_t>(pixelMap->GetByteCount()) : 0;
+    if (size <= 0 || size > capacity_) {
+        return;
+    }
+    auto iter = entries_.find(key);
+    if (iter != entries_.end()) {
+        usedSize_ -= iter->second.size;
+        lruList_.erase(iter->second.lruIter);
+        entries_.erase(iter);
+    }
+    Entry &entry = entries_[key];
+    entry.pixelMap = pixelMap;
+    entry.size = size;
+    entry.lruIter = lruList_.insert(lruList_.end(), key);
+    usedSize_ += size;
+    EvictLocked();
+}
+
+void ImageDecodeCache::EvictLocked()
+{
+    while (usedSize_ > capacity_ && !lruList_.empty()) {
+        auto iter = entries_.find(lruList_.front());
+        if (iter != entries_.end()) {
+            usedSize_ -= iter->second.size;
+            entries_.erase(iter);
+        }
+        lruList_.pop_front();
+    }
+}
+
+void ImageDecodeCache::Clear()
+{
+    std::shared_ptr<LocalDataSource> dataSource;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (hitCount_ != 0 || missCount_ != 0) {
+            CLOGI("image cache hits:%{public}" PRIu64 " misses:%{public}" PRIu64, hitCount_, missCount_);
+        }
+        pending_.clear();
+        entries_.clear();
+        lruList_.clear();
+        usedSize_ = 0;
+        dataSource = decodingSource_;
+        decodingSource_ = nullptr;
+    }
+    // Stopping the source fails its reads, which ends the decoding
+    if (dataSource) {
+        dataSource->Stop();
+    }
+}
+
+void ImageDecodeCache::WorkerLoop()
+{
+    CLOGD("in");
+    while (true) {
+        MediaInfo mediaInfo;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return stopped_ || !pending_.empty(); });
+            if (stopped_) {
+                break;
+            }
+            mediaInfo = pending_.front();
+            pending_.pop_front();
+            decodingKey_ = MakeKey(mediaInfo);
+            if (entries_.find(decodingKey_) != entries_.end()) {
+                decodingKey_.clear();
+                continue;
+            }
+        }
+        DecodeOne(mediaInfo);
+    }
+}
+
+void ImageDecodeCache::DecodeOne(const MediaInfo &mediaInfo)
+{
+    std::shared_ptr<Media::PixelMap> pixelMap;
+    if (fileChannelClient_) {
+        fileChannelClient_->NotifyCreateChannel();
+        auto dataSource = std::make_shared<LocalDataSource>(mediaInfo.mediaUrl, mediaInfo.mediaSize,
+            fileChannelClient_, BlockCache::DEFAULT_CAPACITY, DiskBlockCache::GetInstance().IsEnabled());
+        fileChannelClient_->WaitCreateChannel();
+        bool aborted = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            aborted = stopped_;
+            decodingSource_ = dataSource;
+        }
+        if (!aborted) {
+            dataSource->Start();
+            pixelMap = Decode(dataSource, false);
+        }
+        dataSource->Stop();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Cleared while decoding, the image is no longer wanted
+    bool wanted = decodingSource_ != nullptr && !stopped_;
+    if (pixelMap && wanted) {
+        CLOGI("image decoded ahead, size:%{public}" PRId64, static_cast<int64_t>(mediaInfo.mediaSize));
+        PutLocked(decodingKey_, pixelMap);
+    }
+    decodingSource_ = nullptr;
+    decodingKey_.clear();
+    cond_.notify_all();
+}
+
+/*
+ * The image streams in as one bulk transfer and is decoded incrementally while it arrives, so it is ready about one
+ * transfer time after the request.
+ */
+std::shared_ptr<Media::PixelMap> ImageDecodeCache::Decode(std::shared_ptr<LocalDataSource> dataSource, bool blocking)
+{
+    int64_t imageSize = 0;
+    if (!dataSource) {
+        return nullptr;
+    }
+    dataSource->GetSize(imageSize);
+    if (imageSize <= 0) {
+        return nullptr;
+    }
+    Media::IncrementalSourceOptions options;
+    options.incrementalMode = Media::IncrementalMode::INCREMENTAL_DATA;
+    uint32_t errCode = 0;
+    std::unique_ptr<Media::ImageSource> imageSource
+        = Media::ImageSource::CreateIncrementalImageSource(options, errCode);
+    if (imageSource == nullptr) {
+        CLOGE("imageSource is null, errCode = %{public}d", errCode);
+        return nullptr;
+    }
+    std::unique_ptr<uint8_t[]> chunk = std::make_unique<uint8_t[]>(IMAGE_CHUNK_SIZE);
+    std::unique_ptr<Media::IncrementalPixelMap> pixelMap;
+    Media::DecodeOptions decodeParam;
+    bool bulkRequested = false;
+    int64_t pos = 0;
+    while (pos < imageSize) {
+        // Until the channel takes bulk requests, the reads fetch the image piecewise
+        bulkRequested = bulkRequested || dataSource->RequestWholeFile(blocking);
+        uint32_t length = static_cast<uint32_t>(std::min(IMAGE_CHUNK_SIZE, imageSize - pos));
+        int32_t readBytes = dataSource->ReadBuffer(chunk.get(), length, pos, IMAGE_STALL_TIMEOUT_MS);
+        if (readBytes <= 0) {
+            CLOGE("read image bytes failed, pos:%{public}" PRId64 " ret:%{public}d", pos, readBytes);
+            return nullptr;
+        }
+        pos += readBytes;
+        errCode = imageSource->UpdateData(chunk.get(), static_cast<uint32_t>(readBytes), pos >= imageSize);
+        if (errCode != 0) {
+            CLOGE("update image data failed, errCode = %{public}d", errCode);
+            return nullptr;
+        }
+        // The pixel map can be created once the header is in, then each piece is decoded as it comes
+        if (pixelMap == nullptr) {
+            pixelMap = imageSource->CreateIncrementalPixelMap(0, decodeParam, errCode);
+        }
+        if (pixelMap != nullptr) {
+            uint8_t progress = 0;
+            pixelMap->PromoteDecoding(progress);
+        }
+    }
+    if (pixelMap == nullptr) {
+        CLOGE("pixelMap is null, errCode = %{public}d", errCode);
+        return nullptr;
+    }
+    uint8_t progress = 0;
+    errCode = pixelMap->PromoteDecoding(progress);
+    // The pixel map outlives the image source
+    pixelMap->DetachFromDecoding();
+    if (errCode != 0 || pixelMap->GetDecodingStatus().state != Media::IncrementalDecodingState::IMAGE_DECODED) {
+        CLOGE("decode image failed, errCode = %{public}d progress = %{public}u", errCode, progress);
+        return nullptr;
+    }
+    return std::shared_ptr<Media::PixelMap>(std::move(pixelMap));
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: unit tests of the ring buffer the tcp connections read into.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+#include "recv_ring_buffer.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+// Fills the free space of the ring with bytes counting on from next, returns the number filled
+size_t Fill(RecvRingBuffer &ring, size_t length, uint8_t &next)
+{
+    struct iovec iov[2];
+    int count = ring.GetFreeSegments(iov);
+    size_t filled = 0;
+    for (int i = 0; i < count && filled < length; i++) {
+        size_t part = std::min(length - filled, iov[i].iov_len);
+        uint8_t *base = static_cast<uint8_t *>(iov[i].iov_base);
+        for (size_t j = 0; j < part; j++) {
+            base[j] = next++;
+        }
+        filled += part;
+    }
+    ring.Commit(filled);
+    return filled;
+}
+}
+
+class RecvRingBufferTest : public testing::Test {};
+
+HWTEST_F(RecvRingBufferTest, FillAndRead, TestSize.Level1)
+{
+    RecvRingBuffer ring;
+    uint8_t next = 0;
+    EXPECT_EQ(Fill(ring, 100, next), 100u);
+    EXPECT_EQ(ring.Size(), 100u);
+
+    uint8_t peeked[10] = { 0 };
+    ASSERT_TRUE(ring.Peek(peeked, sizeof(peeked)));
+    EXPECT_EQ(peeked[9], 9);
+    EXPECT_EQ(ring.Size(), 100u);
+
+    const uint8_t *inPlace = ring.GetContiguous(100);
+    ASSERT_NE(inPlace, nullptr);
+    EXPECT_EQ(inPlace[99], 99);
+    EXPECT_EQ(ring.GetContiguous(101), nullptr);
+
+    uint8_t out[60] = { 0 };
+    EXPECT_EQ(ring.Read(out, sizeof(out)), sizeof(out));
+    EXPECT_EQ(out[59], 59);
+    EXPECT_EQ(ring.Size(), 40u);
+    ring.Consume(40);
+    EXPECT_EQ(ring.Size(), 0u);
+    EXPECT_TRUE(ring.Peek(out, 0));
+    EXPECT_FALSE(ring.Peek(out, 1));
+}
+
+HWTEST_F(RecvRingBufferTest, FreeSpaceWrapsAround, TestSize.Level1)
+{
+    RecvRingBuffer ring;
+    const size_t capacity = ring.Capacity();
+    uint8_t next = 0;
+    ASSERT_EQ(Fill(ring, capacity - 10, next), capacity - 10);
+    ring.Consume(capacity - 20);
+
+    // 10 bytes up to the end of the storage and the consumed head after them
+    struct iovec iov[2];
+    ASSERT_EQ(ring.GetFreeSegments(iov), 2);
+    EXPECT_EQ(iov[0].iov_len, 10u);
+    EXPECT_EQ(iov[1].iov_len, capacity - 20);
+    EXPECT_EQ(Fill(ring, 30, next), 30u);
+    EXPECT_EQ(ring.Size(), 40u);
+
+    // The unread bytes wrap, they are only given out by copy
+    EXPECT_EQ(ring.GetContiguous(40), nullptr);
+    ASSERT_NE(ring.GetContiguous(20), nullptr);
+    std::vector<uint8_t> out(40);
+    ASSERT_TRUE(ring.Peek(out.data(), out.size()));
+    uint8_t expected = static_cast<uint8_t>(capacity - 20);
+    for (size_t i = 0; i < out.size(); i++) {
+        EXPECT_EQ(out[i], static_cast<uint8_t>(expected + i));
+    }
+    EXPECT_EQ(ring.Read(out.data(), out.size()), out.size());
+    EXPECT_EQ(ring.Size(), 0u);
+}
+
+HWTEST_F(RecvRingBufferTest, FullRingHasNoFreeSpace, TestSize.Level1)
+{
+    RecvRingBuffer ring;
+    uint8_t next = 0;
+    ASSERT_EQ(Fill(ring, ring.Capacity(), next), ring.Capacity());
+    struct iovec iov[2];
+    EXPECT_EQ(ring.GetFreeSegments(iov), 0);
+    uint8_t out[16];
+    EXPECT_EQ(ring.Read(out, sizeof(out)), sizeof(out));
+    EXPECT_EQ(ring.GetFreeSegments(iov), 1);
+    EXPECT_EQ(iov[0].iov_len, sizeof(out));
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
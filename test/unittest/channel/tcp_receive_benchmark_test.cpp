@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: receive syscalls per packet of a tcp connection, read in batches out of its ring buffer.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "tcp_connection.h"
+#include "utils.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+constexpr int WAIT_STEP_MS = 10;
+constexpr int WAIT_STEPS = 1000;
+constexpr size_t PACKET_HEADER_LEN = 4;
+// Before the ring buffer every packet took a read of its header and another one of its body
+constexpr double UNBATCHED_READS_PER_PACKET = 2.0;
+
+class OpenListener : public ConnectionListener {
+public:
+    bool OnConnectionOpened(std::shared_ptr<Channel> channel) override
+    {
+        return true;
+    }
+    void OnConnectionError(std::shared_ptr<Channel> channel, int errorCode) override {}
+};
+
+// Checks that the packets come whole and in order, each starts with its sequence number
+class CountingListener : public IChannelListener {
+public:
+    void OnDataReceived(const uint8_t *buffer, unsigned int length, long timeCost) override
+    {
+        uint32_t sequence = 0;
+        if (length < sizeof(sequence) || memcpy(&sequence, buffer, sizeof(sequence)) == nullptr ||
+            sequence != received.load()) {
+            broken = true;
+            return;
+        }
+        received++;
+    }
+
+    std::atomic<uint32_t> received{ 0 };
+    std::atomic<bool> broken{ false };
+};
+}
+
+class TcpReceiveBenchmarkTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GE(listenFd_, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrLen = sizeof(addr);
+        ASSERT_EQ(bind(listenFd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)), 0);
+        ASSERT_EQ(listen(listenFd_, 1), 0);
+        ASSERT_EQ(getsockname(listenFd_, reinterpret_cast<struct sockaddr *>(&addr), &addrLen), 0);
+
+        connection_ = std::make_shared<TcpConnection>();
+        connection_->SetConnectionListener(std::make_shared<OpenListener>());
+        ChannelRequest request;
+        request.moduleType = ModuleType::RTSP;
+        request.isReceiver = true;
+        request.localDeviceInfo.ipAddress = "127.0.0.1";
+        request.remoteDeviceInfo.ipAddress = "127.0.0.1";
+        request.remotePort = ntohs(addr.sin_port);
+        listener_ = std::make_shared<CountingListener>();
+        connection_->StartConnection(request, listener_);
+        peerFd_ = accept(listenFd_, nullptr, nullptr);
+        ASSERT_GE(peerFd_, 0);
+    }
+
+    void TearDown() override
+    {
+        if (connection_) {
+            connection_->CloseConnection();
+        }
+        close(peerFd_);
+        close(listenFd_);
+    }
+
+    // Sends count packets of the given body lengths in one stream and returns the reads per packet
+    double Measure(uint32_t count, const std::function<size_t(uint32_t)> &bodyLength)
+    {
+        std::vector<uint8_t> stream;
+        for (uint32_t sequence = 0; sequence < count; sequence++) {
+            size_t length = std::max(bodyLength(sequence), sizeof(sequence));
+            uint8_t header[PACKET_HEADER_LEN];
+            Utils::IntToByteArray(static_cast<int>(length), PACKET_HEADER_LEN, header);
+            stream.insert(stream.end(), header, header + PACKET_HEADER_LEN);
+            size_t body = stream.size();
+            stream.resize(body + length);
+            memcpy(&stream[body], &sequence, sizeof(sequence));
+        }
+        for (size_t sent = 0; sent < stream.size();) {
+            ssize_t written = send(peerFd_, stream.data() + sent, stream.size() - sent, 0);
+            if (written <= 0) {
+                return 0;
+            }
+            sent += static_cast<size_t>(written);
+        }
+        for (int i = 0; i < WAIT_STEPS && listener_->received < count && !listener_->broken; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_STEP_MS));
+        }
+        EXPECT_FALSE(listener_->broken);
+        EXPECT_EQ(listener_->received.load(), count);
+        TcpConnection::ReceiveStats stats;
+        if (!connection_->GetReceiveStats(stats) || stats.packets == 0) {
+            return 0;
+        }
+        return static_cast<double>(stats.recvCalls) / static_cast<double>(stats.packets);
+    }
+
+    int listenFd_{ -1 };
+    int peerFd_{ -1 };
+    std::shared_ptr<TcpConnection> connection_;
+    std::shared_ptr<CountingListener> listener_;
+};
+
+HWTEST_F(TcpReceiveBenchmarkTest, SmallPacketsShareReads, TestSize.Level1)
+{
+    const uint32_t count = 20000;
+    double readsPerPacket = Measure(count, [](uint32_t) { return 64; });
+    RecordProperty("readsPerPacket", std::to_string(readsPerPacket));
+    EXPECT_GT(readsPerPacket, 0);
+    EXPECT_LT(readsPerPacket, UNBATCHED_READS_PER_PACKET / 4);
+}
+
+HWTEST_F(TcpReceiveBenchmarkTest, MixedPacketsShareReads, TestSize.Level1)
+{
+    const uint32_t count = 5000;
+    const uint32_t largeEvery = 50;
+    const size_t largeLength = 300 * 1024;
+    const size_t smallLength = 200;
+    double readsPerPacket = Measure(count, [largeEvery, largeLength, smallLength](uint32_t sequence) {
+        return sequence % largeEvery == 0 ? largeLength : smallLength;
+    });
+    RecordProperty("readsPerPacket", std::to_string(readsPerPacket));
+    EXPECT_GT(readsPerPacket, 0);
+    EXPECT_LT(readsPerPacket, UNBATCHED_READS_PER_PACKET);
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: unit tests of sending file data on a tcp connection whose peer reads slowly.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "tcp_connection.h"
+#include "utils.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+constexpr int WAIT_STEP_MS = 1;
+constexpr int WAIT_STEPS = 5000;
+constexpr size_t PACKET_HEADER_LEN = 4;
+constexpr int FILE_PACKET_LENGTH = 512 * 1024;
+constexpr int PACKET_COUNT = 12;
+
+class OpenListener : public ConnectionListener {
+public:
+    bool OnConnectionOpened(std::shared_ptr<Channel> channel) override
+    {
+        opened = channel;
+        return true;
+    }
+    void OnConnectionError(std::shared_ptr<Channel> channel, int errorCode) override {}
+
+    std::shared_ptr<Channel> opened;
+};
+
+bool ReadAll(int fd, uint8_t *buffer, size_t length)
+{
+    for (size_t received = 0; received < length;) {
+        ssize_t ret = recv(fd, buffer + received, length - received, 0);
+        if (ret <= 0) {
+            return false;
+        }
+        received += static_cast<size_t>(ret);
+    }
+    return true;
+}
+}
+
+class TcpSendFileTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GE(listenFd_, 0);
+        // A small receive buffer, so the socket soon stops taking data while the peer doesn't read
+        int small = 4096;
+        setsockopt(listenFd_, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrLen = sizeof(addr);
+        ASSERT_EQ(bind(listenFd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)), 0);
+        ASSERT_EQ(listen(listenFd_, 1), 0);
+        ASSERT_EQ(getsockname(listenFd_, reinterpret_cast<struct sockaddr *>(&addr), &addrLen), 0);
+
+        file_ = tmpfile();
+        ASSERT_NE(file_, nullptr);
+        content_.resize(FILE_PACKET_LENGTH * PACKET_COUNT);
+        for (size_t i = 0; i < content_.size(); i++) {
+            content_[i] = static_cast<uint8_t>(i * 13 + 5);
+        }
+        ASSERT_EQ(write(fileno(file_), content_.data(), content_.size()), static_cast<ssize_t>(content_.size()));
+
+        connection_ = std::make_shared<TcpConnection>();
+        listener_ = std::make_shared<OpenListener>();
+        connection_->SetConnectionListener(listener_);
+        ChannelRequest request;
+        request.moduleType = ModuleType::RTSP;
+        request.localDeviceInfo.ipAddress = "127.0.0.1";
+        request.remoteDeviceInfo.ipAddress = "127.0.0.1";
+        request.remotePort = ntohs(addr.sin_port);
+        connection_->StartConnection(request, nullptr);
+        peerFd_ = accept(listenFd_, nullptr, nullptr);
+        ASSERT_GE(peerFd_, 0);
+        for (int i = 0; i < WAIT_STEPS && !listener_->opened; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_STEP_MS));
+        }
+        ASSERT_NE(listener_->opened, nullptr);
+    }
+
+    void TearDown() override
+    {
+        if (connection_) {
+            connection_->CloseConnection();
+        }
+        // The listener keeps the connection it was given, and the connection keeps the listener
+        if (listener_) {
+            listener_->opened = nullptr;
+        }
+        close(peerFd_);
+        close(listenFd_);
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+    }
+
+    int listenFd_{ -1 };
+    int peerFd_{ -1 };
+    FILE *file_{ nullptr };
+    std::vector<uint8_t> content_;
+    std::shared_ptr<TcpConnection> connection_;
+    std::shared_ptr<OpenListener> listener_;
+};
+
+/*
+ * File packets and plain packets sent while the peer doesn't read are queued instead of waited for, and arrive
+ * whole and in order once it reads. The file is closed by the caller before the queue is written.
+ */
+HWTEST_F(TcpSendFileTest, QueuesFileDataWithoutWaiting, TestSize.Level1)
+{
+    int fd = dup(fileno(file_));
+    ASSERT_GE(fd, 0);
+    for (int i = 0; i < PACKET_COUNT; i++) {
+        std::string header = "file " + std::to_string(i);
+        EXPECT_EQ(connection_->SendFile(reinterpret_cast<const uint8_t *>(header.data()), header.size(), fd,
+            static_cast<int64_t>(i) * FILE_PACKET_LENGTH, FILE_PACKET_LENGTH), SendFileResult::SENT);
+        std::string message = "message " + std::to_string(i);
+        EXPECT_TRUE(connection_->Send(reinterpret_cast<const uint8_t *>(message.data()), message.size()));
+    }
+    // The peer has read nothing yet, so what the socket buffers could not take is still queued
+    SendQueueStats stats;
+    ASSERT_TRUE(connection_->GetSendQueueStats(stats));
+    EXPECT_GT(stats.queuedBytes, 0u);
+    close(fd);
+
+    for (int i = 0; i < PACKET_COUNT; i++) {
+        uint8_t header[PACKET_HEADER_LEN];
+        std::string fileHeader = "file " + std::to_string(i);
+        ASSERT_TRUE(ReadAll(peerFd_, header, PACKET_HEADER_LEN));
+        ASSERT_EQ(Utils::ByteArrayToInt(header, PACKET_HEADER_LEN), fileHeader.size() + FILE_PACKET_LENGTH);
+        std::vector<uint8_t> packet(fileHeader.size() + FILE_PACKET_LENGTH);
+        ASSERT_TRUE(ReadAll(peerFd_, packet.data(), packet.size()));
+        EXPECT_EQ(std::string(packet.begin(), packet.begin() + fileHeader.size()), fileHeader);
+        EXPECT_TRUE(std::equal(packet.begin() + fileHeader.size(), packet.end(),
+            content_.begin() + static_cast<size_t>(i) * FILE_PACKET_LENGTH));
+
+        std::string message = "message " + std::to_string(i);
+        ASSERT_TRUE(ReadAll(peerFd_, header, PACKET_HEADER_LEN));
+        ASSERT_EQ(Utils::ByteArrayToInt(header, PACKET_HEADER_LEN), message.size());
+        std::vector<uint8_t> body(message.size());
+        ASSERT_TRUE(ReadAll(peerFd_, body.data(), body.size()));
+        EXPECT_EQ(std::string(body.begin(), body.end()), message);
+    }
+    ASSERT_TRUE(connection_->GetSendQueueStats(stats));
+    EXPECT_EQ(stats.queuedBytes, 0u);
+}
+
+HWTEST_F(TcpSendFileTest, RefusesWhatIsNoRegularFile, TestSize.Level1)
+{
+    int pipeFds[2];
+    ASSERT_EQ(pipe(pipeFds), 0);
+    const uint8_t header[] = "header";
+    EXPECT_EQ(connection_->SendFile(header, sizeof(header), pipeFds[0], 0, FILE_PACKET_LENGTH),
+        SendFileResult::NOT_SENT);
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
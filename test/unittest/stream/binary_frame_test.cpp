@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: unit tests of the binary framing of the local file channel and its http fallback.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "cast_local_file_channel_common.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+const std::string FILE_ID = "L2RhdGEvbWVkaWEvbW92aWUubXA0";
+constexpr int64_t CHUNK_LENGTH = 1024 * 1024;
+constexpr int64_t FILE_LENGTH = 100 * CHUNK_LENGTH;
+constexpr int PARSE_ROUNDS = 100000;
+
+std::string MakeHttpRequest(int64_t start, int64_t end)
+{
+    return "GET " + FILE_ID + " HTTP/1.1\r\nRange: bytes=" + std::to_string(start) + "-" + std::to_string(end) +
+        "\r\n" + HTTP_PRIORITY_HEADER + ": 1\r\n" + HTTP_FRAMING_HEADER + ": " + BINARY_FRAMING_VERSION + "\r\n\r\n";
+}
+
+// The header of a response the way the server writes it, without its body
+std::string MakeHttpResponse(int64_t start, int64_t end)
+{
+    return "HTTP/1.1 200 OK\r\nAccept-Ranges: bytes\r\nContent-Length: " + std::to_string(end - start) +
+        "\r\nContent-Range: bytes " + std::to_string(start) + "-" + std::to_string(end) + "/" +
+        std::to_string(FILE_LENGTH) + "\r\n" + HTTP_FRAMING_HEADER + ": " + BINARY_FRAMING_VERSION +
+        "\r\nContent-Disposition: attachment; filename=" + FILE_ID + "\r\n\r\n";
+}
+
+std::vector<uint8_t> MakeBinaryResponse(int64_t start, int64_t end)
+{
+    BinaryFrame frame;
+    frame.type = FRAME_TYPE_RESPONSE;
+    frame.status = FRAME_STATUS_OK;
+    frame.requestId = 1;
+    frame.offset = start;
+    frame.length = end - start;
+    frame.total = FILE_LENGTH;
+    frame.fileId = FILE_ID;
+    std::vector<uint8_t> buffer(GetBinaryFrameHeaderLength(frame));
+    EncodeBinaryFrame(frame, buffer.data(), buffer.size());
+    return buffer;
+}
+
+const uint8_t *ToBytes(const std::string &str)
+{
+    return reinterpret_cast<const uint8_t *>(str.data());
+}
+
+// Average nanoseconds of one parse of the header of a chunk
+template<typename Parse>
+double MeasureParseNs(Parse parse)
+{
+    auto begin = std::chrono::steady_clock::now();
+    int parsed = 0;
+    for (int i = 0; i < PARSE_ROUNDS; i++) {
+        parsed += parse() ? 1 : 0;
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+    EXPECT_EQ(parsed, PARSE_ROUNDS);
+    return static_cast<double>(cost.count()) / PARSE_ROUNDS;
+}
+}
+
+class BinaryFrameTest : public testing::Test {};
+
+HWTEST_F(BinaryFrameTest, EncodeAndParse, TestSize.Level1)
+{
+    BinaryFrame frame;
+    frame.type = FRAME_TYPE_BULK_REQUEST;
+    frame.status = REQUEST_PRIORITY_BLOCKING;
+    frame.requestId = 0x12345678;
+    frame.offset = 0x123456789A;
+    frame.length = CHUNK_LENGTH;
+    frame.total = FILE_LENGTH;
+    frame.fileId = FILE_ID;
+    std::vector<uint8_t> buffer(GetBinaryFrameHeaderLength(frame) + 16, 0xAB);
+    EXPECT_EQ(GetBinaryFrameHeaderLength(frame), BINARY_FRAME_HEADER_LEN + FILE_ID.size());
+    EXPECT_FALSE(EncodeBinaryFrame(frame, buffer.data(), GetBinaryFrameHeaderLength(frame) - 1));
+    ASSERT_TRUE(EncodeBinaryFrame(frame, buffer.data(), buffer.size()));
+    ASSERT_TRUE(IsBinaryFrame(buffer.data(), buffer.size()));
+
+    BinaryFrame parsed;
+    size_t dataOffset = 0;
+    ASSERT_TRUE(ParseBinaryFrame(buffer.data(), buffer.size(), parsed, dataOffset));
+    EXPECT_EQ(parsed.type, frame.type);
+    EXPECT_EQ(parsed.status, frame.status);
+    EXPECT_EQ(parsed.requestId, frame.requestId);
+    EXPECT_EQ(parsed.offset, frame.offset);
+    EXPECT_EQ(parsed.length, frame.length);
+    EXPECT_EQ(parsed.total, frame.total);
+    EXPECT_EQ(parsed.fileId, FILE_ID);
+    EXPECT_EQ(dataOffset, GetBinaryFrameHeaderLength(frame));
+}
+
+HWTEST_F(BinaryFrameTest, RejectsBrokenFrames, TestSize.Level1)
+{
+    std::vector<uint8_t> buffer = MakeBinaryResponse(0, CHUNK_LENGTH);
+    BinaryFrame parsed;
+    size_t dataOffset = 0;
+    // The file id is cut off
+    EXPECT_FALSE(ParseBinaryFrame(buffer.data(), buffer.size() - 1, parsed, dataOffset));
+    EXPECT_FALSE(IsBinaryFrame(buffer.data(), BINARY_FRAME_HEADER_LEN - 1));
+    // Unknown version
+    std::vector<uint8_t> otherVersion = buffer;
+    otherVersion[4] = 2; // 4: position of the version
+    EXPECT_FALSE(ParseBinaryFrame(otherVersion.data(), otherVersion.size(), parsed, dataOffset));
+    // A http message never looks like a frame
+    std::string response = MakeHttpResponse(0, CHUNK_LENGTH);
+    EXPECT_FALSE(IsBinaryFrame(ToBytes(response), response.size()));
+    EXPECT_FALSE(ParseBinaryFrame(ToBytes(response), response.size(), parsed, dataOffset));
+}
+
+HWTEST_F(BinaryFrameTest, ParsesHttpRequest, TestSize.Level1)
+{
+    std::string message = MakeHttpRequest(CHUNK_LENGTH, 2 * CHUNK_LENGTH);
+    HttpRequestHeader request;
+    ASSERT_TRUE(ParseHttpRequest(ToBytes(message), message.size(), request));
+    EXPECT_EQ(request.method, "GET");
+    EXPECT_EQ(request.uri, FILE_ID);
+    EXPECT_EQ(request.rangeStart, CHUNK_LENGTH);
+    EXPECT_EQ(request.rangeEnd, 2 * CHUNK_LENGTH);
+    EXPECT_EQ(request.priority, REQUEST_PRIORITY_BLOCKING);
+    EXPECT_EQ(request.framing, BINARY_FRAMING_VERSION);
+
+    // Range is necessary
+    std::string noRange = "GET " + FILE_ID + " HTTP/1.1\r\nAccept: */*\r\n\r\n";
+    HttpRequestHeader other;
+    EXPECT_FALSE(ParseHttpRequest(ToBytes(noRange), noRange.size(), other));
+    // The header has to be complete
+    EXPECT_FALSE(ParseHttpRequest(ToBytes(message), message.size() - 2, other));
+}
+
+HWTEST_F(BinaryFrameTest, ParsesHttpResponse, TestSize.Level1)
+{
+    const std::string body = "0123456789";
+    std::string message = MakeHttpResponse(0, body.size()) + body;
+    HttpResponseHeader response;
+    ASSERT_TRUE(ParseHttpResponse(ToBytes(message), message.size(), response));
+    EXPECT_EQ(response.protocol, "HTTP/1.1");
+    EXPECT_EQ(response.statusCode, "200");
+    EXPECT_EQ(response.contentLength, static_cast<int64_t>(body.size()));
+    EXPECT_EQ(response.rangeStart, 0);
+    EXPECT_EQ(response.rangeEnd, static_cast<int64_t>(body.size()));
+    EXPECT_EQ(response.rangeTotal, FILE_LENGTH);
+    EXPECT_EQ(response.fileName, FILE_ID);
+    EXPECT_EQ(response.framing, BINARY_FRAMING_VERSION);
+    ASSERT_EQ(response.dataOffset, message.size() - body.size());
+
+    // A server without the binary framing does not echo the header
+    std::string plain = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\nContent-Range: bytes 0-10/100\r\n"
+        "Content-Disposition: attachment; filename=\"" + FILE_ID + "\"\r\n\r\n";
+    HttpResponseHeader fallback;
+    ASSERT_TRUE(ParseHttpResponse(ToBytes(plain), plain.size(), fallback));
+    EXPECT_TRUE(fallback.framing.empty());
+    EXPECT_EQ(fallback.fileName, FILE_ID);
+}
+
+/*
+ * Cost of parsing the header of each chunk of the file data, the binary frame against the http response it
+ * replaced.
+ */
+HWTEST_F(BinaryFrameTest, BinaryParseIsCheaperThanHttp, TestSize.Level1)
+{
+    std::string http = MakeHttpResponse(CHUNK_LENGTH, 2 * CHUNK_LENGTH);
+    std::vector<uint8_t> binary = MakeBinaryResponse(CHUNK_LENGTH, 2 * CHUNK_LENGTH);
+    double httpNs = MeasureParseNs([&http]() {
+        HttpResponseHeader response;
+        return ParseHttpResponse(ToBytes(http), http.size(), response);
+    });
+    double binaryNs = MeasureParseNs([&binary]() {
+        BinaryFrame frame;
+        size_t dataOffset = 0;
+        return ParseBinaryFrame(binary.data(), binary.size(), frame, dataOffset);
+    });
+    RecordProperty("httpNsPerChunk", std::to_string(httpNs));
+    RecordProperty("httpHeaderBytes", static_cast<int>(http.size()));
+    RecordProperty("binaryNsPerChunk", std::to_string(binaryNs));
+    RecordProperty("binaryHeaderBytes", static_cast<int>(binary.size()));
+    EXPECT_LT(binary.size(), http.size());
+    EXPECT_LT(binaryNs, httpNs);
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
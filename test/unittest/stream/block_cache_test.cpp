@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: unit tests of the block cache of the local data source.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "block_cache.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+constexpr int64_t BLOCK_SIZE = BlockCache::BLOCK_SIZE;
+constexpr int64_t FILE_LENGTH = 16 * BLOCK_SIZE;
+constexpr int64_t READ_WAIT_MS = 2000;
+constexpr int WRITER_DELAY_MS = 100;
+}
+
+class BlockCacheTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        file_.resize(FILE_LENGTH);
+        for (int64_t i = 0; i < FILE_LENGTH; i++) {
+            file_[i] = static_cast<uint8_t>(i * 7 + 3);
+        }
+    }
+
+    bool Write(BlockCache &cache, int64_t offset, int64_t length)
+    {
+        return cache.Write(file_.data() + offset, offset, length);
+    }
+
+    bool Matches(const std::vector<uint8_t> &data, int64_t pos)
+    {
+        return std::equal(data.begin(), data.end(), file_.begin() + pos);
+    }
+
+    std::vector<uint8_t> file_;
+};
+
+HWTEST_F(BlockCacheTest, WriteAndRead, TestSize.Level1)
+{
+    BlockCache cache(FILE_LENGTH, 4 * BLOCK_SIZE);
+    ASSERT_TRUE(cache.IsValid());
+    EXPECT_EQ(cache.GetCapacity(), 4 * BLOCK_SIZE);
+    int64_t start = 0;
+    int64_t end = 0;
+    ASSERT_TRUE(cache.FindMissingRange(BLOCK_SIZE / 2, FILE_LENGTH, start, end));
+    ASSERT_TRUE(cache.MarkRequested(start, end, start, end));
+    ASSERT_TRUE(Write(cache, start, end - start));
+    EXPECT_TRUE(cache.IsCached(BLOCK_SIZE / 2));
+
+    // A read across the block border
+    std::vector<uint8_t> data(BLOCK_SIZE);
+    ASSERT_EQ(cache.Read(data.data(), data.size(), BLOCK_SIZE / 2, 0), BLOCK_SIZE);
+    EXPECT_TRUE(Matches(data, BLOCK_SIZE / 2));
+    // Nothing past what was written
+    EXPECT_EQ(cache.Read(data.data(), data.size(), end, 0), 0);
+    // Data of blocks that were never requested is dropped
+    EXPECT_FALSE(Write(cache, FILE_LENGTH - BLOCK_SIZE, BLOCK_SIZE));
+}
+
+HWTEST_F(BlockCacheTest, FindsMissingRanges, TestSize.Level1)
+{
+    BlockCache cache(FILE_LENGTH, 8 * BLOCK_SIZE);
+    int64_t start = 0;
+    int64_t end = 0;
+    // A cold read position is requested small
+    ASSERT_TRUE(cache.FindMissingRange(0, FILE_LENGTH, start, end));
+    EXPECT_EQ(start, 0);
+    EXPECT_EQ(end, BlockCache::FIRST_REQUEST_SIZE);
+    ASSERT_TRUE(cache.MarkRequested(start, end, 0, end));
+
+    // The requested blocks are in flight, the next request starts after them and may be larger
+    ASSERT_TRUE(cache.FindMissingRange(0, FILE_LENGTH, start, end));
+    EXPECT_EQ(start, BlockCache::FIRST_REQUEST_SIZE);
+    EXPECT_EQ(end, start + BlockCache::SINGLE_REQUEST_MAX_SIZE);
+    // Nothing missing within the ahead limit
+    EXPECT_FALSE(cache.FindMissingRange(0, BlockCache::FIRST_REQUEST_SIZE, start, end));
+
+    // A cancelled request is missing again
+    cache.CancelRequested(0, BlockCache::FIRST_REQUEST_SIZE);
+    ASSERT_TRUE(cache.FindMissingRange(0, FILE_LENGTH, start, end));
+    EXPECT_EQ(start, 0);
+
+    // A partly filled block is requested from its fill position, no longer as a cold one
+    ASSERT_TRUE(cache.MarkRequested(0, BLOCK_SIZE, 0, BLOCK_SIZE));
+    ASSERT_TRUE(Write(cache, 0, 1000));
+    cache.CancelRequested(0, BLOCK_SIZE);
+    ASSERT_TRUE(cache.FindMissingRange(0, FILE_LENGTH, start, end));
+    EXPECT_EQ(start, 1000);
+    EXPECT_EQ(end, start + BlockCache::SINGLE_REQUEST_MAX_SIZE);
+}
+
+HWTEST_F(BlockCacheTest, EvictsOutsideTheProtectedRange, TestSize.Level1)
+{
+    BlockCache cache(FILE_LENGTH, 2 * BLOCK_SIZE);
+    ASSERT_TRUE(cache.MarkRequested(0, 2 * BLOCK_SIZE, 0, 2 * BLOCK_SIZE));
+    ASSERT_TRUE(Write(cache, 0, 2 * BLOCK_SIZE));
+    // Both blocks are protected, there is no room for another one
+    EXPECT_FALSE(cache.MarkRequested(2 * BLOCK_SIZE, 3 * BLOCK_SIZE, 0, 3 * BLOCK_SIZE));
+    // Once the reader moved on the first block makes room
+    ASSERT_TRUE(cache.MarkRequested(2 * BLOCK_SIZE, 3 * BLOCK_SIZE, BLOCK_SIZE, 3 * BLOCK_SIZE));
+    EXPECT_FALSE(cache.IsCached(0));
+    EXPECT_TRUE(cache.IsCached(BLOCK_SIZE));
+}
+
+HWTEST_F(BlockCacheTest, ReadWaitsForData, TestSize.Level1)
+{
+    BlockCache cache(FILE_LENGTH, 4 * BLOCK_SIZE);
+    ASSERT_TRUE(cache.MarkRequested(0, BLOCK_SIZE, 0, BLOCK_SIZE));
+    std::vector<uint8_t> data(500);
+    int64_t read = 0;
+    std::thread reader([&cache, &data, &read]() {
+        read = cache.Read(data.data(), data.size(), 0, READ_WAIT_MS);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_DELAY_MS));
+    EXPECT_TRUE(Write(cache, 0, 2000));
+    reader.join();
+    EXPECT_EQ(read, static_cast<int64_t>(data.size()));
+    EXPECT_TRUE(Matches(data, 0));
+
+    // An aborted cache wakes its readers with nothing
+    std::thread waiting([&cache, &data, &read]() {
+        read = cache.Read(data.data(), data.size(), 4000, READ_WAIT_MS);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_DELAY_MS));
+    cache.Abort();
+    waiting.join();
+    EXPECT_EQ(read, 0);
+}
+
+// Data written elsewhere leaves a waiting reader asleep, a cancel of its own request wakes it to ask again
+HWTEST_F(BlockCacheTest, ReadWakesOnlyForItsData, TestSize.Level1)
+{
+    BlockCache cache(FILE_LENGTH, 4 * BLOCK_SIZE);
+    ASSERT_TRUE(cache.MarkRequested(0, 2 * BLOCK_SIZE, 0, 2 * BLOCK_SIZE));
+    std::vector<uint8_t> data(500);
+    int64_t read = -1;
+    int64_t waitedMs = 0;
+    std::thread reader([&cache, &data, &read, &waitedMs]() {
+        auto begin = std::chrono::steady_clock::now();
+        read = cache.Read(data.data(), data.size(), 0, READ_WAIT_MS);
+        waitedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+            begin).count();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_DELAY_MS));
+    EXPECT_TRUE(Write(cache, BLOCK_SIZE, 2000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_DELAY_MS));
+    cache.CancelRequested(0, BLOCK_SIZE);
+    reader.join();
+    EXPECT_EQ(read, 0);
+    EXPECT_GE(waitedMs, 2 * WRITER_DELAY_MS);
+    EXPECT_LT(waitedMs, READ_WAIT_MS);
+}
+
+/*
+ * A reader waiting at the fill position gets the data written straight into its buffer. The block keeps what it
+ * held before, and what was written past the reader's buffer.
+ */
+HWTEST_F(BlockCacheTest, DirectReadKeepsCachedPrefix, TestSize.Level1)
+{
+    BlockCache cache(FILE_LENGTH, 4 * BLOCK_SIZE);
+    ASSERT_TRUE(cache.MarkRequested(0, BLOCK_SIZE, 0, BLOCK_SIZE));
+    ASSERT_TRUE(Write(cache, 0, 1000));
+    std::vector<uint8_t> data(500);
+    int64_t read = 0;
+    std::thread reader([&cache, &data, &read]() {
+        read = cache.Read(data.data(), data.size(), 1000, READ_WAIT_MS);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_DELAY_MS));
+    EXPECT_TRUE(Write(cache, 1000, 2000));
+    reader.join();
+    ASSERT_EQ(read, static_cast<int64_t>(data.size()));
+    EXPECT_TRUE(Matches(data, 1000));
+
+    std::vector<uint8_t> all(3000);
+    ASSERT_EQ(cache.Read(all.data(), all.size(), 0, 0), static_cast<int64_t>(all.size()));
+    EXPECT_TRUE(Matches(all, 0));
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: unit tests of the disk cache of the blocks of played local files.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "disk_block_cache.h"
+#include "utils.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+constexpr int64_t FILE_LENGTH = 10 * DiskBlockCache::BLOCK_SIZE + 100;
+constexpr int64_t TWO_SEGMENTS = 2 * (DiskBlockCache::BLOCK_SIZE + 1) * DiskBlockCache::BLOCKS_PER_SEGMENT;
+
+// File ids are the base64 of the path, fd and version the sender opened the file with
+std::string MakeFileId(int fd, const std::string &version)
+{
+    std::string fileId;
+    Utils::Base64Encode("/storage/media/video.mp4:" + std::to_string(fd) + "@" + version, fileId);
+    return fileId;
+}
+
+std::vector<uint8_t> MakeBlock(int64_t length, uint8_t seed)
+{
+    std::vector<uint8_t> block(static_cast<size_t>(length));
+    for (size_t i = 0; i < block.size(); i++) {
+        block[i] = static_cast<uint8_t>(seed + i);
+    }
+    return block;
+}
+}
+
+class DiskBlockCacheTest : public testing::Test {
+protected:
+    void TearDown() override
+    {
+        DiskBlockCache::GetInstance().SetCapacity(0);
+    }
+};
+
+HWTEST_F(DiskBlockCacheTest, KeyFollowsTheFileVersion, TestSize.Level1)
+{
+    std::string key = DiskBlockCache::MakeKey(MakeFileId(45, "dev:inode:6789"), FILE_LENGTH);
+    EXPECT_FALSE(key.empty());
+    // The same version opened again with another fd hits the same blocks
+    EXPECT_EQ(DiskBlockCache::MakeKey(MakeFileId(46, "dev:inode:6789"), FILE_LENGTH), key);
+    EXPECT_NE(DiskBlockCache::MakeKey(MakeFileId(45, "dev:inode:6790"), FILE_LENGTH), key);
+    EXPECT_TRUE(DiskBlockCache::MakeKey("not base64 @", FILE_LENGTH).empty());
+}
+
+HWTEST_F(DiskBlockCacheTest, OffUntilGivenCapacity, TestSize.Level1)
+{
+    DiskBlockCache &cache = DiskBlockCache::GetInstance();
+    cache.SetCapacity(DiskBlockCache::DEFAULT_CAPACITY);
+    EXPECT_FALSE(cache.IsEnabled());
+    std::string key = DiskBlockCache::MakeKey(MakeFileId(45, "dev:inode:6789"), FILE_LENGTH);
+    std::vector<uint8_t> block = MakeBlock(DiskBlockCache::BLOCK_SIZE, 1);
+    cache.WriteBlock(key, 0, block.data(), DiskBlockCache::BLOCK_SIZE);
+    EXPECT_FALSE(cache.HasBlock(key, 0));
+}
+
+HWTEST_F(DiskBlockCacheTest, KeepsWrittenBlocksUntilTurnedOff, TestSize.Level1)
+{
+    DiskBlockCache &cache = DiskBlockCache::GetInstance();
+    cache.SetCapacity(TWO_SEGMENTS);
+    ASSERT_TRUE(cache.IsEnabled());
+    std::string key = DiskBlockCache::MakeKey(MakeFileId(45, "dev:inode:6789"), FILE_LENGTH);
+    std::vector<uint8_t> first = MakeBlock(DiskBlockCache::BLOCK_SIZE, 1);
+    // The last block of the file is short
+    std::vector<uint8_t> last = MakeBlock(FILE_LENGTH % DiskBlockCache::BLOCK_SIZE, 7);
+    int64_t lastIndex = FILE_LENGTH / DiskBlockCache::BLOCK_SIZE;
+    cache.WriteBlock(key, 0, first.data(), static_cast<int64_t>(first.size()));
+    cache.WriteBlock(key, lastIndex, last.data(), static_cast<int64_t>(last.size()));
+    EXPECT_TRUE(cache.HasBlock(key, 0));
+    EXPECT_FALSE(cache.HasBlock(key, 1));
+    EXPECT_TRUE(cache.HasBlock(key, lastIndex));
+
+    std::vector<uint8_t> read(first.size());
+    ASSERT_TRUE(cache.ReadBlock(key, 0, read.data(), static_cast<int64_t>(read.size())));
+    EXPECT_EQ(read, first);
+    read.resize(last.size());
+    ASSERT_TRUE(cache.ReadBlock(key, lastIndex, read.data(), static_cast<int64_t>(read.size())));
+    EXPECT_EQ(read, last);
+    EXPECT_FALSE(cache.ReadBlock(key, 1, read.data(), static_cast<int64_t>(read.size())));
+
+    cache.SetCapacity(0);
+    EXPECT_FALSE(cache.IsEnabled());
+    cache.SetCapacity(TWO_SEGMENTS);
+    EXPECT_FALSE(cache.HasBlock(key, 0));
+}
+
+HWTEST_F(DiskBlockCacheTest, EvictsTheLeastRecentlyUsedSegment, TestSize.Level1)
+{
+    DiskBlockCache &cache = DiskBlockCache::GetInstance();
+    cache.SetCapacity(TWO_SEGMENTS);
+    ASSERT_TRUE(cache.IsEnabled());
+    std::string key = DiskBlockCache::MakeKey(MakeFileId(45, "dev:inode:6789"), FILE_LENGTH);
+    std::vector<uint8_t> block = MakeBlock(DiskBlockCache::BLOCK_SIZE, 3);
+    for (int64_t segment = 0; segment < 3; segment++) {
+        cache.WriteBlock(key, segment * DiskBlockCache::BLOCKS_PER_SEGMENT, block.data(), DiskBlockCache::BLOCK_SIZE);
+    }
+    EXPECT_FALSE(cache.HasBlock(key, 0));
+    EXPECT_TRUE(cache.HasBlock(key, DiskBlockCache::BLOCKS_PER_SEGMENT));
+    EXPECT_TRUE(cache.HasBlock(key, 2 * DiskBlockCache::BLOCKS_PER_SEGMENT));
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
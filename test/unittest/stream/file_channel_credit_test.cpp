@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: unit tests of the framing negotiation and the credit accounting of the local file channel.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "cast_local_file_channel_client.h"
+#include "cast_local_file_channel_server.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+const std::string FILE_ID = "L2RhdGEvbWVkaWEvbW92aWUubXA0";
+constexpr int64_t CHUNK_LENGTH = 256 * 1024;
+constexpr int64_t CREDIT_WINDOW = 8 * 1024 * 1024;
+constexpr int64_t CREDIT_GRANT_STEP = 2 * 1024 * 1024;
+constexpr int RESPONSE_WAIT_MS = 2000;
+constexpr int PARKED_WAIT_MS = 200;
+
+// Keeps every packet sent on it
+class CapturingChannel : public Channel {
+public:
+    bool Send(const uint8_t *buffer, int length) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        packets_.emplace_back(buffer, buffer + length);
+        cond_.notify_all();
+        return true;
+    }
+
+    size_t GetPacketCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return packets_.size();
+    }
+
+    std::vector<uint8_t> GetPacket(size_t index)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index < packets_.size() ? packets_[index] : std::vector<uint8_t>();
+    }
+
+    bool WaitPackets(size_t count, int waitMs)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cond_.wait_for(lock, std::chrono::milliseconds(waitMs), [this, count]() {
+            return packets_.size() >= count;
+        });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::vector<uint8_t>> packets_;
+};
+
+class RecordingDataListener : public IDataListener {
+public:
+    bool OnBytesReceived(std::string_view fileId, const uint8_t *bytes, int64_t offset, int64_t length) override
+    {
+        receivedBytes += length;
+        return true;
+    }
+
+    void OnRequestFailed(std::string_view fileId, int64_t offset) override
+    {
+        failedOffsets.push_back(offset);
+    }
+
+    int64_t receivedBytes{ 0 };
+    std::vector<int64_t> failedOffsets;
+};
+
+std::vector<uint8_t> MakeFrame(uint8_t type, uint16_t status, int64_t offset, int64_t length,
+    const std::string &fileId)
+{
+    BinaryFrame frame;
+    frame.type = type;
+    frame.status = status;
+    frame.requestId = 1;
+    frame.offset = offset;
+    frame.length = length;
+    frame.fileId = fileId;
+    size_t headerLength = GetBinaryFrameHeaderLength(frame);
+    std::vector<uint8_t> buffer(headerLength + (type == FRAME_TYPE_RESPONSE ? length : 0));
+    EncodeBinaryFrame(frame, buffer.data(), headerLength);
+    return buffer;
+}
+
+// The file id of the frame points into packet
+bool ParsePacket(const std::vector<uint8_t> &packet, BinaryFrame &frame)
+{
+    size_t dataOffset = 0;
+    return ParseBinaryFrame(packet.data(), packet.size(), frame, dataOffset);
+}
+
+std::string ToString(const std::vector<uint8_t> &packet)
+{
+    return std::string(packet.begin(), packet.end());
+}
+}
+
+class FileChannelCreditTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        channel_ = std::make_shared<CapturingChannel>();
+        client_ = std::make_shared<CastLocalFileChannelClient>(nullptr);
+        client_->AddChannel(channel_);
+        listener_ = std::make_shared<RecordingDataListener>();
+        client_->AddDataListener(FILE_ID, listener_);
+    }
+
+    // Answers with the http response a server speaking the binary framing sends
+    void AnswerWithHttp(int64_t start, int64_t end)
+    {
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(end - start) +
+            "\r\nContent-Range: bytes " + std::to_string(start) + "-" + std::to_string(end) + "/" +
+            std::to_string(CREDIT_WINDOW * 4) + "\r\n" + HTTP_FRAMING_HEADER + ": " + BINARY_FRAMING_VERSION +
+            "\r\nContent-Disposition: attachment; filename=" + FILE_ID + "\r\n\r\n";
+        response.append(static_cast<size_t>(end - start), 'x');
+        client_->OnDataReceived(reinterpret_cast<const uint8_t *>(response.data()), response.size(), 0);
+    }
+
+    std::shared_ptr<CapturingChannel> channel_;
+    std::shared_ptr<CastLocalFileChannelClient> client_;
+    std::shared_ptr<RecordingDataListener> listener_;
+};
+
+HWTEST_F(FileChannelCreditTest, ClientSwitchesToBinaryFraming, TestSize.Level1)
+{
+    uint32_t requestId = 0;
+    ASSERT_TRUE(client_->RequestByteData(0, CHUNK_LENGTH, FILE_ID, REQUEST_PRIORITY_BLOCKING, requestId));
+    // The first request goes out as http and offers the binary framing
+    EXPECT_EQ(requestId, 0u);
+    ASSERT_EQ(channel_->GetPacketCount(), 1u);
+    std::string request = ToString(channel_->GetPacket(0));
+    EXPECT_NE(request.find(HTTP_FRAMING_HEADER + ": " + BINARY_FRAMING_VERSION), std::string::npos);
+    EXPECT_FALSE(client_->RequestBulkData(0, CREDIT_WINDOW, FILE_ID, REQUEST_PRIORITY_PREFETCH, requestId));
+
+    AnswerWithHttp(0, CHUNK_LENGTH);
+    EXPECT_EQ(listener_->receivedBytes, CHUNK_LENGTH);
+
+    // The server echoed the offer, the next request is a binary frame after the first credit of the file
+    ASSERT_TRUE(client_->RequestByteData(CHUNK_LENGTH, 2 * CHUNK_LENGTH, FILE_ID, REQUEST_PRIORITY_PREFETCH,
+        requestId));
+    EXPECT_NE(requestId, 0u);
+    ASSERT_EQ(channel_->GetPacketCount(), 3u);
+    std::vector<uint8_t> creditPacket = channel_->GetPacket(1);
+    BinaryFrame credit;
+    ASSERT_TRUE(ParsePacket(creditPacket, credit));
+    EXPECT_EQ(credit.type, FRAME_TYPE_CREDIT);
+    EXPECT_EQ(credit.length, CREDIT_WINDOW);
+    EXPECT_EQ(credit.fileId, FILE_ID);
+    std::vector<uint8_t> requestPacket = channel_->GetPacket(2);
+    BinaryFrame frame;
+    ASSERT_TRUE(ParsePacket(requestPacket, frame));
+    EXPECT_EQ(frame.type, FRAME_TYPE_REQUEST);
+    EXPECT_EQ(frame.requestId, requestId);
+    EXPECT_EQ(frame.offset, CHUNK_LENGTH);
+    EXPECT_EQ(frame.length, CHUNK_LENGTH);
+
+    // A new channel starts over with http
+    client_->AddChannel(channel_);
+    ASSERT_TRUE(client_->RequestByteData(0, CHUNK_LENGTH, FILE_ID, REQUEST_PRIORITY_PREFETCH, requestId));
+    EXPECT_EQ(requestId, 0u);
+    EXPECT_FALSE(IsBinaryFrame(channel_->GetPacket(3).data(), channel_->GetPacket(3).size()));
+}
+
+HWTEST_F(FileChannelCreditTest, ClientGivesCreditBack, TestSize.Level1)
+{
+    uint32_t requestId = 0;
+    ASSERT_TRUE(client_->RequestByteData(0, CHUNK_LENGTH, FILE_ID, REQUEST_PRIORITY_BLOCKING, requestId));
+    AnswerWithHttp(0, CHUNK_LENGTH);
+    ASSERT_TRUE(client_->RequestBulkData(0, CREDIT_WINDOW, FILE_ID, REQUEST_PRIORITY_PREFETCH, requestId));
+    size_t sent = channel_->GetPacketCount();
+
+    // Nothing is granted until a grant step of the credit is used
+    int64_t offset = 0;
+    for (; offset + CHUNK_LENGTH < CREDIT_GRANT_STEP; offset += CHUNK_LENGTH) {
+        std::vector<uint8_t> response = MakeFrame(FRAME_TYPE_RESPONSE, FRAME_STATUS_OK, offset, CHUNK_LENGTH, FILE_ID);
+        client_->OnDataReceived(response.data(), response.size(), 0);
+    }
+    EXPECT_EQ(channel_->GetPacketCount(), sent);
+    std::vector<uint8_t> response = MakeFrame(FRAME_TYPE_RESPONSE, FRAME_STATUS_OK, offset, CHUNK_LENGTH, FILE_ID);
+    client_->OnDataReceived(response.data(), response.size(), 0);
+    ASSERT_EQ(channel_->GetPacketCount(), sent + 1);
+    std::vector<uint8_t> creditPacket = channel_->GetPacket(sent);
+    BinaryFrame credit;
+    ASSERT_TRUE(ParsePacket(creditPacket, credit));
+    EXPECT_EQ(credit.type, FRAME_TYPE_CREDIT);
+    EXPECT_EQ(credit.length, CREDIT_GRANT_STEP);
+    EXPECT_EQ(listener_->receivedBytes, CHUNK_LENGTH + CREDIT_GRANT_STEP);
+
+    // A failed response reaches the listener of the file
+    std::vector<uint8_t> failure = MakeFrame(FRAME_TYPE_RESPONSE, FRAME_STATUS_BUSY, CREDIT_GRANT_STEP, 0, FILE_ID);
+    client_->OnDataReceived(failure.data(), failure.size(), 0);
+    ASSERT_EQ(listener_->failedOffsets.size(), 1u);
+    EXPECT_EQ(listener_->failedOffsets[0], CREDIT_GRANT_STEP);
+}
+
+/*
+ * The server sends a file under credit only within it, a request needing more waits until the sink grants it.
+ */
+HWTEST_F(FileChannelCreditTest, ServerParksRequestWithoutCredit, TestSize.Level1)
+{
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    std::vector<uint8_t> content(2 * CHUNK_LENGTH, 'c');
+    ASSERT_EQ(write(fileno(file), content.data(), content.size()), static_cast<ssize_t>(content.size()));
+
+    auto server = std::make_shared<CastLocalFileChannelServer>();
+    MediaInfo mediaInfo;
+    mediaInfo.mediaUrl = std::to_string(fileno(file));
+    ASSERT_TRUE(server->AddLocalFileInfo(mediaInfo));
+    const std::string fileId = mediaInfo.mediaUrl;
+    auto sinkChannel = std::make_shared<CapturingChannel>();
+    server->AddChannel(sinkChannel);
+    std::shared_ptr<IChannelListener> sinkListener = sinkChannel->GetListener();
+    ASSERT_NE(sinkListener, nullptr);
+
+    std::vector<uint8_t> credit = MakeFrame(FRAME_TYPE_CREDIT, 0, 0, CHUNK_LENGTH, fileId);
+    sinkListener->OnDataReceived(credit.data(), credit.size(), 0);
+    std::vector<uint8_t> request = MakeFrame(FRAME_TYPE_REQUEST, REQUEST_PRIORITY_BLOCKING, 0, 2 * CHUNK_LENGTH,
+        fileId);
+    sinkListener->OnDataReceived(request.data(), request.size(), 0);
+    EXPECT_FALSE(sinkChannel->WaitPackets(1, PARKED_WAIT_MS));
+
+    // Enough credit for the whole response
+    sinkListener->OnDataReceived(credit.data(), credit.size(), 0);
+    ASSERT_TRUE(sinkChannel->WaitPackets(1, RESPONSE_WAIT_MS));
+    std::vector<uint8_t> responsePacket = sinkChannel->GetPacket(0);
+    BinaryFrame response;
+    ASSERT_TRUE(ParsePacket(responsePacket, response));
+    EXPECT_EQ(response.type, FRAME_TYPE_RESPONSE);
+    EXPECT_EQ(response.status, FRAME_STATUS_OK);
+    EXPECT_EQ(response.offset, 0);
+    EXPECT_EQ(response.length, 2 * CHUNK_LENGTH);
+
+    server->RemoveChannel(sinkChannel);
+    server = nullptr;
+    fclose(file);
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
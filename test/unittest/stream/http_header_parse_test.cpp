@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: per chunk cost and heap allocations of parsing the headers of the local file channel.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "cast_local_file_channel_common.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace {
+// Heap allocations of the whole test binary, the parsers are measured by the difference around them
+std::atomic<uint64_t> g_allocations{ 0 };
+
+void *CountedAlloc(size_t size)
+{
+    g_allocations++;
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+}
+
+void *operator new(size_t size)
+{
+    return CountedAlloc(size);
+}
+
+void *operator new[](size_t size)
+{
+    return CountedAlloc(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    g_allocations++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    g_allocations++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+const std::string FILE_ID = "MTIzQGRldjo0NTo2Nzg5MDEyMzQ1";
+constexpr int64_t CHUNK_LENGTH = 2 * 1024 * 1024 - 1024;
+constexpr int64_t FILE_LENGTH = 1024 * 1024 * 1024;
+constexpr int PARSE_ROUNDS = 100000;
+
+struct ParseCost {
+    double nsPerChunk{ 0 };
+    double allocationsPerChunk{ 0 };
+};
+
+// Parses the same chunk PARSE_ROUNDS times, the body is part of the buffer as it is on the channel
+template<typename Parse>
+ParseCost Measure(Parse parse)
+{
+    int parsed = 0;
+    uint64_t allocations = g_allocations.load();
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < PARSE_ROUNDS; i++) {
+        parsed += parse() ? 1 : 0;
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+    ParseCost result;
+    result.allocationsPerChunk = static_cast<double>(g_allocations.load() - allocations) / PARSE_ROUNDS;
+    result.nsPerChunk = static_cast<double>(cost.count()) / PARSE_ROUNDS;
+    EXPECT_EQ(parsed, PARSE_ROUNDS);
+    return result;
+}
+
+// Kept in the test report next to the result
+void Report(const ParseCost &cost)
+{
+    testing::Test::RecordProperty("nsPerChunk", std::to_string(cost.nsPerChunk));
+    testing::Test::RecordProperty("allocationsPerChunk", std::to_string(cost.allocationsPerChunk));
+}
+}
+
+class HttpHeaderParseTest : public testing::Test {};
+
+HWTEST_F(HttpHeaderParseTest, RequestParseDoesNotAllocate, TestSize.Level1)
+{
+    std::string message = "GET " + FILE_ID + " HTTP/1.1\r\nRange: bytes=" + std::to_string(CHUNK_LENGTH) + "-" +
+        std::to_string(2 * CHUNK_LENGTH) + "\r\n" + HTTP_PRIORITY_HEADER + ": 0\r\n" + HTTP_FRAMING_HEADER + ": " +
+        BINARY_FRAMING_VERSION + "\r\n\r\n";
+    const uint8_t *buffer = reinterpret_cast<const uint8_t *>(message.data());
+    ParseCost cost = Measure([buffer, &message]() {
+        HttpRequestHeader request;
+        return ParseHttpRequest(buffer, static_cast<int>(message.size()), request) &&
+            request.rangeEnd == 2 * CHUNK_LENGTH;
+    });
+    Report(cost);
+    EXPECT_EQ(cost.allocationsPerChunk, 0);
+}
+
+HWTEST_F(HttpHeaderParseTest, ResponseParseDoesNotAllocate, TestSize.Level1)
+{
+    std::string message = "HTTP/1.1 200 OK\r\nAccept-Ranges: bytes\r\nContent-Length: " +
+        std::to_string(CHUNK_LENGTH) + "\r\nContent-Range: bytes 0-" + std::to_string(CHUNK_LENGTH) + "/" +
+        std::to_string(FILE_LENGTH) + "\r\nContent-Disposition: attachment; filename=" + FILE_ID + "\r\n\r\n";
+    // Only the header is scanned, however long the body after it
+    message.append(static_cast<size_t>(CHUNK_LENGTH), 'x');
+    const uint8_t *buffer = reinterpret_cast<const uint8_t *>(message.data());
+    ParseCost cost = Measure([buffer, &message]() {
+        HttpResponseHeader response;
+        return ParseHttpResponse(buffer, static_cast<int>(message.size()), response) && response.fileName == FILE_ID;
+    });
+    Report(cost);
+    EXPECT_EQ(cost.allocationsPerChunk, 0);
+}
+
+HWTEST_F(HttpHeaderParseTest, BinaryParseDoesNotAllocate, TestSize.Level1)
+{
+    BinaryFrame frame;
+    frame.type = FRAME_TYPE_RESPONSE;
+    frame.status = FRAME_STATUS_OK;
+    frame.requestId = 1;
+    frame.length = CHUNK_LENGTH;
+    frame.total = FILE_LENGTH;
+    frame.fileId = FILE_ID;
+    std::vector<uint8_t> buffer(GetBinaryFrameHeaderLength(frame) + CHUNK_LENGTH);
+    ASSERT_TRUE(EncodeBinaryFrame(frame, buffer.data(), buffer.size()));
+    ParseCost cost = Measure([&buffer]() {
+        BinaryFrame parsed;
+        size_t dataOffset = 0;
+        return ParseBinaryFrame(buffer.data(), buffer.size(), parsed, dataOffset) && parsed.fileId == FILE_ID;
+    });
+    Report(cost);
+    EXPECT_EQ(cost.allocationsPerChunk, 0);
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS
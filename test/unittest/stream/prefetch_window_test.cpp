@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2026 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * Description: unit tests of the window of in-flight range requests of the local data source.
+ * Author: huangchanggui
+ * Create: 2026-10-17
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "prefetch_window.h"
+
+using namespace testing;
+using namespace testing::ext;
+
+namespace OHOS {
+namespace CastEngine {
+namespace CastEngineService {
+namespace {
+constexpr int64_t REQUEST_SIZE = 1024 * 1024;
+}
+
+class PrefetchWindowTest : public testing::Test {
+protected:
+    // Sends requests of REQUEST_SIZE from start on while the window allows, returns how many were sent
+    int Fill(PrefetchWindow &window, int64_t start, uint32_t firstId)
+    {
+        int sent = 0;
+        while (window.CanRequest()) {
+            window.OnRequestSent(start + sent * REQUEST_SIZE, start + (sent + 1) * REQUEST_SIZE, firstId + sent);
+            sent++;
+        }
+        return sent;
+    }
+};
+
+HWTEST_F(PrefetchWindowTest, LimitsRequestsInFlight, TestSize.Level1)
+{
+    PrefetchWindow window;
+    int32_t windowSize = window.GetWindowSize();
+    EXPECT_GE(windowSize, PrefetchWindow::MIN_WINDOW_SIZE);
+    EXPECT_LE(windowSize, PrefetchWindow::MAX_WINDOW_SIZE);
+    EXPECT_EQ(window.GetAheadLimit(REQUEST_SIZE), windowSize * REQUEST_SIZE);
+    EXPECT_EQ(Fill(window, 0, 1), windowSize);
+
+    PrefetchStats stats;
+    window.GetStats(stats);
+    EXPECT_EQ(stats.inFlight, windowSize);
+    EXPECT_EQ(stats.requestsSent, static_cast<uint64_t>(windowSize));
+    EXPECT_EQ(stats.windowFullCount, 1u);
+
+    // A response frees its slot
+    window.OnDataArrived(0, REQUEST_SIZE);
+    EXPECT_TRUE(window.CanRequest());
+    window.GetStats(stats);
+    EXPECT_EQ(stats.requestsCompleted, 1u);
+    EXPECT_EQ(stats.inFlight, windowSize - 1);
+    EXPECT_LE(window.GetWindowSize(), PrefetchWindow::MAX_WINDOW_SIZE);
+}
+
+HWTEST_F(PrefetchWindowTest, UntrackedDataDropsCoveredRequests, TestSize.Level1)
+{
+    PrefetchWindow window;
+    int sent = Fill(window, 0, 0);
+    ASSERT_GE(sent, 2);
+    // Data from the start of no request, the requests it covers are answered by it
+    window.OnDataArrived(REQUEST_SIZE / 2, sent * REQUEST_SIZE);
+    PrefetchStats stats;
+    window.GetStats(stats);
+    EXPECT_EQ(stats.inFlight, 1);
+    EXPECT_EQ(stats.requestsCompleted, 0u);
+}
+
+HWTEST_F(PrefetchWindowTest, FailedRequestIsReturned, TestSize.Level1)
+{
+    PrefetchWindow window;
+    window.OnRequestSent(REQUEST_SIZE, 2 * REQUEST_SIZE, 7);
+    PrefetchRequest request = { 0, 0, 0 };
+    EXPECT_FALSE(window.OnRequestFailed(0, request));
+    ASSERT_TRUE(window.OnRequestFailed(REQUEST_SIZE, request));
+    EXPECT_EQ(request.start, REQUEST_SIZE);
+    EXPECT_EQ(request.end, 2 * REQUEST_SIZE);
+    EXPECT_EQ(request.requestId, 7u);
+    EXPECT_FALSE(window.OnRequestFailed(REQUEST_SIZE, request));
+
+    PrefetchStats stats;
+    window.GetStats(stats);
+    EXPECT_EQ(stats.requestsFailed, 1u);
+    EXPECT_EQ(stats.inFlight, 0);
+}
+
+HWTEST_F(PrefetchWindowTest, SeekTakesRequestsOutsideTheNewRange, TestSize.Level1)
+{
+    PrefetchWindow window;
+    window.OnRequestSent(0, REQUEST_SIZE, 1);
+    window.OnRequestSent(10 * REQUEST_SIZE, 11 * REQUEST_SIZE, 2);
+    window.OnRequestSent(20 * REQUEST_SIZE, 21 * REQUEST_SIZE, 3);
+    std::vector<PrefetchRequest> obsolete;
+    window.TakeRequestsOutside(10 * REQUEST_SIZE + 1, 12 * REQUEST_SIZE, obsolete);
+    ASSERT_EQ(obsolete.size(), 2u);
+    EXPECT_EQ(obsolete[0].requestId, 1u);
+    EXPECT_EQ(obsolete[1].requestId, 3u);
+
+    PrefetchStats stats;
+    window.GetStats(stats);
+    EXPECT_EQ(stats.inFlight, 1);
+    EXPECT_EQ(stats.requestsCancelled, 2u);
+
+    // The request asked again is tracked once
+    window.OnRequestSent(10 * REQUEST_SIZE, 11 * REQUEST_SIZE, 4);
+    window.GetStats(stats);
+    EXPECT_EQ(stats.inFlight, 1);
+    window.Reset();
+    window.GetStats(stats);
+    EXPECT_EQ(stats.inFlight, 0);
+}
+} // namespace CastEngineService
+} // namespace CastEngine
+} // namespace OHOS